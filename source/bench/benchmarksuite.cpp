@@ -0,0 +1,75 @@
+#include "benchmarksuite.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+/**
+ * @brief BenchmarkSuite::BenchmarkSuite Creates an empty benchmark suite.
+ * @param repetitions The number of times every benchmark is run. Should be at
+ * least 1.
+ */
+BenchmarkSuite::BenchmarkSuite(int repetitions)
+    : repetitions(std::max(repetitions, 1)) {}
+
+/**
+ * @brief BenchmarkSuite::run Runs and times a single benchmark.
+ * @param name The name of the benchmark. Should be unique.
+ * @param labels Additional information that is stored with the results, such
+ * as the model or the size of the mesh.
+ * @param body The code that is timed.
+ */
+void BenchmarkSuite::run(const QString &name, const QJsonObject &labels,
+                         const std::function<void()> &body) {
+  QVector<double> times(repetitions);
+  QElapsedTimer timer;
+  for (int k = 0; k < repetitions; k++) {
+    timer.start();
+    body();
+    times[k] = timer.nsecsElapsed() / 1e6;
+  }
+  std::sort(times.begin(), times.end());
+  double median = (times[(repetitions - 1) / 2] + times[repetitions / 2]) / 2;
+  double mean = 0.0;
+  for (double time : times) {
+    mean += time;
+  }
+  mean /= repetitions;
+
+  QJsonObject result = labels;
+  result["name"] = name;
+  result["run_name"] = name;
+  result["run_type"] = "iteration";
+  result["iterations"] = repetitions;
+  result["real_time"] = median;
+  result["min_time"] = times.first();
+  result["mean_time"] = mean;
+  result["time_unit"] = "ms";
+  results.append(result);
+  qDebug() << ":: Benchmark" << name << "took" << median << "ms";
+}
+
+/**
+ * @brief BenchmarkSuite::toJson Collects the results of all benchmarks that
+ * were run so far, together with a description of the machine.
+ * @return The results.
+ */
+QJsonDocument BenchmarkSuite::toJson() const {
+  QJsonObject context;
+  context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  context["num_cpus"] = QThread::idealThreadCount();
+  context["qt_version"] = qVersion();
+#ifdef QT_DEBUG
+  context["library_build_type"] = "debug";
+#else
+  context["library_build_type"] = "release";
+#endif
+
+  QJsonObject document;
+  document["context"] = context;
+  document["benchmarks"] = results;
+  return QJsonDocument(document);
+}
@@ -0,0 +1,29 @@
+#ifndef BENCHMARK_SUITE_H
+#define BENCHMARK_SUITE_H
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <functional>
+
+/**
+ * @brief The BenchmarkSuite class times a number of benchmarks and collects
+ * the results. Every benchmark is run a fixed number of times and reported by
+ * its median, minimum and mean wall-clock time. The JSON output follows the
+ * layout of Google Benchmark, so the same tools can be used to compare runs.
+ */
+class BenchmarkSuite {
+ public:
+  BenchmarkSuite(int repetitions);
+
+  void run(const QString& name, const QJsonObject& labels,
+           const std::function<void()>& body);
+  QJsonDocument toJson() const;
+
+ private:
+  int repetitions;
+  QJsonArray results;
+};
+
+#endif  // BENCHMARK_SUITE_H
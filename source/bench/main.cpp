@@ -0,0 +1,184 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "benchmarksuite.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/objfile.h"
+#include "mesh/compactmesh.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/stenciltable.h"
+
+/**
+ * @brief labelled Adds the stage and level of a benchmark to its labels.
+ * @param labels The labels of the model.
+ * @param stage The stage of the pipeline.
+ * @param level The subdivision level, or -1 if it does not apply.
+ * @return The labels of the benchmark.
+ */
+static QJsonObject labelled(QJsonObject labels, const QString &stage,
+                            int level = -1) {
+  labels["stage"] = stage;
+  if (level >= 0) {
+    labels["level"] = level;
+  }
+  return labels;
+}
+
+/**
+ * @brief benchmarkName Constructs the name of a benchmark.
+ * @param stage The stage of the pipeline.
+ * @param model The name of the model.
+ * @param level The subdivision level, or -1 if it does not apply.
+ * @return The name, e.g. subdivide/Fertility/3.
+ */
+static QString benchmarkName(const QString &stage, const QString &model,
+                             int level = -1) {
+  QString name = stage + "/" + model;
+  if (level >= 0) {
+    name += "/" + QString::number(level);
+  }
+  return name;
+}
+
+/**
+ * @brief benchmarkModel Benchmarks every stage of the mesh pipeline on a
+ * single model: loading, constructing the half-edge mesh and, for every
+ * subdivision level, subdividing (both the pointer-based and the compact mesh),
+ * building and applying the stencil table of the level and extracting the
+ * buffers.
+ * @param suite The suite that collects the results.
+ * @param fileName Path of the .obj file.
+ * @param maxLevel The highest subdivision level.
+ */
+static void benchmarkModel(BenchmarkSuite &suite, const QString &fileName,
+                           int maxLevel) {
+  QString model = QFileInfo(fileName).baseName();
+  QJsonObject labels;
+  labels["model"] = model;
+
+  OBJFile objFile;
+  suite.run(benchmarkName("load", model), labelled(labels, "load"),
+            [&]() { objFile = OBJFile(fileName); });
+  if (!objFile.loadedSuccessfully()) {
+    qDebug() << " * Skipping" << fileName;
+    return;
+  }
+
+  MeshInitializer meshInitializer;
+  Mesh mesh;
+  suite.run(benchmarkName("construct", model), labelled(labels, "construct"),
+            [&]() { mesh = meshInitializer.constructHalfEdgeMesh(objFile); });
+
+  CatmullClarkSubdivider subdivider;
+  CompactMesh controlMesh(mesh);
+  for (int level = 0; level <= maxLevel; level++) {
+    if (level > 0) {
+      Mesh refinedMesh;
+      suite.run(benchmarkName("subdivide", model, level),
+                labelled(labels, "subdivide", level),
+                [&]() { refinedMesh = subdivider.subdivide(mesh); });
+
+      CompactMesh compactMesh(mesh);
+      CompactMesh refinedCompactMesh;
+      suite.run(benchmarkName("subdivide_compact", model, level),
+                labelled(labels, "subdivide_compact", level), [&]() {
+                  refinedCompactMesh = subdivider.subdivide(compactMesh);
+                });
+      mesh = refinedMesh;
+
+      // Re-evaluating the level after the control points moved.
+      StencilTable stencilTable;
+      suite.run(benchmarkName("build_stencils", model, level),
+                labelled(labels, "build_stencils", level),
+                [&]() { stencilTable = StencilTable(controlMesh, level); });
+      QVector<QVector3D> coords;
+      suite.run(benchmarkName("apply_stencils", model, level),
+                labelled(labels, "apply_stencils", level), [&]() {
+                  stencilTable.apply(controlMesh.getVertexCoords(), coords);
+                });
+    }
+
+    QJsonObject levelLabels = labels;
+    levelLabels["faces"] = mesh.numFaces();
+    levelLabels["vertices"] = mesh.numVerts();
+    suite.run(benchmarkName("extractAttributes", model, level),
+              labelled(levelLabels, "extractAttributes", level),
+              [&]() { mesh.extractAttributes(); });
+    suite.run(benchmarkName("recalculateNormals", model, level),
+              labelled(levelLabels, "recalculateNormals", level),
+              [&]() { mesh.recalculateNormals(); });
+    suite.run(benchmarkName("computeRegularPatchIndices", model, level),
+              labelled(levelLabels, "computeRegularPatchIndices", level),
+              [&]() { mesh.computeRegularPatchIndices(); });
+  }
+}
+
+/**
+ * @brief main Runs the benchmarks on every model in a directory and writes
+ * the results as JSON. Does not need OpenGL.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return Exit code.
+ */
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("bench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Benchmarks loading, construction, subdivision and buffer extraction "
+      "on every .obj model in a directory.");
+  parser.addHelpOption();
+  QCommandLineOption modelsOption("models", "Directory of the models.",
+                                  "directory", BENCH_MODELS_DIR);
+  QCommandLineOption outputOption(
+      QStringList() << "o" << "output",
+      "Writes the results to <file> instead of the standard output.", "file");
+  QCommandLineOption levelOption("max-level", "Highest subdivision level.",
+                                 "level", "5");
+  QCommandLineOption repetitionsOption(
+      "repetitions", "Number of runs of every benchmark.", "count", "3");
+  QCommandLineOption filterOption(
+      "filter", "Only benchmarks models whose name contains <text>.", "text");
+  parser.addOption(modelsOption);
+  parser.addOption(outputOption);
+  parser.addOption(levelOption);
+  parser.addOption(repetitionsOption);
+  parser.addOption(filterOption);
+  parser.process(app);
+
+  QDir modelsDir(parser.value(modelsOption));
+  QStringList models =
+      modelsDir.entryList(QStringList() << "*.obj", QDir::Files, QDir::Name);
+  if (models.isEmpty()) {
+    qDebug() << " * No models found in" << modelsDir.path();
+    return 1;
+  }
+
+  BenchmarkSuite suite(parser.value(repetitionsOption).toInt());
+  int maxLevel = parser.value(levelOption).toInt();
+  for (const QString &model : models) {
+    if (model.contains(parser.value(filterOption))) {
+      benchmarkModel(suite, modelsDir.filePath(model), maxLevel);
+    }
+  }
+
+  QFile output;
+  bool opened = false;
+  if (parser.isSet(outputOption)) {
+    output.setFileName(parser.value(outputOption));
+    opened = output.open(QIODevice::WriteOnly);
+  } else {
+    opened = output.open(stdout, QIODevice::WriteOnly);
+  }
+  if (!opened) {
+    qDebug() << " * Could not open" << parser.value(outputOption);
+    return 1;
+  }
+  output.write(suite.toJson().toJson());
+  return 0;
+}
@@ -0,0 +1,211 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include "exporters/objexporter.h"
+#include "exporters/plyexporter.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/objfile.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/stenciltable.h"
+
+/**
+ * @brief reportStage Prints the duration of a stage of the pipeline.
+ * @param out The stream to print to.
+ * @param stage The name of the stage.
+ * @param timer The timer that was started at the beginning of the stage.
+ * @param details Additional information about the result of the stage.
+ */
+static void reportStage(QTextStream &out, const QString &stage,
+                        const QElapsedTimer &timer,
+                        const QString &details = QString()) {
+  out << stage << ": " << timer.nsecsElapsed() / 1e6 << " ms";
+  if (!details.isEmpty()) {
+    out << " (" << details << ")";
+  }
+  out << "\n";
+  out.flush();
+}
+
+/**
+ * @brief main Runs the mesh pipeline without a display: loads a model,
+ * subdivides it, extracts the regular patches and optionally exports the
+ * displaced surface. Reports the duration of every stage.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return Exit code.
+ */
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("AnalyticalDispMapCli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Loads a model, subdivides it, extracts the regular patches and "
+      "optionally exports the tessellated displaced surface.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("model", "The .obj file to load.");
+  QCommandLineOption levelsOption(QStringList() << "l" << "levels",
+                                  "Number of subdivision steps.", "steps",
+                                  "0");
+  QCommandLineOption adaptiveOption(
+      "adaptive",
+      "Uses feature-adaptive instead of uniform subdivision. Cannot be "
+      "combined with --output.");
+  QCommandLineOption outputOption(
+      QStringList() << "o" << "output",
+      "Exports the displaced surface to <file>. The format (.ply or .obj) "
+      "follows from the suffix.",
+      "file");
+  QCommandLineOption tileSizeOption(
+      "tile-size", "Tessellation level and number of displacement tiles.",
+      "size", "4");
+  QCommandLineOption densityOption(
+      "density",
+      "Number of samples per displacement tile in either direction. Levels "
+      "above the hardware limit of 64 are allowed.",
+      "samples", "1");
+  QCommandLineOption amplitudeOption("amplitude", "Displacement amplitude.",
+                                     "amplitude", "0.2");
+  QCommandLineOption displacementOption(
+      "displacement",
+      "Displacement mode: 0 is bubblewrap, 1 pinhead, 2 chocolate bar and 3 "
+      "pseudo-random.",
+      "mode", "0");
+  QCommandLineOption bakedOption(
+      "baked-displacement",
+      "Bakes the displacement coefficients once instead of generating them "
+      "for every vertex.");
+  QCommandLineOption stencilsOption(
+      "stencils",
+      "Computes the refined vertices with a stencil table and reports how "
+      "far they are from the vertices of the subdivider, which are replaced.");
+  QCommandLineOption approximateNormalsOption(
+      "approximate-normals",
+      "Exports the approximate instead of the true normals.");
+  parser.addOption(levelsOption);
+  parser.addOption(adaptiveOption);
+  parser.addOption(outputOption);
+  parser.addOption(tileSizeOption);
+  parser.addOption(densityOption);
+  parser.addOption(amplitudeOption);
+  parser.addOption(displacementOption);
+  parser.addOption(bakedOption);
+  parser.addOption(stencilsOption);
+  parser.addOption(approximateNormalsOption);
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+  if (parser.positionalArguments().size() != 1) {
+    parser.showHelp(1);
+  }
+  QString modelFileName = parser.positionalArguments().first();
+  QString outputFileName = parser.value(outputOption);
+  QString format = QFileInfo(outputFileName).suffix().toLower();
+  if (!outputFileName.isEmpty() && format != "ply" && format != "obj") {
+    err << "Unsupported output format: " << outputFileName << "\n";
+    return 1;
+  }
+  if (!outputFileName.isEmpty() && parser.isSet(adaptiveOption)) {
+    // The Tessellator ignores the levels of the patches and the patches of
+    // irregular faces, so the exported surface would have cracks and holes.
+    err << "Adaptively subdivided meshes cannot be exported\n";
+    return 1;
+  }
+  int levels = parser.value(levelsOption).toInt();
+
+  QElapsedTimer timer;
+  timer.start();
+  OBJFile objFile(modelFileName);
+  if (!objFile.loadedSuccessfully()) {
+    err << "Could not load " << modelFileName << "\n";
+    return 1;
+  }
+  reportStage(out, "load", timer);
+
+  timer.start();
+  MeshInitializer meshInitializer;
+  Mesh mesh = meshInitializer.constructHalfEdgeMesh(objFile);
+  reportStage(out, "construct", timer,
+              QString("%1 faces").arg(mesh.numFaces()));
+
+  bool useStencils = parser.isSet(stencilsOption) &&
+                     !parser.isSet(adaptiveOption);
+  CompactMesh controlMesh;
+  if (useStencils) {
+    controlMesh = CompactMesh(mesh);
+  }
+
+  timer.start();
+  if (parser.isSet(adaptiveOption)) {
+    AdaptiveSubdivider subdivider;
+    mesh = subdivider.subdivide(mesh, levels);
+  } else {
+    CatmullClarkSubdivider subdivider;
+    for (int k = 0; k < levels; k++) {
+      mesh = subdivider.subdivide(mesh);
+    }
+  }
+  reportStage(out, "subdivide", timer,
+              QString("%1 faces").arg(mesh.numFaces()));
+
+  if (useStencils) {
+    timer.start();
+    StencilTable stencilTable(controlMesh, levels);
+    reportStage(out, "build stencils", timer,
+                QString("%1 weights").arg(stencilTable.numWeights()));
+
+    timer.start();
+    QVector<QVector3D> coords;
+    stencilTable.apply(controlMesh.getVertexCoords(), coords);
+    reportStage(out, "apply stencils", timer);
+
+    float maxDistance = 0.0f;
+    for (int v = 0; v < mesh.numVerts(); v++) {
+      maxDistance = qMax(maxDistance,
+                         (coords[v] - mesh.getVertices()[v].coords).length());
+    }
+    out << "stencil error: " << maxDistance << "\n";
+    mesh.setVertexPositions(coords);
+  }
+
+  timer.start();
+  mesh.extractAttributes();
+  mesh.computeRegularPatchIndices();
+  mesh.computeIrregularPatches();
+  reportStage(out, "extract", timer,
+              QString("%1 patches, %2 irregular")
+                  .arg(mesh.getRegularPatchIndices().size() / 16)
+                  .arg(mesh.getIrregularPatchCoords().size() / 16));
+
+  if (outputFileName.isEmpty()) {
+    return 0;
+  }
+
+  timer.start();
+  Tessellator tessellator;
+  tessellator.setTileSize(parser.value(tileSizeOption).toFloat());
+  tessellator.setDensity(qMax(parser.value(densityOption).toInt(), 1));
+  tessellator.setDisplacement(
+      ProceduralDisplacement(parser.value(displacementOption).toInt(),
+                             parser.value(amplitudeOption).toFloat()));
+  tessellator.setTrueNormals(!parser.isSet(approximateNormalsOption));
+  tessellator.setBakedCoefficients(parser.isSet(bakedOption));
+  PLYExporter plyExporter;
+  OBJExporter objExporter;
+  MeshExporter &exporter =
+      format == "ply" ? static_cast<MeshExporter &>(plyExporter)
+                      : static_cast<MeshExporter &>(objExporter);
+  if (!exporter.exportMesh(tessellator, mesh.getVertexCoords(),
+                           mesh.getRegularPatchIndices(), outputFileName)) {
+    err << "Could not export " << outputFileName << "\n";
+    return 1;
+  }
+  reportStage(out, "export", timer,
+              QString("%1 triangles").arg(tessellator.numTriangles()));
+  return 0;
+}
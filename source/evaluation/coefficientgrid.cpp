@@ -0,0 +1,61 @@
+#include "coefficientgrid.h"
+
+#include <cmath>
+
+/**
+ * @brief CoefficientGrid::CoefficientGrid Creates an empty grid.
+ */
+CoefficientGrid::CoefficientGrid() : size(0) {}
+
+/**
+ * @brief CoefficientGrid::CoefficientGrid Bakes the coefficients of a
+ * displacement function.
+ * @param displacement The displacement function.
+ * @param size The tile size, i.e. the number of subpatches in either direction
+ * of a patch.
+ */
+CoefficientGrid::CoefficientGrid(const ProceduralDisplacement &displacement,
+                                 int size)
+    : size(size), coefficients(size * size) {
+  for (int l = 0; l < size; l++) {
+    for (int k = 0; k < size; k++) {
+      coefficients[size * l + k] =
+          displacement.coefficient(float(k) / size, float(l) / size);
+    }
+  }
+}
+
+/**
+ * @brief CoefficientGrid::coefficient Returns a coefficient of the grid.
+ * @param k Index in the u direction. Wraps around.
+ * @param l Index in the v direction. Wraps around.
+ * @return The coefficient.
+ */
+float CoefficientGrid::coefficient(int k, int l) const {
+  k = ((k % size) + size) % size;
+  l = ((l % size) + size) % size;
+  return coefficients[size * l + k];
+}
+
+/**
+ * @brief CoefficientGrid::biquadraticCoefficients Looks up the 3x3 grid of
+ * coefficients of a biquadratic subpatch. Same as
+ * ProceduralDisplacement::biquadraticCoefficients() with a step size of 1 /
+ * size.
+ * @param u First coordinate of the centre of the subpatch, a multiple of 1 /
+ * size.
+ * @param v Second coordinate of the centre of the subpatch, a multiple of 1 /
+ * size.
+ * @param coefficients The coefficients. Coefficient (i, j) is stored at 3 * j +
+ * i, where i is the offset in the u direction and j in the v direction.
+ */
+void CoefficientGrid::biquadraticCoefficients(float u, float v,
+                                              float coefficients[9]) const {
+  int k = int(std::lround(u * size));
+  int l = int(std::lround(v * size));
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 3; i++) {
+      coefficients[3 * j + i] = coefficient(k + i - 1, l + j - 1);
+    }
+  }
+}
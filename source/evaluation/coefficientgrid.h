@@ -0,0 +1,36 @@
+#ifndef COEFFICIENT_GRID_H
+#define COEFFICIENT_GRID_H
+
+#include <QVector>
+
+#include "proceduraldisplacement.h"
+
+/**
+ * @brief The CoefficientGrid class holds precomputed displacement coefficients,
+ * so they do not have to be generated for every sample.
+ *
+ * A patch consists of tileSize x tileSize biquadratic subpatches. The
+ * coefficients of a subpatch are sampled at its centre and at the centres of
+ * its neighbours, which all lie on the grid of points (k / tileSize, l /
+ * tileSize). The displacement function repeats every patch, so
+ * the grid wraps around and tileSize x tileSize coefficients are enough. This
+ * requires a whole tile size.
+ */
+class CoefficientGrid {
+ public:
+  CoefficientGrid();
+  CoefficientGrid(const ProceduralDisplacement& displacement, int size);
+
+  float coefficient(int k, int l) const;
+  void biquadraticCoefficients(float u, float v, float coefficients[9]) const;
+
+  inline int getSize() const { return size; }
+  inline const QVector<float>& getCoefficients() const { return coefficients; }
+
+ private:
+  int size;
+  // Coefficient (k, l) is stored at size * l + k.
+  QVector<float> coefficients;
+};
+
+#endif  // COEFFICIENT_GRID_H
@@ -0,0 +1,464 @@
+#include "patchbvh.h"
+
+#include <QVector4D>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "util/parallel.h"
+
+#define HALF_PI 1.57079633f
+// Cone angle of patches whose normals cannot be bounded. Never culled.
+#define UNBOUNDED_CONE_ANGLE 3.14159265f
+
+/**
+ * @brief secondDifference Second difference of three consecutive control
+ * points. Symmetric in a and c, also in floating point.
+ */
+static inline QVector3D secondDifference(const QVector3D &a, const QVector3D &b,
+                                         const QVector3D &c) {
+  return (a + c) - 2.0f * b;
+}
+
+/**
+ * @brief edgeCurvature Bounds the second derivative of a boundary curve of a
+ * patch. The boundary curve is a cubic B-spline whose control points are
+ * weighted averages of three rows of control points of the patch.
+ * @param outer The outer rows, which are interchangeable.
+ * @param otherOuter See outer.
+ * @param middle The middle row, on the boundary.
+ * @return The maximum length of the second differences of the control points
+ * of the boundary curve.
+ */
+static float edgeCurvature(const QVector3D outer[4],
+                           const QVector3D otherOuter[4],
+                           const QVector3D middle[4]) {
+  QVector3D curve[4];
+  for (int k = 0; k < 4; k++) {
+    curve[k] = ((outer[k] + otherOuter[k]) + 4.0f * middle[k]) / 6.0f;
+  }
+  return std::max(secondDifference(curve[0], curve[1], curve[2]).length(),
+                  secondDifference(curve[1], curve[2], curve[3]).length());
+}
+
+/**
+ * @brief PatchBVH::computeBounds Computes the bounds of a single patch.
+ * @param coords The vertex coordinates of the mesh.
+ * @param indices The indices of the 16 control points of the patch.
+ * @return The bounds of the patch.
+ */
+PatchBounds PatchBVH::computeBounds(const QVector<QVector3D> &coords,
+                                    const unsigned int *indices) {
+  // Control point (i, j) is stored at 4 * j + i, where i is the index in the u
+  // direction and j in the v direction. Same as displace.tese.
+  QVector3D points[16];
+  PatchBounds bounds;
+  bounds.min = QVector3D(FLT_MAX, FLT_MAX, FLT_MAX);
+  bounds.max = -bounds.min;
+  for (int k = 0; k < 16; k++) {
+    points[k] = coords[indices[k]];
+    for (int c = 0; c < 3; c++) {
+      bounds.min[c] = std::min(bounds.min[c], points[k][c]);
+      bounds.max[c] = std::max(bounds.max[c], points[k][c]);
+    }
+  }
+
+  // The partial derivatives are convex combinations of the differences of
+  // adjacent control points.
+  QVector3D du[12], dv[12];
+  float maxSpeed = 0.0f;
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 3; i++) {
+      du[3 * j + i] = points[4 * j + i + 1] - points[4 * j + i];
+      dv[3 * j + i] = points[4 * (i + 1) + j] - points[4 * i + j];
+      maxSpeed = std::max(maxSpeed, du[3 * j + i].length());
+      maxSpeed = std::max(maxSpeed, dv[3 * j + i].length());
+    }
+  }
+
+  // The cross product is bilinear, so the normal du x dv is a convex
+  // combination of the cross products of these differences.
+  QVector3D normals[144];
+  QVector3D axis;
+  for (int a = 0; a < 12; a++) {
+    for (int b = 0; b < 12; b++) {
+      QVector3D normal = QVector3D::crossProduct(du[a], dv[b]);
+      normals[12 * a + b] = normal;
+      axis += normal.normalized();
+    }
+  }
+  axis.normalize();
+
+  float minArea = FLT_MAX;
+  float minCos = 1.0f;
+  for (const QVector3D &normal : normals) {
+    float projection = QVector3D::dotProduct(normal, axis);
+    minArea = std::min(minArea, projection);
+    if (projection > 0.0f) {
+      minCos = std::min(minCos, projection / normal.length());
+    }
+  }
+  bounds.coneAxis = axis;
+  if (minArea > 0.0f) {
+    bounds.coneAngle = std::acos(std::min(std::max(minCos, -1.0f), 1.0f));
+    bounds.slopeFactor = maxSpeed / minArea;
+  } else {
+    bounds.coneAngle = UNBOUNDED_CONE_ANGLE;
+    bounds.slopeFactor = 0.0f;
+  }
+
+  // The second derivatives are convex combinations of the second differences.
+  float uu = 0.0f;
+  float vv = 0.0f;
+  float uv = 0.0f;
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 2; i++) {
+      uu = std::max(uu, secondDifference(points[4 * j + i],
+                                         points[4 * j + i + 1],
+                                         points[4 * j + i + 2])
+                            .length());
+      vv = std::max(vv, secondDifference(points[4 * i + j],
+                                         points[4 * (i + 1) + j],
+                                         points[4 * (i + 2) + j])
+                            .length());
+    }
+  }
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 3; i++) {
+      QVector3D twist = (points[4 * (j + 1) + i + 1] + points[4 * j + i]) -
+                        (points[4 * j + i + 1] + points[4 * (j + 1) + i]);
+      uv = std::max(uv, twist.length());
+    }
+  }
+  bounds.curvature = uu + 2.0f * uv + vv;
+
+  // Rows and columns of control points.
+  QVector3D rows[4][4], columns[4][4];
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 4; i++) {
+      rows[j][i] = points[4 * j + i];
+      columns[i][j] = points[4 * j + i];
+    }
+  }
+  // The sides u = 0, v = 0, u = 1 and v = 1.
+  bounds.edgeCurvature[0] = edgeCurvature(columns[0], columns[2], columns[1]);
+  bounds.edgeCurvature[1] = edgeCurvature(rows[0], rows[2], rows[1]);
+  bounds.edgeCurvature[2] = edgeCurvature(columns[1], columns[3], columns[2]);
+  bounds.edgeCurvature[3] = edgeCurvature(rows[1], rows[3], rows[2]);
+
+  bounds.tileScale = 1.0f;
+  for (int s = 0; s < 4; s++) {
+    bounds.edgeTileScale[s] = 0.0f;
+  }
+  bounds.irregularSides = 0;
+  return bounds;
+}
+
+/**
+ * @brief PatchBVH::PatchBVH Creates an empty hierarchy.
+ */
+PatchBVH::PatchBVH() {}
+
+/**
+ * @brief PatchBVH::build Computes the bounds of the patches and builds the
+ * hierarchy by splitting the patches at the median of their centres along the
+ * longest axis of the node.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch, as
+ * computed by Mesh::computeRegularPatchIndices().
+ * @param patchLevels The subdivision levels of the patches and of their
+ * neighbours, as computed by the AdaptiveSubdivider, or empty if all patches
+ * have the same level.
+ * @param irregularSides For every patch, the sides that border the patch of
+ * an irregular face, as computed by Mesh::computeIrregularPatches(), or empty
+ * if there are none.
+ */
+void PatchBVH::build(const QVector<QVector3D> &coords,
+                     const QVector<unsigned int> &patchIndices,
+                     const QVector<int> &patchLevels,
+                     const QVector<int> &irregularSides) {
+  int patchCount = patchIndices.size() / 16;
+  QVector<PatchBounds> patchBounds(patchCount);
+  QVector<QVector3D> centres(patchCount);
+  parallelFor(
+      0, patchCount,
+      [&](int begin, int end) {
+        for (int p = begin; p < end; p++) {
+          patchBounds[p] =
+              computeBounds(coords, patchIndices.constData() + 16 * p);
+          centres[p] = 0.5f * (patchBounds[p].min + patchBounds[p].max);
+        }
+      },
+      256);
+
+  if (patchLevels.size() == 5 * patchCount) {
+    int finest = 0;
+    for (int p = 0; p < patchCount; p++) {
+      finest = std::max(finest, patchLevels[5 * p]);
+    }
+    for (int p = 0; p < patchCount; p++) {
+      const int *levels = patchLevels.constData() + 5 * p;
+      patchBounds[p].tileScale = std::ldexp(1.0f, finest - levels[0]);
+      for (int s = 0; s < 4; s++) {
+        if (levels[1 + s] != levels[0]) {
+          int coarsest = std::min(levels[0], levels[1 + s]);
+          patchBounds[p].edgeTileScale[s] = std::ldexp(1.0f, finest - coarsest);
+        }
+      }
+    }
+  }
+  if (irregularSides.size() == patchCount) {
+    for (int p = 0; p < patchCount; p++) {
+      patchBounds[p].irregularSides = irregularSides[p];
+    }
+  }
+
+  QVector<int> order(patchCount);
+  for (int p = 0; p < patchCount; p++) {
+    order[p] = p;
+  }
+  nodes.clear();
+  if (patchCount > 0) {
+    nodes.reserve(4 * patchCount / PATCH_BVH_LEAF_SIZE + 1);
+    buildNode(order, centres, 0, patchCount);
+  }
+
+  bounds.resize(patchCount);
+  for (int k = 0; k < patchCount; k++) {
+    bounds[k] = patchBounds[order[k]];
+  }
+  patchOrder = order;
+
+  // Children come after their parents, so compute the bounds bottom-up.
+  for (int n = nodes.size() - 1; n >= 0; n--) {
+    Node &node = nodes[n];
+    if (node.left < 0) {
+      node.min = bounds[node.begin].min;
+      node.max = bounds[node.begin].max;
+      for (int k = node.begin + 1; k < node.end; k++) {
+        for (int c = 0; c < 3; c++) {
+          node.min[c] = std::min(node.min[c], bounds[k].min[c]);
+          node.max[c] = std::max(node.max[c], bounds[k].max[c]);
+        }
+      }
+    } else {
+      const Node &left = nodes[node.left];
+      const Node &right = nodes[node.right];
+      for (int c = 0; c < 3; c++) {
+        node.min[c] = std::min(left.min[c], right.min[c]);
+        node.max[c] = std::max(left.max[c], right.max[c]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief PatchBVH::buildNode Builds the node that covers a range of patches
+ * and its descendants. Reorders the patches within the range.
+ * @param order The original indices of the patches, in the order of the
+ * hierarchy.
+ * @param centres The centres of the bounding boxes of the patches, by original
+ * index.
+ * @param begin The first patch of the node.
+ * @param end One past the last patch of the node.
+ * @return The index of the node.
+ */
+int PatchBVH::buildNode(QVector<int> &order, const QVector<QVector3D> &centres,
+                        int begin, int end) {
+  int index = nodes.size();
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = -1;
+  node.right = -1;
+  nodes.append(node);
+  if (end - begin <= PATCH_BVH_LEAF_SIZE) {
+    return index;
+  }
+
+  QVector3D min = centres[order[begin]];
+  QVector3D max = min;
+  for (int k = begin + 1; k < end; k++) {
+    for (int c = 0; c < 3; c++) {
+      min[c] = std::min(min[c], centres[order[k]][c]);
+      max[c] = std::max(max[c], centres[order[k]][c]);
+    }
+  }
+  QVector3D extent = max - min;
+  int axis = 0;
+  if (extent[1] > extent[axis]) {
+    axis = 1;
+  }
+  if (extent[2] > extent[axis]) {
+    axis = 2;
+  }
+
+  int middle = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + middle,
+                   order.begin() + end, [&](int a, int b) {
+                     return centres[a][axis] < centres[b][axis];
+                   });
+  int left = buildNode(order, centres, begin, middle);
+  int right = buildNode(order, centres, middle, end);
+  nodes[index].left = left;
+  nodes[index].right = right;
+  return index;
+}
+
+/**
+ * @brief PatchBVH::orderedPatchIndices Reorders the patch indices in the order
+ * of the hierarchy.
+ * @param patchIndices The patch indices the hierarchy was built with.
+ * @return The reordered patch indices.
+ */
+QVector<unsigned int> PatchBVH::orderedPatchIndices(
+    const QVector<unsigned int> &patchIndices) const {
+  QVector<unsigned int> ordered(patchIndices.size());
+  for (int k = 0; k < patchOrder.size(); k++) {
+    std::copy(patchIndices.constData() + 16 * patchOrder[k],
+              patchIndices.constData() + 16 * (patchOrder[k] + 1),
+              ordered.data() + 16 * k);
+  }
+  return ordered;
+}
+
+/**
+ * @brief PatchBVH::boundsData Packs the bounds that the shaders use, in the
+ * order of the hierarchy. Every patch has PATCH_BOUNDS_TEXELS RGBA texels: the
+ * cone axis and angle, the centre and radius of the bounding sphere, the slope
+ * factor, curvature, tile scale and the sides that border irregular patches,
+ * the curvatures of the edges and the tile scales of the edges.
+ * @return The packed bounds.
+ */
+QVector<float> PatchBVH::boundsData() const {
+  QVector<float> data(4 * PATCH_BOUNDS_TEXELS * bounds.size(), 0.0f);
+  float *texel = data.data();
+  for (const PatchBounds &patch : bounds) {
+    QVector3D centre = 0.5f * (patch.min + patch.max);
+    float radius = 0.5f * (patch.max - patch.min).length();
+    texel[0] = patch.coneAxis.x();
+    texel[1] = patch.coneAxis.y();
+    texel[2] = patch.coneAxis.z();
+    texel[3] = patch.coneAngle;
+    texel[4] = centre.x();
+    texel[5] = centre.y();
+    texel[6] = centre.z();
+    texel[7] = radius;
+    texel[8] = patch.slopeFactor;
+    texel[9] = patch.curvature;
+    texel[10] = patch.tileScale;
+    texel[11] = float(patch.irregularSides);
+    for (int s = 0; s < 4; s++) {
+      texel[12 + s] = patch.edgeCurvature[s];
+      texel[16 + s] = patch.edgeTileScale[s];
+    }
+    texel += 4 * PATCH_BOUNDS_TEXELS;
+  }
+  return data;
+}
+
+/**
+ * @brief PatchBVH::cull Finds the patches whose bounding boxes intersect the
+ * view frustum.
+ * @param viewProjection The matrix that transforms the vertex coordinates to
+ * clip space.
+ * @param inflation Distance by which the bounding boxes are grown, e.g. the
+ * maximum displacement.
+ * @param ranges The ranges of visible patches in the order of the hierarchy,
+ * as pairs of begin and end (exclusive). Adjacent ranges are merged.
+ */
+void PatchBVH::cull(const QMatrix4x4 &viewProjection, float inflation,
+                    QVector<QPair<int, int>> &ranges) const {
+  ranges.clear();
+  if (nodes.isEmpty()) {
+    return;
+  }
+  // The planes of the frustum, with normals that point inwards.
+  QVector4D planes[6];
+  for (int k = 0; k < 3; k++) {
+    planes[2 * k] = viewProjection.row(3) + viewProjection.row(k);
+    planes[2 * k + 1] = viewProjection.row(3) - viewProjection.row(k);
+  }
+  cullNode(0, planes, inflation, ranges);
+}
+
+/**
+ * @brief PatchBVH::cullNode Culls a node and its descendants against the view
+ * frustum.
+ * @param node The index of the node.
+ * @param planes The planes of the frustum.
+ * @param inflation Distance by which the bounding boxes are grown.
+ * @param ranges The ranges of visible patches found so far.
+ */
+void PatchBVH::cullNode(int node, const QVector4D planes[6], float inflation,
+                        QVector<QPair<int, int>> &ranges) const {
+  const Node &current = nodes[node];
+  QVector3D min = current.min - QVector3D(inflation, inflation, inflation);
+  QVector3D max = current.max + QVector3D(inflation, inflation, inflation);
+  bool inside = true;
+  for (int k = 0; k < 6; k++) {
+    const QVector4D &plane = planes[k];
+    // The corners of the box furthest along and against the plane normal.
+    QVector3D positive(plane.x() >= 0 ? max.x() : min.x(),
+                       plane.y() >= 0 ? max.y() : min.y(),
+                       plane.z() >= 0 ? max.z() : min.z());
+    QVector3D negative(plane.x() >= 0 ? min.x() : max.x(),
+                       plane.y() >= 0 ? min.y() : max.y(),
+                       plane.z() >= 0 ? min.z() : max.z());
+    if (QVector3D::dotProduct(plane.toVector3D(), positive) + plane.w() < 0) {
+      return;
+    }
+    if (QVector3D::dotProduct(plane.toVector3D(), negative) + plane.w() < 0) {
+      inside = false;
+    }
+  }
+
+  if (inside || current.left < 0) {
+    if (!ranges.isEmpty() && ranges.last().second == current.begin) {
+      ranges.last().second = current.end;
+    } else {
+      ranges.append(qMakePair(current.begin, current.end));
+    }
+    return;
+  }
+  cullNode(current.left, planes, inflation, ranges);
+  cullNode(current.right, planes, inflation, ranges);
+}
+
+/**
+ * @brief PatchBVH::backFacing Checks whether a patch is facing away from the
+ * eye, i.e. whether every normal of the patch points away from every point
+ * of its bounding sphere. Same as patchBackFacing() in patchbounds.glsl.
+ * @param patch The patch, in the order of the hierarchy.
+ * @param eye The position of the eye in the coordinates of the vertices.
+ * @param inflation Distance by which the bounding sphere is grown, e.g. the
+ * maximum displacement.
+ * @param gradient Bound on the length of the gradient of the displacement in
+ * the (u, v) domain of a patch with a tile scale of 1, which tilts the
+ * normals.
+ * @return True if the patch is back-facing; false if it may be visible.
+ */
+bool PatchBVH::backFacing(int patch, const QVector3D &eye, float inflation,
+                          float gradient) const {
+  const PatchBounds &patchBounds = bounds[patch];
+  // The displaced normal is the base normal plus a tangent vector of length at
+  // most 2 * gradient * maxSpeed. Neglects the curvature of the base surface.
+  float angle =
+      patchBounds.coneAngle +
+      std::atan(2.0f * gradient * patchBounds.tileScale *
+                patchBounds.slopeFactor);
+  QVector3D centre = 0.5f * (patchBounds.min + patchBounds.max);
+  float radius = 0.5f * (patchBounds.max - patchBounds.min).length() + inflation;
+  QVector3D toEye = eye - centre;
+  float distance = toEye.length();
+  if (distance <= radius) {
+    return false;
+  }
+  // The directions from the sphere to the eye lie in a cone as well.
+  angle += std::asin(radius / distance);
+  if (angle >= HALF_PI) {
+    return false;
+  }
+  return QVector3D::dotProduct(patchBounds.coneAxis, toEye) / distance <
+         -std::sin(angle);
+}
@@ -0,0 +1,107 @@
+#ifndef PATCH_BVH_H
+#define PATCH_BVH_H
+
+#include <QMatrix4x4>
+#include <QPair>
+#include <QVector3D>
+#include <QVector>
+
+// Maximum number of patches in a leaf of the hierarchy.
+#define PATCH_BVH_LEAF_SIZE 16
+// Number of RGBA texels per patch in PatchBVH::boundsData().
+#define PATCH_BOUNDS_TEXELS 5
+
+/**
+ * Conservative bounds of a bicubic B-spline patch, which follow from the
+ * convex hull property: the patch lies within the bounding box of its control
+ * points and its partial derivatives lie within the convex hulls of the
+ * (second) differences of adjacent control points.
+ */
+typedef struct PatchBounds {
+  QVector3D min, max;
+  // Every normal of the patch makes an angle of at most coneAngle with the
+  // axis. The angle is at least pi / 2 if the normals cannot be bounded.
+  QVector3D coneAxis;
+  float coneAngle;
+  // Ratio of the maximum length of the partial derivatives to the minimum
+  // length of the normal. Bounds how far a displacement tilts the normals.
+  float slopeFactor;
+  // Bound on |f_uu| + 2 |f_uv| + |f_vv|. Linearly interpolating the patch over
+  // a grid with spacing h is off by at most curvature * h^2 / 8.
+  float curvature;
+  // The same bound for the boundary curves, in the order of the outer
+  // tessellation levels. Only depends on the control points that the
+  // adjacent patch shares, so both patches compute the same value.
+  float edgeCurvature[4];
+  // Number of displacement tiles of the patch relative to a patch of the
+  // finest subdivision level, in either direction. Only differs from 1 for
+  // meshes created by the AdaptiveSubdivider.
+  float tileScale;
+  // For sides where the patch meets patches of another level, the tile scale
+  // of the coarser of the two; 0 for the other sides. In the order of the
+  // outer tessellation levels.
+  float edgeTileScale[4];
+  // Bit mask of the sides that border the patch of an irregular face, in the
+  // order of the outer tessellation levels.
+  int irregularSides;
+} PatchBounds;
+
+/**
+ * @brief The PatchBVH class is a bounding volume hierarchy over the regular
+ * patches of a mesh. The patches are reordered such that every node of the
+ * hierarchy covers a contiguous range of patches, so culling the hierarchy
+ * results in ranges of patches that can be drawn directly.
+ *
+ * Besides the frustum culling on the CPU, the bounds are used by the
+ * tessellation control shaders to skip back-facing patches and to choose
+ * tessellation levels. They read the bounds from a buffer texture, see
+ * patchbounds.glsl.
+ */
+class PatchBVH {
+ public:
+  PatchBVH();
+
+  static PatchBounds computeBounds(const QVector<QVector3D>& coords,
+                                   const unsigned int* indices);
+
+  void build(const QVector<QVector3D>& coords,
+             const QVector<unsigned int>& patchIndices,
+             const QVector<int>& patchLevels = QVector<int>(),
+             const QVector<int>& irregularSides = QVector<int>());
+  QVector<unsigned int> orderedPatchIndices(
+      const QVector<unsigned int>& patchIndices) const;
+  QVector<float> boundsData() const;
+
+  void cull(const QMatrix4x4& viewProjection, float inflation,
+            QVector<QPair<int, int>>& ranges) const;
+  bool backFacing(int patch, const QVector3D& eye, float inflation,
+                  float gradient) const;
+
+  inline int numPatches() const { return bounds.size(); }
+  inline const PatchBounds& getBounds(int patch) const {
+    return bounds[patch];
+  }
+
+ private:
+  typedef struct Node {
+    QVector3D min, max;
+    // The range of patches covered by the node.
+    int begin, end;
+    // Indices of the children, or -1 for a leaf.
+    int left, right;
+  } Node;
+
+  int buildNode(QVector<int>& order, const QVector<QVector3D>& centres,
+                int begin, int end);
+  void cullNode(int node, const QVector4D planes[6], float inflation,
+                QVector<QPair<int, int>>& ranges) const;
+
+  // The bounds of every patch, in the order of the hierarchy.
+  QVector<PatchBounds> bounds;
+  // For every patch in the order of the hierarchy, its original index.
+  QVector<int> patchOrder;
+  // The nodes of the hierarchy. The root is the first node.
+  QVector<Node> nodes;
+};
+
+#endif  // PATCH_BVH_H
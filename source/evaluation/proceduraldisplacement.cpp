@@ -0,0 +1,184 @@
+#include "proceduraldisplacement.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "coefficientgrid.h"
+
+// Same constants as procedural.glsl.
+#define M_PI_GLSL 3.1415926538f
+#define FREQ 0.5f
+
+/**
+ * @brief fract Fractional part of a number, same as fract() and mod(x, 1.) in
+ * GLSL.
+ * @param x The number.
+ * @return x - floor(x).
+ */
+static inline float fract(float x) { return x - std::floor(x); }
+
+/**
+ * @brief random Pseudo-random number generator of procedural.glsl.
+ * @param u First coordinate.
+ * @param v Second coordinate.
+ * @return A number in [0, 1).
+ */
+static inline float random(float u, float v) {
+  return fract(std::sin(u * 12.9898f + v * 78.233f) * 43758.5453f);
+}
+
+/**
+ * @brief mix Linear interpolation, same as mix() in GLSL.
+ */
+static inline float mix(float a, float b, float t) { return a + t * (b - a); }
+
+/**
+ * @brief ProceduralDisplacement::ProceduralDisplacement Creates the default
+ * displacement function, which is the same as the default settings.
+ */
+ProceduralDisplacement::ProceduralDisplacement()
+    : ProceduralDisplacement(0, 0.2f) {}
+
+/**
+ * @brief ProceduralDisplacement::ProceduralDisplacement Creates a displacement
+ * function.
+ * @param mode The displacement mode. 0 is the 2D sinusoid, 1 is the pinhead,
+ * 2 is the chocolate bar and 3 is the pseudo-random function. Other modes use
+ * white noise.
+ * @param amplitude The amplitude of the displacement.
+ */
+ProceduralDisplacement::ProceduralDisplacement(int mode, float amplitude)
+    : mode(mode), amplitude(amplitude) {}
+
+/**
+ * @brief ProceduralDisplacement::coefficient Computes a single displacement
+ * coefficient. Same as coeff() in procedural.glsl.
+ * @param u First coordinate. Only its fractional part is used.
+ * @param v Second coordinate. Only its fractional part is used.
+ * @return The displacement coefficient.
+ */
+float ProceduralDisplacement::coefficient(float u, float v) const {
+  // Forcing turnable symmetry around 0.5, 0.5
+  u = fract(u);
+  v = fract(v);
+
+  if (v <= u && 1.0f - u < v) {
+    float tmp = u;
+    u = v;
+    v = 1.0f - tmp;
+  } else if (v > u && 1.0f - u <= v) {
+    u = 1.0f - u;
+    v = 1.0f - v;
+  } else if (v >= u && 1.0f - u > v) {
+    float tmp = u;
+    u = 1.0f - v;
+    v = tmp;
+  }
+
+  // Making each of the 4 triangles into two mirrored right angle triangles
+  if (u > 0.5f) {
+    u = 1.0f - u;
+  }
+
+  switch (mode) {
+    case 0:  // 2D sinusoid (Bubblewrap)
+      return amplitude * std::sin(2 * M_PI_GLSL * FREQ * u) *
+             std::sin(2 * M_PI_GLSL * FREQ * v);
+    case 1:  // Pinhead
+      if (v > 0.4501f) {
+        return 2 * amplitude;
+      }
+      return std::min(1.0f, v * 10.0f) * amplitude - amplitude;
+    case 2:  // Chocolate bar
+      return std::min(1.0f, v * 5.0f) * amplitude;
+    case 3: {  // Pseudo-random
+      u = 7.0f * u;
+      v = 7.1f * v;
+      float uFloor = std::floor(u);
+      float vFloor = std::floor(v);
+      float uCeil = std::ceil(u);
+      float vCeil = std::ceil(v);
+      float a = mix(random(uFloor, vFloor), random(uCeil, vFloor), fract(u));
+      float b = mix(random(uFloor, vCeil), random(uCeil, vCeil), fract(u));
+      return mix(a, b, fract(v)) * amplitude;
+    }
+  }
+  return random(u, v) * amplitude;
+}
+
+/**
+ * @brief ProceduralDisplacement::biquadraticCoefficients Computes the 3x3 grid
+ * of coefficients of a biquadratic subpatch. Same as biquadraticCoeff() in
+ * procedural.glsl.
+ * @param u First coordinate of the centre of the grid.
+ * @param v Second coordinate of the centre of the grid.
+ * @param r Step size of the grid.
+ * @param coefficients The coefficients. Coefficient (i, j) is stored at 3 * j +
+ * i, where i is the offset in the u direction and j in the v direction.
+ */
+void ProceduralDisplacement::biquadraticCoefficients(
+    float u, float v, float r, float coefficients[9]) const {
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 3; i++) {
+      coefficients[3 * j + i] = coefficient(u + (i - 1) * r, v + (j - 1) * r);
+    }
+  }
+}
+
+/**
+ * @brief ProceduralDisplacement::coefficientBounds Computes bounds on the
+ * coefficients. The displacement is a convex combination of coefficients, so
+ * these also bound the displacement. Same as coefficientBounds() in
+ * patchbounds.glsl.
+ * @param lower Lower bound on the coefficients.
+ * @param upper Upper bound on the coefficients.
+ */
+void ProceduralDisplacement::coefficientBounds(float &lower,
+                                               float &upper) const {
+  // Bounds for an amplitude of 1.
+  lower = mode == 1 ? -1.0f : 0.0f;
+  upper = mode == 1 ? 2.0f : 1.0f;
+  lower *= amplitude;
+  upper *= amplitude;
+  if (lower > upper) {
+    std::swap(lower, upper);
+  }
+}
+
+/**
+ * @brief ProceduralDisplacement::curvatureBound Bounds the second derivatives
+ * of the displacement, |d_uu| + 2 |d_uv| + |d_vv|, in the (u, v) domain of a
+ * patch. Like the bounds of PatchBVH, the derivatives of the biquadratic
+ * subpatches are convex combinations of the second differences of their
+ * coefficients. Derivatives of the normal are not taken into account.
+ * @param tileSize The tile size. The coefficients are spaced 1 / tileSize
+ * apart.
+ * @return The bound. Grows with the square of the tile size.
+ */
+float ProceduralDisplacement::curvatureBound(float tileSize) const {
+  int size = int(std::lround(tileSize));
+  float scale = tileSize * tileSize;
+  if (size < 1 || float(size) != tileSize) {
+    // Every second difference is at most twice the range of the coefficients.
+    float lower, upper;
+    coefficientBounds(lower, upper);
+    return 8.0f * (upper - lower) * scale;
+  }
+  CoefficientGrid grid(*this, size);
+  float uu = 0.0f;
+  float vv = 0.0f;
+  float uv = 0.0f;
+  for (int l = 0; l < size; l++) {
+    for (int k = 0; k < size; k++) {
+      float c = grid.coefficient(k, l);
+      uu = std::max(uu, std::abs(grid.coefficient(k - 1, l) +
+                                 grid.coefficient(k + 1, l) - 2.0f * c));
+      vv = std::max(vv, std::abs(grid.coefficient(k, l - 1) +
+                                 grid.coefficient(k, l + 1) - 2.0f * c));
+      uv = std::max(uv, std::abs(grid.coefficient(k + 1, l + 1) + c -
+                                 grid.coefficient(k + 1, l) -
+                                 grid.coefficient(k, l + 1)));
+    }
+  }
+  return (uu + 2.0f * uv + vv) * scale;
+}
@@ -0,0 +1,29 @@
+#ifndef PROCEDURAL_DISPLACEMENT_H
+#define PROCEDURAL_DISPLACEMENT_H
+
+/**
+ * @brief The ProceduralDisplacement class generates the biquadratic
+ * displacement coefficients on the CPU. It mirrors procedural.glsl, so the
+ * coefficients are the same as the ones used by the displacement shaders.
+ */
+class ProceduralDisplacement {
+ public:
+  ProceduralDisplacement();
+  ProceduralDisplacement(int mode, float amplitude);
+
+  float coefficient(float u, float v) const;
+  void biquadraticCoefficients(float u, float v, float r,
+                               float coefficients[9]) const;
+  void coefficientBounds(float& lower, float& upper) const;
+  float curvatureBound(float tileSize) const;
+
+  inline int getMode() const { return mode; }
+  inline float getAmplitude() const { return amplitude; }
+
+ private:
+  // Same as displacement_mode in the settings.
+  int mode;
+  float amplitude;
+};
+
+#endif  // PROCEDURAL_DISPLACEMENT_H
@@ -0,0 +1,507 @@
+#include "surfaceevaluator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/parallel.h"
+
+// Number of samples that are evaluated together. Multiple of the SIMD width.
+#define LANES 16
+// Minimum number of blocks that are evaluated by a single task.
+#define MIN_BLOCKS_PER_TASK 64
+
+// One value per lane of a block.
+typedef float Lanes[LANES];
+
+/**
+ * @brief cubicBasis Computes the cubic B-spline basis functions and their
+ * first and second derivatives. Same as multiplying cubicM in displace.tese
+ * with the monomials and their derivatives.
+ * @param t The parameter of every lane.
+ * @param basis The basis functions.
+ * @param derivative The first derivatives of the basis functions.
+ * @param secondDerivative The second derivatives of the basis functions.
+ */
+static void cubicBasis(const Lanes t, Lanes basis[4], Lanes derivative[4],
+                       Lanes secondDerivative[4]) {
+  for (int l = 0; l < LANES; l++) {
+    float t1 = t[l];
+    float t2 = t1 * t1;
+    float t3 = t2 * t1;
+    float s = 1.0f - t1;
+    basis[0][l] = s * s * s / 6.0f;
+    basis[1][l] = (3.0f * t3 - 6.0f * t2 + 4.0f) / 6.0f;
+    basis[2][l] = (-3.0f * t3 + 3.0f * t2 + 3.0f * t1 + 1.0f) / 6.0f;
+    basis[3][l] = t3 / 6.0f;
+    derivative[0][l] = -0.5f * s * s;
+    derivative[1][l] = 1.5f * t2 - 2.0f * t1;
+    derivative[2][l] = -1.5f * t2 + t1 + 0.5f;
+    derivative[3][l] = 0.5f * t2;
+    secondDerivative[0][l] = s;
+    secondDerivative[1][l] = 3.0f * t1 - 2.0f;
+    secondDerivative[2][l] = -3.0f * t1 + 1.0f;
+    secondDerivative[3][l] = t1;
+  }
+}
+
+/**
+ * @brief quadraticBasis Computes the quadratic B-spline basis functions and
+ * their derivatives. Same as multiplying quadratricM in displace.tese with the
+ * monomials and their derivatives.
+ * @param t The parameter of every lane.
+ * @param basis The basis functions.
+ * @param derivative The derivatives of the basis functions.
+ */
+static void quadraticBasis(const Lanes t, Lanes basis[3], Lanes derivative[3]) {
+  for (int l = 0; l < LANES; l++) {
+    float t1 = t[l];
+    float s = 1.0f - t1;
+    basis[0][l] = 0.5f * s * s;
+    basis[1][l] = -t1 * t1 + t1 + 0.5f;
+    basis[2][l] = 0.5f * t1 * t1;
+    derivative[0][l] = -s;
+    derivative[1][l] = 1.0f - 2.0f * t1;
+    derivative[2][l] = t1;
+  }
+}
+
+/**
+ * @brief tensorAccumulatePatch Computes the tensor product of the basis
+ * functions with the control points of the patch of every lane. Same as
+ * tensorAccumulatePatch() in displace.tese.
+ * @param points Per lane, the control points of its patch.
+ * @param x The basis functions in the u direction.
+ * @param y The basis functions in the v direction.
+ * @param result The resulting x-, y- and z-coordinates.
+ */
+static void tensorAccumulatePatch(const float *const points[LANES],
+                                  const Lanes x[4], const Lanes y[4],
+                                  Lanes result[3]) {
+  for (int c = 0; c < 3; c++) {
+    for (int l = 0; l < LANES; l++) {
+      result[c][l] = 0.0f;
+    }
+  }
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 4; i++) {
+      int k = 4 * j + i;
+      for (int l = 0; l < LANES; l++) {
+        float weight = x[i][l] * y[j][l];
+        result[0][l] += weight * points[l][k];
+        result[1][l] += weight * points[l][16 + k];
+        result[2][l] += weight * points[l][32 + k];
+      }
+    }
+  }
+}
+
+/**
+ * @brief cross Computes the cross product of every lane.
+ */
+static void cross(const Lanes a[3], const Lanes b[3], Lanes result[3]) {
+  for (int l = 0; l < LANES; l++) {
+    result[0][l] = a[1][l] * b[2][l] - a[2][l] * b[1][l];
+    result[1][l] = a[2][l] * b[0][l] - a[0][l] * b[2][l];
+    result[2][l] = a[0][l] * b[1][l] - a[1][l] * b[0][l];
+  }
+}
+
+/**
+ * @brief dot Computes the dot product of every lane.
+ */
+static void dot(const Lanes a[3], const Lanes b[3], Lanes result) {
+  for (int l = 0; l < LANES; l++) {
+    result[l] = a[0][l] * b[0][l] + a[1][l] * b[1][l] + a[2][l] * b[2][l];
+  }
+}
+
+/**
+ * @brief SurfaceSamples::SurfaceSamples Creates an empty batch of samples.
+ */
+SurfaceSamples::SurfaceSamples() {}
+
+/**
+ * @brief SurfaceSamples::append Appends a sample. Its position and normal are
+ * zero until it is evaluated.
+ * @param patch The index of the patch.
+ * @param u First parameter of the sample in [0, 1].
+ * @param v Second parameter of the sample in [0, 1].
+ */
+void SurfaceSamples::append(int patch, float u, float v) {
+  int k = size();
+  resize(k + 1);
+  patches[k] = patch;
+  this->u[k] = u;
+  this->v[k] = v;
+}
+
+/**
+ * @brief SurfaceSamples::appendGrid Appends a uniform grid of samples on a
+ * single patch. The grid contains (resolution + 1)^2 samples, including the
+ * boundary of the patch, ordered by v and then by u.
+ * @param patch The index of the patch.
+ * @param resolution The number of intervals in each direction.
+ */
+void SurfaceSamples::appendGrid(int patch, int resolution) {
+  int k = size();
+  resize(k + (resolution + 1) * (resolution + 1));
+  for (int j = 0; j <= resolution; j++) {
+    for (int i = 0; i <= resolution; i++, k++) {
+      patches[k] = patch;
+      u[k] = float(i) / resolution;
+      v[k] = float(j) / resolution;
+    }
+  }
+}
+
+/**
+ * @brief SurfaceSamples::resize Resizes all arrays.
+ * @param size The new number of samples.
+ */
+void SurfaceSamples::resize(int size) {
+  patches.resize(size);
+  u.resize(size);
+  v.resize(size);
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+  normalX.resize(size);
+  normalY.resize(size);
+  normalZ.resize(size);
+}
+
+/**
+ * @brief SurfaceSamples::clear Removes all samples.
+ */
+void SurfaceSamples::clear() { resize(0); }
+
+/**
+ * @brief SurfaceSamples::size Number of samples.
+ * @return The number of samples.
+ */
+int SurfaceSamples::size() const { return patches.size(); }
+
+/**
+ * @brief SurfaceEvaluator::SurfaceEvaluator Creates an evaluator without
+ * patches.
+ */
+SurfaceEvaluator::SurfaceEvaluator()
+    : tileSize(4.0f), trueNormals(true), bakedCoefficients(false) {}
+
+/**
+ * @brief SurfaceEvaluator::SurfaceEvaluator Creates an evaluator for the
+ * regular patches of a mesh.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch, as
+ * computed by Mesh::computeRegularPatchIndices().
+ */
+SurfaceEvaluator::SurfaceEvaluator(const QVector<QVector3D> &coords,
+                                   const QVector<unsigned int> &patchIndices)
+    : SurfaceEvaluator() {
+  setPatches(coords, patchIndices);
+}
+
+/**
+ * @brief SurfaceEvaluator::setPatches Replaces the patches. The control points
+ * are copied, so the evaluator does not depend on the mesh afterwards.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch.
+ */
+void SurfaceEvaluator::setPatches(const QVector<QVector3D> &coords,
+                                  const QVector<unsigned int> &patchIndices) {
+  int patchCount = patchIndices.size() / 16;
+  controlPoints.resize(48 * patchCount);
+  for (int p = 0; p < patchCount; p++) {
+    float *points = controlPoints.data() + 48 * p;
+    for (int k = 0; k < 16; k++) {
+      const QVector3D &point = coords[patchIndices[16 * p + k]];
+      points[k] = point.x();
+      points[16 + k] = point.y();
+      points[32 + k] = point.z();
+    }
+  }
+}
+
+/**
+ * @brief SurfaceEvaluator::setDisplacement Sets the displacement function.
+ * @param displacement The displacement function.
+ */
+void SurfaceEvaluator::setDisplacement(
+    const ProceduralDisplacement &displacement) {
+  this->displacement = displacement;
+  bakeCoefficients();
+}
+
+/**
+ * @brief SurfaceEvaluator::setTileSize Sets the number of biquadratic
+ * subpatches per patch in each direction, same as the tile size setting.
+ * @param tileSize The tile size.
+ */
+void SurfaceEvaluator::setTileSize(float tileSize) {
+  this->tileSize = tileSize;
+  bakeCoefficients();
+}
+
+/**
+ * @brief SurfaceEvaluator::setTrueNormals Sets which normals are computed.
+ * @param trueNormals Whether to compute the true normals, which include the
+ * derivatives of the base surface normal. Otherwise, the approximate normals
+ * are computed, which are also the interpolated normals at the vertices.
+ */
+void SurfaceEvaluator::setTrueNormals(bool trueNormals) {
+  this->trueNormals = trueNormals;
+}
+
+/**
+ * @brief SurfaceEvaluator::setBakedCoefficients Sets whether the displacement
+ * coefficients are baked into a CoefficientGrid once, instead of generated for
+ * every sample. Same as the baked displacement setting. Only applies to whole
+ * tile sizes.
+ * @param bakedCoefficients Whether to bake the coefficients.
+ */
+void SurfaceEvaluator::setBakedCoefficients(bool bakedCoefficients) {
+  this->bakedCoefficients = bakedCoefficients;
+  bakeCoefficients();
+}
+
+/**
+ * @brief SurfaceEvaluator::bakeCoefficients Bakes the coefficients for the
+ * current displacement function and tile size, or clears them if they are not
+ * baked.
+ */
+void SurfaceEvaluator::bakeCoefficients() {
+  if (bakedCoefficients && tileSize >= 1.0f &&
+      tileSize == std::floor(tileSize)) {
+    grid = CoefficientGrid(displacement, int(tileSize));
+  } else {
+    grid = CoefficientGrid();
+  }
+}
+
+/**
+ * @brief SurfaceEvaluator::numPatches Number of patches.
+ * @return The number of patches.
+ */
+int SurfaceEvaluator::numPatches() const { return controlPoints.size() / 48; }
+
+/**
+ * @brief SurfaceEvaluator::evaluate Evaluates the positions and normals of a
+ * batch of samples.
+ * @param samples The samples. Their patch indices should be valid.
+ */
+void SurfaceEvaluator::evaluate(SurfaceSamples &samples) const {
+  int sampleCount = samples.size();
+  samples.resize(sampleCount);
+  int blockCount = (sampleCount + LANES - 1) / LANES;
+  parallelFor(
+      0, blockCount,
+      [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+          int first = b * LANES;
+          evaluateBlock(samples, first, std::min(LANES, sampleCount - first));
+        }
+      },
+      MIN_BLOCKS_PER_TASK);
+}
+
+/**
+ * @brief SurfaceEvaluator::evaluate Evaluates a single sample. Evaluating
+ * batches is a lot faster.
+ * @param patch The index of the patch.
+ * @param u First parameter of the sample in [0, 1].
+ * @param v Second parameter of the sample in [0, 1].
+ * @param normal If not null, the normal is stored here.
+ * @return The position of the sample.
+ */
+QVector3D SurfaceEvaluator::evaluate(int patch, float u, float v,
+                                     QVector3D *normal) const {
+  SurfaceSamples samples;
+  samples.append(patch, u, v);
+  evaluateBlock(samples, 0, 1);
+  if (normal != nullptr) {
+    *normal = QVector3D(samples.normalX[0], samples.normalY[0],
+                        samples.normalZ[0]);
+  }
+  return QVector3D(samples.x[0], samples.y[0], samples.z[0]);
+}
+
+/**
+ * @brief SurfaceEvaluator::evaluateBlock Evaluates a block of at most LANES
+ * consecutive samples. Follows displace.tese step by step. Unused lanes are
+ * evaluated on the first patch, but their results are discarded.
+ * @param samples The samples.
+ * @param begin The index of the first sample of the block.
+ * @param count The number of samples in the block.
+ */
+void SurfaceEvaluator::evaluateBlock(SurfaceSamples &samples, int begin,
+                                     int count) const {
+  // ------------------------- Coordinates --------------------------
+
+  const float *points[LANES];
+  Lanes u, v;
+  for (int l = 0; l < LANES; l++) {
+    bool used = l < count;
+    points[l] = controlPoints.constData() +
+                (used ? 48 * samples.patches[begin + l] : 0);
+    u[l] = used ? samples.u[begin + l] : 0.0f;
+    v[l] = used ? samples.v[begin + l] : 0.0f;
+  }
+
+  // Coordinates within the biquadratic subpatch and the centre of the
+  // subpatch in the (u, v) domain.
+  float r = 1.0f / tileSize;
+  Lanes uHat, vHat, uC, vC;
+  for (int l = 0; l < LANES; l++) {
+    float uScaled = tileSize * u[l] - 0.5f;
+    float vScaled = tileSize * v[l] - 0.5f;
+    uHat[l] = uScaled - std::floor(uScaled);
+    vHat[l] = vScaled - std::floor(vScaled);
+    uC[l] = u[l] + r * (0.5f - uHat[l]);
+    vC[l] = v[l] + r * (0.5f - vHat[l]);
+  }
+
+  // ------------------------ Bicubic patch -------------------------
+
+  Lanes B3u[4], dB3du[4], dB3duu[4];
+  Lanes B3v[4], dB3dv[4], dB3dvv[4];
+  cubicBasis(u, B3u, dB3du, dB3duu);
+  cubicBasis(v, B3v, dB3dv, dB3dvv);
+
+  Lanes s[3], dsdu[3], dsdv[3];
+  tensorAccumulatePatch(points, B3u, B3v, s);
+  tensorAccumulatePatch(points, dB3du, B3v, dsdu);
+  tensorAccumulatePatch(points, B3u, dB3dv, dsdv);
+
+  Lanes Ns[3], NsLength;
+  cross(dsdu, dsdv, Ns);
+  dot(Ns, Ns, NsLength);
+  for (int l = 0; l < LANES; l++) {
+    NsLength[l] = std::sqrt(NsLength[l]);
+    Ns[0][l] /= NsLength[l];
+    Ns[1][l] /= NsLength[l];
+    Ns[2][l] /= NsLength[l];
+  }
+
+  // ---------------------- Biquadratic patch -----------------------
+
+  // The coefficients are generated per lane, since the displacement function
+  // branches. They only depend on the centre of the subpatch, so consecutive
+  // samples in the same subpatch share them.
+  float coefficients[9][LANES];
+  float laneCoefficients[9];
+  for (int l = 0; l < count; l++) {
+    if (l > 0 && uC[l] == uC[l - 1] && vC[l] == vC[l - 1]) {
+      // Same subpatch as the previous lane.
+    } else if (grid.getSize() > 0) {
+      grid.biquadraticCoefficients(uC[l], vC[l], laneCoefficients);
+    } else {
+      displacement.biquadraticCoefficients(uC[l], vC[l], r, laneCoefficients);
+    }
+    for (int k = 0; k < 9; k++) {
+      coefficients[k][l] = laneCoefficients[k];
+    }
+  }
+  for (int l = count; l < LANES; l++) {
+    for (int k = 0; k < 9; k++) {
+      coefficients[k][l] = 0.0f;
+    }
+  }
+
+  Lanes B2u[3], dB2du[3], B2v[3], dB2dv[3];
+  quadraticBasis(uHat, B2u, dB2du);
+  quadraticBasis(vHat, B2v, dB2dv);
+
+  Lanes D, dDdu, dDdv;
+  for (int l = 0; l < LANES; l++) {
+    D[l] = 0.0f;
+    dDdu[l] = 0.0f;
+    dDdv[l] = 0.0f;
+  }
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 3; i++) {
+      for (int l = 0; l < LANES; l++) {
+        float c = coefficients[3 * j + i][l];
+        D[l] += B2u[i][l] * B2v[j][l] * c;
+        dDdu[l] += dB2du[i][l] * B2v[j][l] * c;
+        dDdv[l] += B2u[i][l] * dB2dv[j][l] * c;
+      }
+    }
+  }
+  // The subpatch coordinates change tileSize times as fast.
+  for (int l = 0; l < LANES; l++) {
+    dDdu[l] *= tileSize;
+    dDdv[l] *= tileSize;
+  }
+
+  // ---------------------- Displaced surface -----------------------
+
+  // Approximate partials of the displaced surface f = s + Ns * D
+  Lanes dfdu[3], dfdv[3];
+  for (int c = 0; c < 3; c++) {
+    for (int l = 0; l < LANES; l++) {
+      dfdu[c][l] = dsdu[c][l] + Ns[c][l] * dDdu[l];
+      dfdv[c][l] = dsdv[c][l] + Ns[c][l] * dDdv[l];
+    }
+  }
+
+  // ------------------------- True normals -------------------------
+
+  if (trueNormals) {
+    Lanes dsduu[3], dsdvv[3], dsduv[3];
+    tensorAccumulatePatch(points, dB3duu, B3v, dsduu);
+    tensorAccumulatePatch(points, B3u, dB3dvv, dsdvv);
+    tensorAccumulatePatch(points, dB3du, dB3dv, dsduv);
+
+    // Coefficients of the first and second fundamental forms
+    Lanes Ec, Fc, Gc, Lc, Mc, Nc;
+    dot(dsdu, dsdu, Ec);
+    dot(dsdu, dsdv, Fc);
+    dot(dsdv, dsdv, Gc);
+    dot(Ns, dsduu, Lc);
+    dot(Ns, dsduv, Mc);
+    dot(Ns, dsdvv, Nc);
+
+    // Partials of the non-normalized normals of the base surface
+    Lanes dNsdu[3], dNsdv[3];
+    for (int l = 0; l < LANES; l++) {
+      float denom = Ec[l] * Gc[l] - Fc[l] * Fc[l];
+      float au = (Fc[l] * Mc[l] - Gc[l] * Lc[l]) / denom;
+      float bu = (Fc[l] * Lc[l] - Ec[l] * Mc[l]) / denom;
+      float av = (Fc[l] * Nc[l] - Gc[l] * Mc[l]) / denom;
+      float bv = (Fc[l] * Mc[l] - Ec[l] * Nc[l]) / denom;
+      for (int c = 0; c < 3; c++) {
+        dNsdu[c][l] = au * dsdu[c][l] + bu * dsdv[c][l];
+        dNsdv[c][l] = av * dsdu[c][l] + bv * dsdv[c][l];
+      }
+    }
+
+    // Partials of the normals of the base surface
+    Lanes dNsduDotNs, dNsdvDotNs;
+    dot(dNsdu, Ns, dNsduDotNs);
+    dot(dNsdv, Ns, dNsdvDotNs);
+    for (int c = 0; c < 3; c++) {
+      for (int l = 0; l < LANES; l++) {
+        dNsdu[c][l] -= Ns[c][l] * dNsduDotNs[l] / NsLength[l];
+        dNsdv[c][l] -= Ns[c][l] * dNsdvDotNs[l] / NsLength[l];
+        dfdu[c][l] += dNsdu[c][l] * D[l];
+        dfdv[c][l] += dNsdv[c][l] * D[l];
+      }
+    }
+  }
+
+  // ------------------------- Output vars --------------------------
+
+  Lanes normal[3], normalLength;
+  cross(dfdu, dfdv, normal);
+  dot(normal, normal, normalLength);
+  for (int l = 0; l < count; l++) {
+    int k = begin + l;
+    float invLength = 1.0f / std::sqrt(normalLength[l]);
+    samples.x[k] = s[0][l] + Ns[0][l] * D[l];
+    samples.y[k] = s[1][l] + Ns[1][l] * D[l];
+    samples.z[k] = s[2][l] + Ns[2][l] * D[l];
+    samples.normalX[k] = normal[0][l] * invLength;
+    samples.normalY[k] = normal[1][l] * invLength;
+    samples.normalZ[k] = normal[2][l] * invLength;
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef SURFACE_EVALUATOR_H
+#define SURFACE_EVALUATOR_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "coefficientgrid.h"
+#include "proceduraldisplacement.h"
+
+/**
+ * @brief The SurfaceSamples class stores a batch of surface samples in
+ * structure-of-arrays layout. The patch and parameter arrays are the input of
+ * the SurfaceEvaluator; the position and normal arrays are its output.
+ */
+class SurfaceSamples {
+ public:
+  SurfaceSamples();
+
+  void append(int patch, float u, float v);
+  void appendGrid(int patch, int resolution);
+  void resize(int size);
+  void clear();
+  int size() const;
+
+  QVector<int> patches;
+  QVector<float> u;
+  QVector<float> v;
+
+  QVector<float> x;
+  QVector<float> y;
+  QVector<float> z;
+  QVector<float> normalX;
+  QVector<float> normalY;
+  QVector<float> normalZ;
+};
+
+/**
+ * @brief The SurfaceEvaluator class evaluates the displaced bicubic surface on
+ * the CPU. It computes exactly the same surface f = s + Ns * D and normals as
+ * displace.tese and displace.frag, where s is the bicubic B-spline patch, Ns
+ * its unit normal and D the biquadratic displacement. This makes it a
+ * reference for the GPU pipeline that does not need an OpenGL context.
+ *
+ * Samples are evaluated in blocks of a fixed number of lanes. Every step of
+ * the evaluation is a loop over the lanes of a block, which the compiler can
+ * turn into SIMD instructions. Blocks are evaluated in parallel.
+ */
+class SurfaceEvaluator {
+ public:
+  SurfaceEvaluator();
+  SurfaceEvaluator(const QVector<QVector3D>& coords,
+                   const QVector<unsigned int>& patchIndices);
+
+  void setPatches(const QVector<QVector3D>& coords,
+                  const QVector<unsigned int>& patchIndices);
+  void setDisplacement(const ProceduralDisplacement& displacement);
+  void setTileSize(float tileSize);
+  void setTrueNormals(bool trueNormals);
+  void setBakedCoefficients(bool bakedCoefficients);
+
+  void evaluate(SurfaceSamples& samples) const;
+  QVector3D evaluate(int patch, float u, float v,
+                     QVector3D* normal = nullptr) const;
+
+  int numPatches() const;
+
+ private:
+  void evaluateBlock(SurfaceSamples& samples, int begin, int count) const;
+  void bakeCoefficients();
+
+  // The 16 control points of every patch in 4x4 row-major ordering. Stored
+  // per patch as 16 x-coordinates, followed by 16 y- and 16 z-coordinates.
+  QVector<float> controlPoints;
+
+  ProceduralDisplacement displacement;
+  float tileSize;
+  bool trueNormals;
+  bool bakedCoefficients;
+  // The baked coefficients. Empty if they are generated per sample.
+  CoefficientGrid grid;
+};
+
+#endif  // SURFACE_EVALUATOR_H
@@ -0,0 +1,697 @@
+#include "tessellator.h"
+
+#include <QVector2D>
+#include <QVector4D>
+#include <algorithm>
+#include <cmath>
+
+#include "initialization/edgemap.h"
+#include "patchbvh.h"
+#include "util/parallel.h"
+#include "util/util.h"
+
+// Minimum number of patches that are handled by a single task.
+#define MIN_PATCHES_PER_TASK 64
+// Maximum tessellation level, same as the clamping in displace.tesc. Scaled by
+// the density of the tessellator.
+#define MAX_TESS_LEVEL 64
+
+// Indices of the corner control points of a patch, counter-clockwise starting
+// at (u, v) = (0, 0). Side s of the patch runs from corner s to corner s + 1.
+static const int CORNERS[4] = {5, 6, 10, 9};
+// Outer tessellation level that belongs to each side.
+static const int SIDE_OUTER_LEVEL[4] = {1, 2, 3, 0};
+
+/**
+ * @brief evenSegments Computes the number of segments of fractional even
+ * spacing.
+ * @param level The tessellation level.
+ * @param maxLevel The maximum tessellation level.
+ * @return The tessellation level rounded up to the next even integer, clamped
+ * to [2, maxLevel].
+ */
+static int evenSegments(float level, float maxLevel) {
+  float clamped = std::clamp(level, 2.0f, maxLevel);
+  return 2 * int(std::ceil(clamped / 2));
+}
+
+/**
+ * @brief segmentPosition Computes the position of a vertex on a subdivided
+ * edge with fractional even spacing. All segments have length 1 / level,
+ * except for the two segments next to the midpoint, which are equally short.
+ * The positions are symmetric, so position(n - k) == 1 - position(k).
+ * @param level The tessellation level.
+ * @param segments The number of segments, as computed by evenSegments().
+ * @param k The index of the vertex in [0, segments].
+ * @param maxLevel The maximum tessellation level.
+ * @return The position of the vertex in [0, 1].
+ */
+static float segmentPosition(float level, int segments, int k,
+                             float maxLevel) {
+  float clamped = std::clamp(level, 2.0f, maxLevel);
+  if (2 * k == segments) {
+    return 0.5f;
+  }
+  if (2 * k < segments) {
+    return k / clamped;
+  }
+  return 1.0f - (segments - k) / clamped;
+}
+
+/**
+ * @brief sidePoint Maps the position along a side of the quad domain to (u, v)
+ * coordinates.
+ * @param side The side. Sides are counter-clockwise, starting at v = 0.
+ * @param t The position along the side in [0, 1].
+ * @param u The u coordinate.
+ * @param v The v coordinate.
+ */
+static void sidePoint(int side, float t, float &u, float &v) {
+  switch (side) {
+    case 0:
+      u = t;
+      v = 0.0f;
+      break;
+    case 1:
+      u = 1.0f;
+      v = t;
+      break;
+    case 2:
+      u = 1.0f - t;
+      v = 1.0f;
+      break;
+    default:
+      u = 0.0f;
+      v = 1.0f - t;
+      break;
+  }
+}
+
+/**
+ * @brief zipper Stitches two rows of vertices together with triangles. The
+ * outer row is below the inner row and both run from left to right. The next
+ * triangle always advances the row whose next vertex lies further to the left,
+ * so the triangles do not overlap.
+ * @param outer The outer vertices.
+ * @param outerT The positions of the outer vertices along the row.
+ * @param outerSegments The number of outer segments.
+ * @param inner The inner vertices.
+ * @param innerT The positions of the inner vertices along the row.
+ * @param innerSegments The number of inner segments. May be 0.
+ * @param triangles The triangles are written here.
+ * @return The number of triangles written, outerSegments + innerSegments.
+ */
+static int zipper(const unsigned int *outer, const float *outerT,
+                  int outerSegments, const unsigned int *inner,
+                  const float *innerT, int innerSegments,
+                  unsigned int *triangles) {
+  int i = 0;
+  int j = 0;
+  int count = 0;
+  while (i < outerSegments || j < innerSegments) {
+    unsigned int *triangle = triangles + 3 * count++;
+    if (j == innerSegments ||
+        (i < outerSegments && outerT[i + 1] <= innerT[j + 1])) {
+      triangle[0] = outer[i];
+      triangle[1] = outer[i + 1];
+      triangle[2] = inner[j];
+      i++;
+    } else {
+      triangle[0] = outer[i];
+      triangle[1] = inner[j + 1];
+      triangle[2] = inner[j];
+      j++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief TessellatedMesh::TessellatedMesh Creates an empty mesh.
+ */
+TessellatedMesh::TessellatedMesh() : firstVertex(0) {}
+
+/**
+ * @brief TessellatedMesh::numVerts Number of vertices.
+ * @return The number of vertices.
+ */
+int TessellatedMesh::numVerts() const { return coords.size(); }
+
+/**
+ * @brief TessellatedMesh::numTriangles Number of triangles.
+ * @return The number of triangles.
+ */
+int TessellatedMesh::numTriangles() const { return indices.size() / 3; }
+
+/**
+ * @brief TessellatedMesh::memoryUsage Approximates the number of bytes used by
+ * this mesh.
+ * @return The number of bytes used.
+ */
+qint64 TessellatedMesh::memoryUsage() const {
+  return vectorMemory(coords) + vectorMemory(normals) + vectorMemory(indices) +
+         vectorMemory(patchTriangles);
+}
+
+/**
+ * @brief Tessellator::Tessellator Creates a tessellator with the default
+ * settings.
+ */
+Tessellator::Tessellator()
+    : tileSize(4.0f),
+      density(1),
+      dynamicLoD(false),
+      tessDetail(10.0f),
+      errorDrivenLoD(false),
+      lodErrorScale(1.0f),
+      displacementCurvature(0.0f) {
+  evaluator.setTileSize(tileSize);
+}
+
+/**
+ * @brief Tessellator::setDisplacement Sets the displacement function.
+ * @param displacement The displacement function.
+ */
+void Tessellator::setDisplacement(const ProceduralDisplacement &displacement) {
+  this->displacement = displacement;
+  evaluator.setDisplacement(displacement);
+}
+
+/**
+ * @brief Tessellator::setTileSize Sets the tile size, which is both the fixed
+ * tessellation level and the number of biquadratic subpatches per patch.
+ * @param tileSize The tile size.
+ */
+void Tessellator::setTileSize(float tileSize) {
+  this->tileSize = tileSize;
+  evaluator.setTileSize(tileSize);
+}
+
+/**
+ * @brief Tessellator::setDensity Sets the number of samples per subpatch in
+ * either direction. The fixed tessellation level and the maximum level are
+ * multiplied by the density, so a density above 1 exceeds the hardware limit.
+ * A density of 1 is the same as displace.tesc.
+ * @param density The density.
+ */
+void Tessellator::setDensity(int density) { this->density = density; }
+
+/**
+ * @brief Tessellator::setTrueNormals Sets which normals are computed. See
+ * SurfaceEvaluator::setTrueNormals().
+ * @param trueNormals Whether to compute the true normals.
+ */
+void Tessellator::setTrueNormals(bool trueNormals) {
+  evaluator.setTrueNormals(trueNormals);
+}
+
+/**
+ * @brief Tessellator::setBakedCoefficients Sets whether the displacement
+ * coefficients are baked. See SurfaceEvaluator::setBakedCoefficients().
+ * @param bakedCoefficients Whether to bake the coefficients.
+ */
+void Tessellator::setBakedCoefficients(bool bakedCoefficients) {
+  evaluator.setBakedCoefficients(bakedCoefficients);
+}
+
+/**
+ * @brief Tessellator::setDynamicLoD Sets whether the tessellation levels
+ * depend on the screen-space size of the patches.
+ * @param dynamicLoD Whether to use dynamic level of detail.
+ */
+void Tessellator::setDynamicLoD(bool dynamicLoD) {
+  this->dynamicLoD = dynamicLoD;
+}
+
+/**
+ * @brief Tessellator::setTessDetail Sets the factor between screen-space
+ * distances and tessellation levels for dynamic level of detail.
+ * @param tessDetail The tessellation detail.
+ */
+void Tessellator::setTessDetail(float tessDetail) {
+  this->tessDetail = tessDetail;
+}
+
+/**
+ * @brief Tessellator::setViewProjection Sets the matrix that maps the control
+ * points to clip space for dynamic level of detail.
+ * @param viewProjection The projection matrix times the model-view matrix.
+ */
+void Tessellator::setViewProjection(const QMatrix4x4 &viewProjection) {
+  this->viewProjection = viewProjection;
+}
+
+/**
+ * @brief Tessellator::setErrorDrivenLoD Sets whether dynamic level of detail
+ * chooses the tessellation levels from bounds on the curvature of the patches
+ * and the displacement, such that the error stays below a number of pixels.
+ * @param errorDrivenLoD Whether to use error-driven level of detail.
+ */
+void Tessellator::setErrorDrivenLoD(bool errorDrivenLoD) {
+  this->errorDrivenLoD = errorDrivenLoD;
+}
+
+/**
+ * @brief Tessellator::setLodErrorScale Sets the factor that converts an error
+ * at distance 1 from the eye to the allowed number of pixels. Same as
+ * lodErrorScale in uniforms.glsl.
+ * @param lodErrorScale The error scale.
+ */
+void Tessellator::setLodErrorScale(float lodErrorScale) {
+  this->lodErrorScale = lodErrorScale;
+}
+
+/**
+ * @brief Tessellator::setEyePosition Sets the position of the eye for
+ * error-driven level of detail.
+ * @param eyePosition The position of the eye in the coordinates of the
+ * vertices.
+ */
+void Tessellator::setEyePosition(const QVector3D &eyePosition) {
+  this->eyePosition = eyePosition;
+}
+
+/**
+ * @brief Tessellator::errorDrivenLevels Computes the tessellation levels of a
+ * patch for error-driven level of detail. Same as errorDrivenLevels() in
+ * patchbounds.glsl.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of the patch.
+ * @param outer The outer tessellation levels.
+ * @param inner The inner tessellation levels.
+ */
+void Tessellator::errorDrivenLevels(const QVector<QVector3D> &coords,
+                                    const unsigned int *patchIndices,
+                                    float outer[4], float inner[2]) const {
+  PatchBounds bounds = PatchBVH::computeBounds(coords, patchIndices);
+  auto errorLevel = [this](float curvature, float dist) {
+    float level = std::sqrt(curvature * lodErrorScale /
+                            (8.0f * std::max(dist, 1e-4f)));
+    return std::clamp(level, 1.0f, float(MAX_TESS_LEVEL));
+  };
+
+  float dist[4];
+  for (int k = 0; k < 4; k++) {
+    dist[k] = (eyePosition - coords[patchIndices[CORNERS[k]]]).length();
+  }
+  for (int s = 0; s < 4; s++) {
+    outer[s] = errorLevel(bounds.edgeCurvature[s] + displacementCurvature,
+                          std::min(dist[(s + 3) % 4], dist[s]));
+  }
+  float nearest = std::min({dist[0], dist[1], dist[2], dist[3]});
+  std::fill(inner, inner + 2,
+            errorLevel(bounds.curvature + displacementCurvature, nearest));
+}
+
+/**
+ * @brief Tessellator::maxTessLevel The maximum tessellation level.
+ * @return The hardware limit times the density.
+ */
+float Tessellator::maxTessLevel() const {
+  return float(MAX_TESS_LEVEL * density);
+}
+
+/**
+ * @brief Tessellator::tessLevels Computes the tessellation levels of a patch.
+ * Same as displace.tesc.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of the patch.
+ * @param outer The outer tessellation levels.
+ * @param inner The inner tessellation levels.
+ */
+void Tessellator::tessLevels(const QVector<QVector3D> &coords,
+                             const unsigned int *patchIndices, float outer[4],
+                             float inner[2]) const {
+  if (!dynamicLoD) {
+    std::fill(outer, outer + 4, tileSize * density);
+    std::fill(inner, inner + 2, tileSize * density);
+    return;
+  }
+  if (errorDrivenLoD) {
+    errorDrivenLevels(coords, patchIndices, outer, inner);
+    return;
+  }
+
+  QVector2D ndc[16];
+  for (int k = 0; k < 16; k++) {
+    QVector4D clipPos =
+        viewProjection * QVector4D(coords[patchIndices[k]], 1.0f);
+    ndc[k] = QVector2D(clipPos.x() / clipPos.w(), clipPos.y() / clipPos.w());
+  }
+  auto distance = [&ndc](int x, int y) { return (ndc[x] - ndc[y]).length(); };
+  auto clampLevel = [this](float length) {
+    return std::clamp(tessDetail * length, 1.0f, float(MAX_TESS_LEVEL));
+  };
+  auto TL_v = [&](int vert, int left, int bottom, int right, int top) {
+    float maxLength = std::max({distance(vert, left), distance(vert, bottom),
+                                distance(vert, right), distance(vert, top)});
+    return clampLevel(maxLength);
+  };
+  auto TL_e = [&](int left, int right) {
+    return clampLevel(distance(left, right));
+  };
+
+  float TL_vA = TL_v(10, 6, 9, 14, 11);
+  float TL_vB = TL_v(6, 2, 5, 10, 7);
+  float TL_vC = TL_v(5, 1, 4, 9, 6);
+  float TL_vD = TL_v(9, 5, 8, 13, 10);
+
+  outer[0] = std::max(TL_vD, TL_vC);
+  outer[1] = std::max(TL_vC, TL_vB);
+  outer[2] = std::max(TL_vB, TL_vA);
+  outer[3] = std::max(TL_vA, TL_vD);
+
+  inner[0] = std::max(TL_e(5, 6), TL_e(9, 10));
+  inner[1] = std::max(TL_e(5, 9), TL_e(6, 10));
+}
+
+/**
+ * @brief Tessellator::prepare Computes the tessellation levels of all patches
+ * and assigns the vertices and triangles to the patches in a single serial
+ * pass. Should be called after changing the settings, before evaluating or
+ * triangulating any patches.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch, as
+ * computed by Mesh::computeRegularPatchIndices().
+ */
+void Tessellator::prepare(const QVector<QVector3D> &coords,
+                          const QVector<unsigned int> &patchIndices) {
+  int patchCount = patchIndices.size() / 16;
+  layouts.resize(patchCount);
+  float maxLevel = maxTessLevel();
+  // Computed like TessellationRenderer::updateDisplacementCurvature().
+  displacementCurvature =
+      std::abs(displacement.getAmplitude()) *
+      ProceduralDisplacement(displacement.getMode(), 1.0f)
+          .curvatureBound(tileSize);
+  QVector<float> outerLevels(4 * patchCount);
+  parallelFor(
+      0, patchCount,
+      [&](int begin, int end) {
+        for (int p = begin; p < end; p++) {
+          tessLevels(coords, patchIndices.constData() + 16 * p,
+                     outerLevels.data() + 4 * p, layouts[p].innerLevels);
+        }
+      },
+      MIN_PATCHES_PER_TASK);
+
+  QVector<qint64> cornerVertices(coords.size(), -1);
+  EdgeMap edgeMap;
+  edgeMap.reserve(4 * patchCount);
+  QVector<int> sideEdges(4 * patchCount);
+  edgeOwners.clear();
+  edgeLevels.clear();
+  edgeSegments.clear();
+  edgeFirstVertices.clear();
+  vertexOffsets.resize(patchCount + 1);
+  triangleOffsets.resize(patchCount + 1);
+  qint64 vertexCount = 0;
+  qint64 triangleCount = 0;
+  for (int p = 0; p < patchCount; p++) {
+    PatchLayout &layout = layouts[p];
+    const unsigned int *indices = patchIndices.constData() + 16 * p;
+    vertexOffsets[p] = vertexCount;
+    triangleOffsets[p] = triangleCount;
+
+    for (int s = 0; s < 4; s++) {
+      int corner = indices[CORNERS[s]];
+      layout.ownsCorner[s] = cornerVertices[corner] < 0;
+      if (layout.ownsCorner[s]) {
+        cornerVertices[corner] = vertexCount++;
+      }
+      layout.corners[s] = cornerVertices[corner];
+    }
+
+    layout.innerSegments[0] = evenSegments(layout.innerLevels[0], maxLevel);
+    layout.innerSegments[1] = evenSegments(layout.innerLevels[1], maxLevel);
+    for (int s = 0; s < 4; s++) {
+      int side = 4 * p + s;
+      int owner = edgeMap.findOrInsert(indices[CORNERS[s]],
+                                       indices[CORNERS[(s + 1) % 4]], side);
+      if (owner < 0) {
+        sideEdges[side] = edgeOwners.size();
+        edgeOwners.append(side);
+        float level = outerLevels[4 * p + SIDE_OUTER_LEVEL[s]];
+        edgeLevels.append(level);
+        edgeSegments.append(evenSegments(level, maxLevel));
+        edgeFirstVertices.append(vertexCount);
+        vertexCount += edgeSegments.last() - 1;
+        layout.reversed[s] = false;
+      } else {
+        sideEdges[side] = sideEdges[owner];
+        // The owner starts the edge at its own corner.
+        int ownerPatch = owner / 4;
+        unsigned int ownerCorner =
+            patchIndices[16 * ownerPatch + CORNERS[owner % 4]];
+        layout.reversed[s] = ownerCorner != indices[CORNERS[s]];
+      }
+      layout.edges[s] = sideEdges[side];
+      int innerSegments = layout.innerSegments[s % 2] - 2;
+      triangleCount += edgeSegments[layout.edges[s]] + innerSegments;
+    }
+
+    layout.firstInterior = vertexCount;
+    vertexCount += (layout.innerSegments[0] - 1) * (layout.innerSegments[1] - 1);
+    triangleCount +=
+        2 * (layout.innerSegments[0] - 2) * (layout.innerSegments[1] - 2);
+  }
+  vertexOffsets[patchCount] = vertexCount;
+  triangleOffsets[patchCount] = triangleCount;
+
+  evaluator.setPatches(coords, patchIndices);
+}
+
+/**
+ * @brief Tessellator::evaluate Evaluates the vertices owned by a range of
+ * patches. Every vertex is evaluated on the patch that owns it.
+ * @param firstPatch The first patch of the range.
+ * @param lastPatch The end of the range (exclusive).
+ * @param mesh The vertex coordinates and normals are stored here. Its first
+ * vertex is set to vertexOffset(firstPatch).
+ */
+void Tessellator::evaluate(int firstPatch, int lastPatch,
+                           TessellatedMesh &mesh) const {
+  qint64 firstVertex = vertexOffsets[firstPatch];
+  int vertexCount = int(vertexOffsets[lastPatch] - firstVertex);
+  float maxLevel = maxTessLevel();
+
+  SurfaceSamples samples;
+  samples.resize(vertexCount);
+  auto setSample = [&samples, firstVertex](qint64 vertex, int p, float u,
+                                           float v) {
+    int k = int(vertex - firstVertex);
+    samples.patches[k] = p;
+    samples.u[k] = u;
+    samples.v[k] = v;
+  };
+  parallelFor(
+      firstPatch, lastPatch,
+      [&](int begin, int end) {
+        for (int p = begin; p < end; p++) {
+          const PatchLayout &layout = layouts[p];
+          for (int s = 0; s < 4; s++) {
+            float u, v;
+            if (layout.ownsCorner[s]) {
+              sidePoint(s, 0.0f, u, v);
+              setSample(layout.corners[s], p, u, v);
+            }
+            int e = layout.edges[s];
+            if (edgeOwners[e] != 4 * p + s) {
+              continue;
+            }
+            for (int k = 1; k < edgeSegments[e]; k++) {
+              sidePoint(s,
+                        segmentPosition(edgeLevels[e], edgeSegments[e], k,
+                                        maxLevel),
+                        u, v);
+              setSample(edgeFirstVertices[e] + k - 1, p, u, v);
+            }
+          }
+
+          qint64 vertex = layout.firstInterior;
+          for (int j = 1; j < layout.innerSegments[1]; j++) {
+            float v = segmentPosition(layout.innerLevels[1],
+                                      layout.innerSegments[1], j, maxLevel);
+            for (int i = 1; i < layout.innerSegments[0]; i++) {
+              float u = segmentPosition(layout.innerLevels[0],
+                                        layout.innerSegments[0], i, maxLevel);
+              setSample(vertex++, p, u, v);
+            }
+          }
+        }
+      },
+      MIN_PATCHES_PER_TASK);
+
+  evaluator.evaluate(samples);
+
+  mesh.firstVertex = firstVertex;
+  mesh.coords.resize(vertexCount);
+  mesh.normals.resize(vertexCount);
+  for (int k = 0; k < vertexCount; k++) {
+    mesh.coords[k] = QVector3D(samples.x[k], samples.y[k], samples.z[k]);
+    mesh.normals[k] =
+        QVector3D(samples.normalX[k], samples.normalY[k], samples.normalZ[k]);
+  }
+}
+
+/**
+ * @brief Tessellator::triangulate Computes the triangles of a range of
+ * patches. The inner vertices of every patch form a regular grid, which is
+ * stitched to the subdivided sides of the patch.
+ * @param firstPatch The first patch of the range.
+ * @param lastPatch The end of the range (exclusive).
+ * @param mesh The triangles are stored here, using global vertex indices.
+ * Should be less than 2^32 vertices in total.
+ */
+void Tessellator::triangulate(int firstPatch, int lastPatch,
+                              TessellatedMesh &mesh) const {
+  qint64 firstTriangle = triangleOffsets[firstPatch];
+  mesh.indices.resize(3 * int(triangleOffsets[lastPatch] - firstTriangle));
+  mesh.patchTriangles.resize(lastPatch - firstPatch + 1);
+  for (int p = firstPatch; p <= lastPatch; p++) {
+    mesh.patchTriangles[p - firstPatch] =
+        int(triangleOffsets[p] - firstTriangle);
+  }
+  float maxLevel = maxTessLevel();
+  int maxSegments = evenSegments(maxLevel, maxLevel);
+
+  parallelFor(
+      firstPatch, lastPatch,
+      [&](int begin, int end) {
+        QVector<unsigned int> outer(maxSegments + 1), inner(maxSegments);
+        QVector<float> outerT(maxSegments + 1), innerT(maxSegments);
+        QVector<float> gridU(maxSegments + 1), gridV(maxSegments + 1);
+        for (int p = begin; p < end; p++) {
+          const PatchLayout &layout = layouts[p];
+          int nu = layout.innerSegments[0];
+          int nv = layout.innerSegments[1];
+          for (int i = 0; i <= nu; i++) {
+            gridU[i] =
+                segmentPosition(layout.innerLevels[0], nu, i, maxLevel);
+          }
+          for (int j = 0; j <= nv; j++) {
+            gridV[j] =
+                segmentPosition(layout.innerLevels[1], nv, j, maxLevel);
+          }
+          auto gridVertex = [&layout, nu](int i, int j) {
+            return (unsigned int)(layout.firstInterior + (j - 1) * (nu - 1) +
+                                  (i - 1));
+          };
+          unsigned int *triangles =
+              mesh.indices.data() + 3 * (triangleOffsets[p] - firstTriangle);
+
+          // Stitch every side to the outermost ring of the inner grid. The
+          // inner row of a side runs in the same direction as the side.
+          for (int s = 0; s < 4; s++) {
+            int e = layout.edges[s];
+            int n = edgeSegments[e];
+            outer[0] = (unsigned int)layout.corners[s];
+            outer[n] = (unsigned int)layout.corners[(s + 1) % 4];
+            outerT[0] = 0.0f;
+            outerT[n] = 1.0f;
+            for (int k = 1; k < n; k++) {
+              int edgeVertex = layout.reversed[s] ? n - k : k;
+              outer[k] =
+                  (unsigned int)(edgeFirstVertices[e] + edgeVertex - 1);
+              outerT[k] = segmentPosition(edgeLevels[e], n, k, maxLevel);
+            }
+
+            int m = (s % 2 == 0 ? nu : nv) - 2;
+            for (int k = 0; k <= m; k++) {
+              switch (s) {
+                case 0:
+                  inner[k] = gridVertex(1 + k, 1);
+                  innerT[k] = gridU[1 + k];
+                  break;
+                case 1:
+                  inner[k] = gridVertex(nu - 1, 1 + k);
+                  innerT[k] = gridV[1 + k];
+                  break;
+                case 2:
+                  inner[k] = gridVertex(nu - 1 - k, nv - 1);
+                  innerT[k] = 1.0f - gridU[nu - 1 - k];
+                  break;
+                default:
+                  inner[k] = gridVertex(1, nv - 1 - k);
+                  innerT[k] = 1.0f - gridV[nv - 1 - k];
+                  break;
+              }
+            }
+            triangles += 3 * zipper(outer.constData(), outerT.constData(), n,
+                                    inner.constData(), innerT.constData(), m,
+                                    triangles);
+          }
+
+          // Triangulate the inner grid.
+          for (int j = 1; j < nv - 1; j++) {
+            for (int i = 1; i < nu - 1; i++) {
+              triangles[0] = gridVertex(i, j);
+              triangles[1] = gridVertex(i + 1, j);
+              triangles[2] = gridVertex(i + 1, j + 1);
+              triangles[3] = gridVertex(i, j);
+              triangles[4] = gridVertex(i + 1, j + 1);
+              triangles[5] = gridVertex(i, j + 1);
+              triangles += 6;
+            }
+          }
+        }
+      },
+      MIN_PATCHES_PER_TASK);
+}
+
+/**
+ * @brief Tessellator::tessellate Tessellates all regular patches of a mesh at
+ * once.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch, as
+ * computed by Mesh::computeRegularPatchIndices().
+ * @return The tessellated mesh.
+ */
+TessellatedMesh Tessellator::tessellate(
+    const QVector<QVector3D> &coords,
+    const QVector<unsigned int> &patchIndices) {
+  prepare(coords, patchIndices);
+  TessellatedMesh mesh;
+  evaluate(0, numPatches(), mesh);
+  triangulate(0, numPatches(), mesh);
+  return mesh;
+}
+
+/**
+ * @brief Tessellator::numPatches Number of prepared patches.
+ * @return The number of patches.
+ */
+int Tessellator::numPatches() const { return layouts.size(); }
+
+/**
+ * @brief Tessellator::numVerts Number of vertices of the prepared patches.
+ * @return The number of vertices.
+ */
+qint64 Tessellator::numVerts() const { return vertexOffset(numPatches()); }
+
+/**
+ * @brief Tessellator::numTriangles Number of triangles of the prepared
+ * patches.
+ * @return The number of triangles.
+ */
+qint64 Tessellator::numTriangles() const {
+  return triangleOffset(numPatches());
+}
+
+/**
+ * @brief Tessellator::vertexOffset Index of the first vertex owned by a patch.
+ * @param patch The patch. May be numPatches().
+ * @return The index of the first vertex.
+ */
+qint64 Tessellator::vertexOffset(int patch) const {
+  return vertexOffsets.isEmpty() ? 0 : vertexOffsets[patch];
+}
+
+/**
+ * @brief Tessellator::triangleOffset Index of the first triangle of a patch.
+ * @param patch The patch. May be numPatches().
+ * @return The index of the first triangle.
+ */
+qint64 Tessellator::triangleOffset(int patch) const {
+  return triangleOffsets.isEmpty() ? 0 : triangleOffsets[patch];
+}
@@ -0,0 +1,132 @@
+#ifndef TESSELLATOR_H
+#define TESSELLATOR_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector>
+
+#include "surfaceevaluator.h"
+
+/**
+ * @brief The TessellatedMesh class is a triangle mesh with shared vertices, as
+ * produced by the Tessellator. It may also contain a range of patches only, in
+ * which case it contains the vertices owned by those patches, starting at
+ * global vertex index firstVertex. The triangles always use global vertex
+ * indices. The triangles of the p-th patch of the range are stored at
+ * patchTriangles[p] up to (excluding) patchTriangles[p + 1].
+ */
+class TessellatedMesh {
+ public:
+  TessellatedMesh();
+
+  int numVerts() const;
+  int numTriangles() const;
+  qint64 memoryUsage() const;
+
+  qint64 firstVertex;
+  QVector<QVector3D> coords;
+  QVector<QVector3D> normals;
+  // Three vertex indices per triangle, counter-clockwise.
+  QVector<unsigned int> indices;
+  QVector<int> patchTriangles;
+};
+
+/**
+ * @brief The Tessellator class tessellates the displaced bicubic patches on
+ * the CPU, so the displaced surface can be used without tessellation shaders.
+ * It computes the same tessellation levels as displace.tesc and subdivides the
+ * quad domain with fractional even spacing, like the fixed-function
+ * tessellator. A higher density samples the patches more finely than the
+ * hardware allows. The vertices are evaluated by the SurfaceEvaluator, which
+ * follows displace.tese.
+ *
+ * Vertices on the corners and edges of the patches are shared by all patches
+ * that contain them, so the result has no cracks between adjacent patches.
+ * Every vertex is owned by the first patch that contains it, and shared edges
+ * are subdivided according to their owner. Vertices are numbered in order of
+ * their owners, so any range of patches owns a contiguous range of vertices.
+ * This allows huge meshes to be tessellated range by range with bounded
+ * memory: after prepare(), evaluate() and triangulate() can be called for
+ * every range separately.
+ */
+class Tessellator {
+ public:
+  Tessellator();
+
+  void setDisplacement(const ProceduralDisplacement& displacement);
+  void setTileSize(float tileSize);
+  void setDensity(int density);
+  void setTrueNormals(bool trueNormals);
+  void setBakedCoefficients(bool bakedCoefficients);
+  void setDynamicLoD(bool dynamicLoD);
+  void setTessDetail(float tessDetail);
+  void setViewProjection(const QMatrix4x4& viewProjection);
+  void setErrorDrivenLoD(bool errorDrivenLoD);
+  void setLodErrorScale(float lodErrorScale);
+  void setEyePosition(const QVector3D& eyePosition);
+
+  void prepare(const QVector<QVector3D>& coords,
+               const QVector<unsigned int>& patchIndices);
+  void evaluate(int firstPatch, int lastPatch, TessellatedMesh& mesh) const;
+  void triangulate(int firstPatch, int lastPatch, TessellatedMesh& mesh) const;
+  TessellatedMesh tessellate(const QVector<QVector3D>& coords,
+                             const QVector<unsigned int>& patchIndices);
+
+  int numPatches() const;
+  qint64 numVerts() const;
+  qint64 numTriangles() const;
+  qint64 vertexOffset(int patch) const;
+  qint64 triangleOffset(int patch) const;
+
+ private:
+  /**
+   * @brief The PatchLayout struct describes which vertices of a single patch
+   * are shared with other patches.
+   */
+  typedef struct PatchLayout {
+    qint64 corners[4];
+    bool ownsCorner[4];
+    // Index of the edge of every side, and whether the side runs in the
+    // opposite direction of the patch that owns the edge.
+    int edges[4];
+    bool reversed[4];
+    float innerLevels[2];
+    int innerSegments[2];
+    qint64 firstInterior;
+  } PatchLayout;
+
+  void tessLevels(const QVector<QVector3D>& coords,
+                  const unsigned int* patchIndices, float outer[4],
+                  float inner[2]) const;
+  void errorDrivenLevels(const QVector<QVector3D>& coords,
+                         const unsigned int* patchIndices, float outer[4],
+                         float inner[2]) const;
+  float maxTessLevel() const;
+
+  SurfaceEvaluator evaluator;
+  float tileSize;
+  int density;
+  bool dynamicLoD;
+  float tessDetail;
+  QMatrix4x4 viewProjection;
+  ProceduralDisplacement displacement;
+  bool errorDrivenLoD;
+  float lodErrorScale;
+  QVector3D eyePosition;
+  // Bound on the second derivatives of the displacement, computed by
+  // prepare().
+  float displacementCurvature;
+
+  QVector<PatchLayout> layouts;
+  // Per edge: the side (4 * patch + side) that owns it, its level, its number
+  // of segments and the index of its first inner vertex.
+  QVector<int> edgeOwners;
+  QVector<float> edgeLevels;
+  QVector<int> edgeSegments;
+  QVector<qint64> edgeFirstVertices;
+  // Prefix sums of the vertices owned by and the triangles of the patches.
+  QVector<qint64> vertexOffsets;
+  QVector<qint64> triangleOffsets;
+};
+
+#endif  // TESSELLATOR_H
@@ -0,0 +1,115 @@
+#include "meshexporter.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <algorithm>
+#include <climits>
+
+// Maximum number of vertices or triangles that are kept in memory at once.
+// Single patches may exceed this.
+#define MAX_CHUNK_SIZE (1 << 20)
+
+/**
+ * @brief MeshExporter::MeshExporter Creates a new mesh exporter.
+ */
+MeshExporter::MeshExporter() {}
+
+/**
+ * @brief MeshExporter::~MeshExporter Deconstructor.
+ */
+MeshExporter::~MeshExporter() {}
+
+/**
+ * @brief MeshExporter::exportMesh Tessellates the regular patches of a mesh
+ * and writes the result to a file. The tessellation settings are taken from
+ * the tessellator. The file is only replaced once it has been written
+ * completely.
+ * @param tessellator The tessellator. Is prepared for the provided patches.
+ * @param coords The vertex coordinates of the mesh.
+ * @param patchIndices The indices of the 16 control points of every patch, as
+ * computed by Mesh::computeRegularPatchIndices().
+ * @param fileName Path of the file to write.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshExporter::exportMesh(Tessellator &tessellator,
+                              const QVector<QVector3D> &coords,
+                              const QVector<unsigned int> &patchIndices,
+                              const QString &fileName) {
+  QElapsedTimer timer;
+  timer.start();
+  tessellator.prepare(coords, patchIndices);
+  qint64 numVerts = tessellator.numVerts();
+  qint64 numTriangles = tessellator.numTriangles();
+  if (numVerts > qint64(UINT_MAX)) {
+    qDebug() << " * Cannot export" << numVerts
+             << "vertices; indices are limited to 32 bits";
+    return false;
+  }
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qDebug() << " * Could not open" << fileName;
+    return false;
+  }
+
+  QByteArray buffer;
+  writeHeader(buffer, numVerts, numTriangles);
+  bool success = file.write(buffer) == buffer.size();
+
+  // The vertices of all patches are written before any of the triangles, so
+  // every patch is visited twice.
+  TessellatedMesh chunk;
+  int patchCount = tessellator.numPatches();
+  for (int p = 0; p < patchCount && success;) {
+    int end = chunkEnd(tessellator, p, false);
+    tessellator.evaluate(p, end, chunk);
+    buffer.clear();
+    writeVertices(buffer, chunk);
+    success = file.write(buffer) == buffer.size();
+    p = end;
+  }
+  chunk = TessellatedMesh();
+  for (int p = 0; p < patchCount && success;) {
+    int end = chunkEnd(tessellator, p, true);
+    tessellator.triangulate(p, end, chunk);
+    buffer.clear();
+    writeTriangles(buffer, chunk);
+    success = file.write(buffer) == buffer.size();
+    p = end;
+  }
+
+  if (!success || !file.commit()) {
+    file.cancelWriting();
+    qDebug() << " * Could not write" << fileName;
+    return false;
+  }
+  qint64 elapsed = std::max(timer.elapsed(), qint64(1));
+  qDebug() << ":: Exported" << numTriangles << "triangles to" << fileName
+           << "in" << elapsed << "ms (" << numTriangles * 1000 / elapsed
+           << "triangles/s )";
+  return true;
+}
+
+/**
+ * @brief MeshExporter::chunkEnd Determines the end of the chunk of patches
+ * that starts at the provided patch. Chunks contain at least one patch.
+ * @param tessellator The prepared tessellator.
+ * @param firstPatch The first patch of the chunk.
+ * @param triangles Whether to limit the number of triangles of the chunk
+ * instead of the number of vertices.
+ * @return The end of the chunk (exclusive).
+ */
+int MeshExporter::chunkEnd(const Tessellator &tessellator, int firstPatch,
+                           bool triangles) const {
+  auto offset = [&tessellator, triangles](int patch) {
+    return triangles ? tessellator.triangleOffset(patch)
+                     : tessellator.vertexOffset(patch);
+  };
+  qint64 limit = offset(firstPatch) + MAX_CHUNK_SIZE;
+  int end = firstPatch + 1;
+  while (end < tessellator.numPatches() && offset(end + 1) <= limit) {
+    end++;
+  }
+  return end;
+}
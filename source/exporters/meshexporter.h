@@ -0,0 +1,43 @@
+#ifndef MESH_EXPORTER_H
+#define MESH_EXPORTER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+#include "evaluation/tessellator.h"
+
+/**
+ * @brief The MeshExporter class writes tessellated displaced surfaces to a
+ * file. The class is abstract; subclasses implement a specific file format.
+ *
+ * The surface is never tessellated as a whole. Instead, the patches are
+ * evaluated and written in chunks of a bounded number of vertices, after which
+ * they are triangulated and written in chunks of a bounded number of
+ * triangles. The memory usage is therefore independent of the size of the
+ * exported mesh.
+ */
+class MeshExporter {
+ public:
+  MeshExporter();
+  virtual ~MeshExporter();
+
+  bool exportMesh(Tessellator& tessellator, const QVector<QVector3D>& coords,
+                  const QVector<unsigned int>& patchIndices,
+                  const QString& fileName);
+
+ protected:
+  virtual void writeHeader(QByteArray& buffer, qint64 numVerts,
+                           qint64 numTriangles) const = 0;
+  virtual void writeVertices(QByteArray& buffer,
+                             const TessellatedMesh& chunk) const = 0;
+  virtual void writeTriangles(QByteArray& buffer,
+                              const TessellatedMesh& chunk) const = 0;
+
+ private:
+  int chunkEnd(const Tessellator& tessellator, int firstPatch,
+               bool triangles) const;
+};
+
+#endif  // MESH_EXPORTER_H
@@ -0,0 +1,65 @@
+#include "objexporter.h"
+
+#include <cstdio>
+
+/**
+ * @brief OBJExporter::OBJExporter Creates a new OBJ exporter.
+ */
+OBJExporter::OBJExporter() {}
+
+/**
+ * @brief OBJExporter::writeHeader Writes a comment with the size of the mesh.
+ * @param buffer The buffer to append to.
+ * @param numVerts The total number of vertices.
+ * @param numTriangles The total number of triangles.
+ */
+void OBJExporter::writeHeader(QByteArray &buffer, qint64 numVerts,
+                              qint64 numTriangles) const {
+  buffer.append("# ");
+  buffer.append(QByteArray::number(numVerts));
+  buffer.append(" vertices, ");
+  buffer.append(QByteArray::number(numTriangles));
+  buffer.append(" triangles\n");
+}
+
+/**
+ * @brief OBJExporter::writeVertices Writes the position and normal of every
+ * vertex of a chunk.
+ * @param buffer The buffer to append to.
+ * @param chunk The chunk.
+ */
+void OBJExporter::writeVertices(QByteArray &buffer,
+                                const TessellatedMesh &chunk) const {
+  char line[128];
+  for (int v = 0; v < chunk.numVerts(); v++) {
+    const QVector3D &coords = chunk.coords[v];
+    const QVector3D &normal = chunk.normals[v];
+    int length = snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n", coords.x(),
+                          coords.y(), coords.z());
+    buffer.append(line, length);
+    length = snprintf(line, sizeof(line), "vn %.7g %.7g %.7g\n", normal.x(),
+                      normal.y(), normal.z());
+    buffer.append(line, length);
+  }
+}
+
+/**
+ * @brief OBJExporter::writeTriangles Writes every triangle of a chunk. Every
+ * vertex uses the normal with the same index.
+ * @param buffer The buffer to append to.
+ * @param chunk The chunk.
+ */
+void OBJExporter::writeTriangles(QByteArray &buffer,
+                                 const TessellatedMesh &chunk) const {
+  char line[128];
+  const unsigned int *indices = chunk.indices.constData();
+  for (int t = 0; t < chunk.numTriangles(); t++) {
+    // OBJ indices start at 1.
+    unsigned int a = indices[3 * t] + 1;
+    unsigned int b = indices[3 * t + 1] + 1;
+    unsigned int c = indices[3 * t + 2] + 1;
+    int length = snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a,
+                          b, b, c, c);
+    buffer.append(line, length);
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef OBJ_EXPORTER_H
+#define OBJ_EXPORTER_H
+
+#include "meshexporter.h"
+
+/**
+ * @brief The OBJExporter class writes meshes in the (text) OBJ format. Every
+ * vertex has a position and a normal.
+ */
+class OBJExporter : public MeshExporter {
+ public:
+  OBJExporter();
+
+ protected:
+  void writeHeader(QByteArray& buffer, qint64 numVerts,
+                   qint64 numTriangles) const override;
+  void writeVertices(QByteArray& buffer,
+                     const TessellatedMesh& chunk) const override;
+  void writeTriangles(QByteArray& buffer,
+                      const TessellatedMesh& chunk) const override;
+};
+
+#endif  // OBJ_EXPORTER_H
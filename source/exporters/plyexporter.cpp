@@ -0,0 +1,74 @@
+#include "plyexporter.h"
+
+#include <cstring>
+
+/**
+ * @brief PLYExporter::PLYExporter Creates a new PLY exporter.
+ */
+PLYExporter::PLYExporter() {}
+
+/**
+ * @brief PLYExporter::writeHeader Writes the PLY header, which declares the
+ * vertex and face elements.
+ * @param buffer The buffer to append to.
+ * @param numVerts The total number of vertices.
+ * @param numTriangles The total number of triangles.
+ */
+void PLYExporter::writeHeader(QByteArray &buffer, qint64 numVerts,
+                              qint64 numTriangles) const {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+  const char *format = "binary_little_endian";
+#else
+  const char *format = "binary_big_endian";
+#endif
+  buffer.append("ply\nformat ");
+  buffer.append(format);
+  buffer.append(" 1.0\nelement vertex ");
+  buffer.append(QByteArray::number(numVerts));
+  buffer.append(
+      "\nproperty float x\nproperty float y\nproperty float z\n"
+      "property float nx\nproperty float ny\nproperty float nz\n"
+      "element face ");
+  buffer.append(QByteArray::number(numTriangles));
+  buffer.append("\nproperty list uchar uint vertex_indices\nend_header\n");
+}
+
+/**
+ * @brief PLYExporter::writeVertices Writes the position and normal of every
+ * vertex of a chunk as six floats.
+ * @param buffer The buffer to append to.
+ * @param chunk The chunk.
+ */
+void PLYExporter::writeVertices(QByteArray &buffer,
+                                const TessellatedMesh &chunk) const {
+  int start = buffer.size();
+  buffer.resize(start + chunk.numVerts() * 6 * int(sizeof(float)));
+  char *data = buffer.data() + start;
+  for (int v = 0; v < chunk.numVerts(); v++) {
+    float vertex[6] = {chunk.coords[v].x(),  chunk.coords[v].y(),
+                       chunk.coords[v].z(),  chunk.normals[v].x(),
+                       chunk.normals[v].y(), chunk.normals[v].z()};
+    memcpy(data, vertex, sizeof(vertex));
+    data += sizeof(vertex);
+  }
+}
+
+/**
+ * @brief PLYExporter::writeTriangles Writes every triangle of a chunk as a
+ * list of three vertex indices.
+ * @param buffer The buffer to append to.
+ * @param chunk The chunk.
+ */
+void PLYExporter::writeTriangles(QByteArray &buffer,
+                                 const TessellatedMesh &chunk) const {
+  const int faceSize = 1 + 3 * sizeof(quint32);
+  int start = buffer.size();
+  buffer.resize(start + chunk.numTriangles() * faceSize);
+  char *data = buffer.data() + start;
+  const unsigned int *indices = chunk.indices.constData();
+  for (int t = 0; t < chunk.numTriangles(); t++) {
+    data[0] = 3;
+    memcpy(data + 1, indices + 3 * t, 3 * sizeof(quint32));
+    data += faceSize;
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef PLY_EXPORTER_H
+#define PLY_EXPORTER_H
+
+#include "meshexporter.h"
+
+/**
+ * @brief The PLYExporter class writes meshes in the binary PLY format. Every
+ * vertex has a position and a normal. The data is written in the byte order
+ * of the host, which is declared in the header.
+ */
+class PLYExporter : public MeshExporter {
+ public:
+  PLYExporter();
+
+ protected:
+  void writeHeader(QByteArray& buffer, qint64 numVerts,
+                   qint64 numTriangles) const override;
+  void writeVertices(QByteArray& buffer,
+                     const TessellatedMesh& chunk) const override;
+  void writeTriangles(QByteArray& buffer,
+                      const TessellatedMesh& chunk) const override;
+};
+
+#endif  // PLY_EXPORTER_H
@@ -0,0 +1,93 @@
+#include "edgemap.h"
+
+// Marks an empty slot. Can never be a valid key, since vertex indices are
+// always smaller than INT_MAX.
+#define EMPTY_KEY (~quint64(0))
+
+/**
+ * @brief EdgeMap::EdgeMap Creates an empty edge map.
+ */
+EdgeMap::EdgeMap() : mask(0), shift(64) {}
+
+/**
+ * @brief EdgeMap::reserve Allocates enough slots to store the edges of a mesh
+ * with the provided number of half-edges. The table is kept at most half full,
+ * so that probe sequences remain short. Clears any existing content.
+ * @param numHalfEdges The number of half-edges of the mesh. This is an upper
+ * bound on the number of (undirected) edges.
+ */
+void EdgeMap::reserve(int numHalfEdges) {
+  int capacity = 16;
+  shift = 60;
+  while (capacity < 2 * numHalfEdges) {
+    capacity *= 2;
+    shift--;
+  }
+  mask = quint64(capacity - 1);
+  keys.fill(EMPTY_KEY, capacity);
+  values.fill(-1, capacity);
+}
+
+/**
+ * @brief EdgeMap::findOrInsert Looks up the undirected edge between the two
+ * vertices. If the edge is not present yet, it is inserted and associated with
+ * half-edge h.
+ * @param vertIdx1 Index of the first vertex of the edge.
+ * @param vertIdx2 Index of the second vertex of the edge.
+ * @param h Index of the half-edge to associate with the edge upon insertion.
+ * @return The index of the half-edge that was previously associated with the
+ * edge, or -1 if the edge was not present yet.
+ */
+int EdgeMap::findOrInsert(int vertIdx1, int vertIdx2, int h) {
+  quint64 key = packEdge(vertIdx1, vertIdx2);
+  quint64 slot = hashEdge(key) >> shift;
+  // Linear probing
+  while (keys[slot] != EMPTY_KEY) {
+    if (keys[slot] == key) {
+      return values[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  keys[slot] = key;
+  values[slot] = h;
+  return -1;
+}
+
+/**
+ * @brief EdgeMap::clear Removes all edges and releases the allocated memory.
+ */
+void EdgeMap::clear() {
+  keys.clear();
+  keys.squeeze();
+  values.clear();
+  values.squeeze();
+  mask = 0;
+  shift = 64;
+}
+
+/**
+ * @brief EdgeMap::packEdge Packs the two vertex indices of an undirected edge
+ * into a single key. Two indices always produce the same key, regardless of
+ * their ordering.
+ * @param vertIdx1 First vertex index.
+ * @param vertIdx2 Second vertex index.
+ * @return The key of the undirected edge.
+ */
+quint64 EdgeMap::packEdge(int vertIdx1, int vertIdx2) {
+  // to ensure that edges are consistent, always put the lower index first
+  if (vertIdx1 > vertIdx2) {
+    return (quint64(vertIdx2) << 32) | quint64(quint32(vertIdx1));
+  }
+  return (quint64(vertIdx1) << 32) | quint64(quint32(vertIdx2));
+}
+
+/**
+ * @brief EdgeMap::hashEdge Fibonacci hashing of an edge key. The most
+ * significant bits of the result are well distributed, which is why the slot
+ * is taken from the upper bits.
+ * @param key The packed edge.
+ * @return The hash of the edge.
+ */
+quint64 EdgeMap::hashEdge(quint64 key) {
+  return (key ^ (key >> 29)) * 0x9E3779B97F4A7C15ULL;
+}
@@ -0,0 +1,30 @@
+#ifndef EDGE_MAP_H
+#define EDGE_MAP_H
+
+#include <QVector>
+
+/**
+ * @brief The EdgeMap class is an open-addressing hash table that maps
+ * undirected edges (pairs of vertex indices) to the index of the first
+ * half-edge that was found on that edge. Used to resolve twins in linear time
+ * while constructing a half-edge mesh.
+ */
+class EdgeMap {
+ public:
+  EdgeMap();
+
+  void reserve(int numHalfEdges);
+  int findOrInsert(int vertIdx1, int vertIdx2, int h);
+  void clear();
+
+ private:
+  static quint64 packEdge(int vertIdx1, int vertIdx2);
+  static quint64 hashEdge(quint64 key);
+
+  QVector<quint64> keys;
+  QVector<int> values;
+  quint64 mask;
+  int shift;
+};
+
+#endif  // EDGE_MAP_H
@@ -0,0 +1,303 @@
+#include "meshcache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Identifies the binary mesh format. The version has to be incremented
+// whenever the layout changes, which invalidates all existing cache files.
+#define MESH_FORMAT_MAGIC 0x4D4D4441  // "ADMM"
+#define MESH_FORMAT_VERSION 1
+
+/**
+ * @brief The MeshFileHeader struct is the header of the binary mesh format. It
+ * is followed by the following arrays, all consisting of 32-bit elements:
+ *
+ * vertex coordinates (3 floats per vertex)
+ * vertex out half-edge, vertex valence
+ * half-edge origin, next, twin (-1 on a boundary), face, edge
+ * face side, face valence
+ *
+ * The previous half-edges are not stored, since they follow from the next
+ * half-edges.
+ */
+typedef struct MeshFileHeader {
+  quint32 magic;
+  quint32 version;
+  qint32 numVerts;
+  qint32 numHalfEdges;
+  qint32 numFaces;
+  qint32 numEdges;
+} MeshFileHeader;
+
+/**
+ * @brief meshFileSize Computes the size of a binary mesh file.
+ * @param header The header of the file.
+ * @return The size of the file in bytes.
+ */
+static qint64 meshFileSize(const MeshFileHeader &header) {
+  qint64 numElements = 5 * qint64(header.numVerts) +
+                       5 * qint64(header.numHalfEdges) +
+                       2 * qint64(header.numFaces);
+  return qint64(sizeof(MeshFileHeader)) + 4 * numElements;
+}
+
+/**
+ * @brief indicesInRange Determines whether all indices of an array refer to
+ * existing elements.
+ * @param indices The indices.
+ * @param count The number of indices.
+ * @param size The number of elements the indices refer to.
+ * @param allowNone Whether -1 is allowed, meaning no element.
+ * @return True if every index lies in [0, size), or is -1 if allowed.
+ */
+static bool indicesInRange(const qint32 *indices, int count, int size,
+                           bool allowNone) {
+  for (int k = 0; k < count; k++) {
+    if (indices[k] >= size || indices[k] < (allowNone ? -1 : 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief MeshCache::MeshCache Creates a new mesh cache.
+ */
+MeshCache::MeshCache() {}
+
+/**
+ * @brief MeshCache::load Loads the cached mesh of the provided source file, if
+ * it exists.
+ * @param sourceFileName Path of the .obj file the mesh was constructed from.
+ * @param mesh The mesh to load into. Should be empty.
+ * @return True if a valid cached mesh was found and loaded; false otherwise.
+ */
+bool MeshCache::load(const QString &sourceFileName, Mesh &mesh) const {
+  QString fileName = cacheFileName(sourceFileName);
+  if (fileName.isEmpty() || !QFile::exists(fileName)) {
+    return false;
+  }
+  return readMesh(fileName, mesh);
+}
+
+/**
+ * @brief MeshCache::store Stores the mesh in the cache, so that it can be
+ * loaded the next time the provided source file is opened.
+ * @param sourceFileName Path of the .obj file the mesh was constructed from.
+ * @param mesh The mesh to store.
+ * @return True if the mesh was stored successfully; false otherwise.
+ */
+bool MeshCache::store(const QString &sourceFileName, Mesh &mesh) const {
+  QString fileName = cacheFileName(sourceFileName);
+  if (fileName.isEmpty() || !QDir().mkpath(QFileInfo(fileName).path())) {
+    return false;
+  }
+  return writeMesh(fileName, mesh);
+}
+
+/**
+ * @brief MeshCache::cacheFileName Determines the name of the cache file of a
+ * source file by hashing its contents.
+ * @param sourceFileName Path of the .obj file.
+ * @return Path of the cache file. Empty if the source file could not be read.
+ */
+QString MeshCache::cacheFileName(const QString &sourceFileName) const {
+  QFile sourceFile(sourceFileName);
+  if (!sourceFile.open(QIODevice::ReadOnly)) {
+    return QString();
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(&sourceFile);
+  QString cacheDir =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  return cacheDir + "/meshes/" + hash.result().toHex() + ".mesh";
+}
+
+/**
+ * @brief appendArray Appends the raw contents of an array to the buffer.
+ * @param buffer The buffer to append to.
+ * @param values The array.
+ */
+template <typename T>
+static void appendArray(QByteArray &buffer, const QVector<T> &values) {
+  buffer.append(reinterpret_cast<const char *>(values.constData()),
+                qsizetype(sizeof(T)) * values.size());
+}
+
+/**
+ * @brief MeshCache::writeMesh Writes a mesh to a file in the binary mesh
+ * format.
+ * @param fileName Path of the file to write to.
+ * @param mesh The mesh to write.
+ * @return True if the mesh was written successfully; false otherwise.
+ */
+bool MeshCache::writeMesh(const QString &fileName, Mesh &mesh) {
+  MeshFileHeader header;
+  header.magic = MESH_FORMAT_MAGIC;
+  header.version = MESH_FORMAT_VERSION;
+  header.numVerts = mesh.numVerts();
+  header.numHalfEdges = mesh.numHalfEdges();
+  header.numFaces = mesh.numFaces();
+  header.numEdges = mesh.numEdges();
+
+  QVector<float> coords(3 * header.numVerts);
+  QVector<qint32> vertexOut(header.numVerts);
+  QVector<qint32> vertexValence(header.numVerts);
+  for (int v = 0; v < header.numVerts; v++) {
+    const Vertex &vertex = mesh.vertices[v];
+    coords[3 * v] = vertex.coords.x();
+    coords[3 * v + 1] = vertex.coords.y();
+    coords[3 * v + 2] = vertex.coords.z();
+    vertexOut[v] = vertex.out == nullptr ? -1 : vertex.out->index;
+    vertexValence[v] = vertex.valence;
+  }
+
+  QVector<qint32> origin(header.numHalfEdges);
+  QVector<qint32> next(header.numHalfEdges);
+  QVector<qint32> twin(header.numHalfEdges);
+  QVector<qint32> face(header.numHalfEdges);
+  QVector<qint32> edge(header.numHalfEdges);
+  for (int h = 0; h < header.numHalfEdges; h++) {
+    const HalfEdge &halfEdge = mesh.halfEdges[h];
+    origin[h] = halfEdge.origin->index;
+    next[h] = halfEdge.nextIdx();
+    twin[h] = halfEdge.twinIdx();
+    face[h] = halfEdge.faceIdx();
+    edge[h] = halfEdge.edgeIdx();
+  }
+
+  QVector<qint32> faceSide(header.numFaces);
+  QVector<qint32> faceValence(header.numFaces);
+  for (int f = 0; f < header.numFaces; f++) {
+    faceSide[f] = mesh.faces[f].side->index;
+    faceValence[f] = mesh.faces[f].valence;
+  }
+
+  QByteArray buffer;
+  buffer.reserve(meshFileSize(header));
+  buffer.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  appendArray(buffer, coords);
+  appendArray(buffer, vertexOut);
+  appendArray(buffer, vertexValence);
+  appendArray(buffer, origin);
+  appendArray(buffer, next);
+  appendArray(buffer, twin);
+  appendArray(buffer, face);
+  appendArray(buffer, edge);
+  appendArray(buffer, faceSide);
+  appendArray(buffer, faceValence);
+
+  // Written to a temporary file first, so that an interrupted write never
+  // leaves a corrupt cache file behind.
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  file.write(buffer);
+  return file.commit();
+}
+
+/**
+ * @brief MeshCache::readMesh Reads a mesh in the binary mesh format. The file
+ * is mapped into memory and the index arrays are used directly to link up the
+ * vertices, half-edges and faces; no topology has to be reconstructed.
+ * @param fileName Path of the file to read.
+ * @param mesh The mesh to read into. Should be empty.
+ * @return True if the mesh was read successfully; false if the file could not
+ * be read, has an incompatible format or contains invalid indices.
+ */
+bool MeshCache::readMesh(const QString &fileName, Mesh &mesh) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly) ||
+      file.size() < qint64(sizeof(MeshFileHeader))) {
+    return false;
+  }
+  const uchar *data = file.map(0, file.size());
+  if (data == nullptr) {
+    return false;
+  }
+
+  MeshFileHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != MESH_FORMAT_MAGIC ||
+      header.version != MESH_FORMAT_VERSION || header.numVerts < 0 ||
+      header.numHalfEdges < 0 || header.numFaces < 0 ||
+      meshFileSize(header) != file.size()) {
+    qDebug() << " * Ignoring incompatible mesh file" << fileName;
+    return false;
+  }
+
+  int numVerts = header.numVerts;
+  int numHalfEdges = header.numHalfEdges;
+  int numFaces = header.numFaces;
+  const float *coords =
+      reinterpret_cast<const float *>(data + sizeof(MeshFileHeader));
+  const qint32 *vertexOut = reinterpret_cast<const qint32 *>(coords) +
+                            3 * qint64(numVerts);
+  const qint32 *vertexValence = vertexOut + numVerts;
+  const qint32 *origin = vertexValence + numVerts;
+  const qint32 *next = origin + numHalfEdges;
+  const qint32 *twin = next + numHalfEdges;
+  const qint32 *face = twin + numHalfEdges;
+  const qint32 *edge = face + numHalfEdges;
+  const qint32 *faceSide = edge + numHalfEdges;
+  const qint32 *faceValence = faceSide + numFaces;
+
+  // A corrupt file of the right size would otherwise produce dangling
+  // pointers, so every index is checked before the mesh is linked up.
+  bool valid =
+      indicesInRange(vertexOut, numVerts, numHalfEdges, true) &&
+      indicesInRange(origin, numHalfEdges, numVerts, false) &&
+      indicesInRange(next, numHalfEdges, numHalfEdges, false) &&
+      indicesInRange(twin, numHalfEdges, numHalfEdges, true) &&
+      indicesInRange(face, numHalfEdges, numFaces, false) &&
+      indicesInRange(edge, numHalfEdges, header.numEdges, false) &&
+      indicesInRange(faceSide, numFaces, numHalfEdges, false);
+  for (int v = 0; valid && v < numVerts; v++) {
+    // Isolated vertices have no out half-edge and valence 0.
+    valid = vertexOut[v] < 0 ? vertexValence[v] == 0 : vertexValence[v] > 0;
+  }
+  for (int f = 0; valid && f < numFaces; f++) {
+    valid = faceValence[f] > 0;
+  }
+  if (!valid) {
+    qDebug() << " * Ignoring corrupt mesh file" << fileName;
+    return false;
+  }
+
+  mesh.vertices.resize(numVerts);
+  mesh.halfEdges.resize(numHalfEdges);
+  mesh.faces.resize(numFaces);
+  mesh.edgeCount = header.numEdges;
+
+  for (int v = 0; v < numVerts; v++) {
+    Vertex *vertex = &mesh.vertices[v];
+    vertex->coords =
+        QVector3D(coords[3 * v], coords[3 * v + 1], coords[3 * v + 2]);
+    vertex->out = vertexOut[v] < 0 ? nullptr : &mesh.halfEdges[vertexOut[v]];
+    vertex->valence = vertexValence[v];
+    vertex->index = v;
+  }
+  for (int h = 0; h < numHalfEdges; h++) {
+    HalfEdge *halfEdge = &mesh.halfEdges[h];
+    halfEdge->index = h;
+    halfEdge->origin = &mesh.vertices[origin[h]];
+    halfEdge->next = &mesh.halfEdges[next[h]];
+    halfEdge->twin = twin[h] < 0 ? nullptr : &mesh.halfEdges[twin[h]];
+    halfEdge->face = &mesh.faces[face[h]];
+    halfEdge->edgeIndex = edge[h];
+    halfEdge->next->prev = halfEdge;
+  }
+  for (int f = 0; f < numFaces; f++) {
+    Face *meshFace = &mesh.faces[f];
+    meshFace->side = &mesh.halfEdges[faceSide[f]];
+    meshFace->valence = faceValence[f];
+    meshFace->index = f;
+  }
+  return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <QString>
+
+#include "../mesh/mesh.h"
+
+/**
+ * @brief The MeshCache class stores half-edge meshes in a compact binary
+ * format, so that they can be loaded again without parsing and reconstructing
+ * the topology. Cached meshes are stored in the cache directory of the user,
+ * keyed by the hash of the contents of the source file.
+ */
+class MeshCache {
+ public:
+  MeshCache();
+
+  bool load(const QString& sourceFileName, Mesh& mesh) const;
+  bool store(const QString& sourceFileName, Mesh& mesh) const;
+
+  static bool writeMesh(const QString& fileName, Mesh& mesh);
+  static bool readMesh(const QString& fileName, Mesh& mesh);
+
+ private:
+  QString cacheFileName(const QString& sourceFileName) const;
+};
+
+#endif  // MESH_CACHE_H
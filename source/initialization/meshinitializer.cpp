@@ -19,12 +19,26 @@ MeshInitializer::MeshInitializer() {}
  * @return A half-edge representation of the provided mesh.
  */
 Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile &loadedOBJFile) {
-  int numVertices = loadedOBJFile.vertexCoords.size();
-  int numFaces = loadedOBJFile.faceValences.size();
-  int numHalfEdges = 0;
-  for (int f = 0; f < numFaces; f++) {
-    numHalfEdges += loadedOBJFile.faceValences[f];
-  }
+  return constructHalfEdgeMesh(loadedOBJFile.vertexCoords,
+                               loadedOBJFile.faceValences,
+                               loadedOBJFile.faceCoordInd);
+}
+
+/**
+ * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
+ * from flat vertex and face arrays, in the same format as the OBJFile uses.
+ * @param vertexCoords The vertex coordinates.
+ * @param faceValences The valence of every face.
+ * @param faceCoordInd A flat vector containing, for each face, the indices of
+ * the vertices.
+ * @return A half-edge representation of the provided mesh.
+ */
+Mesh MeshInitializer::constructHalfEdgeMesh(
+    const QVector<QVector3D> &vertexCoords, const QVector<int> &faceValences,
+    const QVector<int> &faceCoordInd) {
+  int numVertices = vertexCoords.size();
+  int numFaces = faceValences.size();
+  int numHalfEdges = faceCoordInd.size();
 
   Mesh mesh;
   mesh.vertices.resize(numVertices);
@@ -32,8 +46,13 @@ Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile &loadedOBJFile) {
   mesh.halfEdges.resize(numHalfEdges);
   mesh.halfEdges.reserve(2 * numHalfEdges);
 
-  initGeometry(mesh, numVertices, loadedOBJFile.vertexCoords);
-  initTopology(mesh, numFaces, loadedOBJFile.faceCoordInd);
+  edgeMap.reserve(numHalfEdges);
+  edgeCount = 0;
+
+  initGeometry(mesh, numVertices, vertexCoords);
+  initTopology(mesh, numFaces, faceValences, faceCoordInd);
+
+  edgeMap.clear();
   return mesh;
 }
 
@@ -58,19 +77,22 @@ void MeshInitializer::initGeometry(Mesh &mesh, int numVertices,
  * data. Makes sure that all the connections are set up correctly.
  * @param mesh The mesh to initialize.
  * @param numFaces The number of faces the mesh will have.
- * @param faceCoordInd A vector containing, for each face, the indices of the
- * vertices.
+ * @param faceValences A vector containing the valence of every face.
+ * @param faceCoordInd A flat vector containing, for each face, the indices of
+ * the vertices.
  */
 void MeshInitializer::initTopology(Mesh &mesh, int numFaces,
-                                   const QVector<QVector<int>> &faceCoordInd) {
+                                   const QVector<int> &faceValences,
+                                   const QVector<int> &faceCoordInd) {
   int h = 0;
   for (int f = 0; f < numFaces; ++f) {
-    QVector<int> faceIndices = faceCoordInd[f];
+    // The indices of a face start at the index of its first half-edge.
+    const int *faceIndices = faceCoordInd.constData() + h;
     // Each face ends up with a number of half edges equal to its number of
     // vertices.
     Face *face = &mesh.faces[f];
     face->index = f;
-    face->valence = faceIndices.size();
+    face->valence = faceValences[f];
     face->side = &mesh.halfEdges[h];
     for (int i = 0; i < face->valence; ++i) {
       addHalfEdge(mesh, h, face, faceIndices, i);
@@ -80,7 +102,7 @@ void MeshInitializer::initTopology(Mesh &mesh, int numFaces,
       h++;
     }
   }
-  mesh.edgeCount = edgeList.size();
+  mesh.edgeCount = edgeCount;
 }
 
 /**
@@ -90,12 +112,12 @@ void MeshInitializer::initTopology(Mesh &mesh, int numFaces,
  * @param h Index of the half-edge.
  * @param face Face that the half-edge belongs to.
  * @param vertIndices Indices of the vertices that belong to the face this
- * half-edge belongs to.
- * @param i Index within vertIndices vector.
+ * half-edge belongs to. Contains face->valence indices.
+ * @param i Index within vertIndices.
  */
 void MeshInitializer::addHalfEdge(Mesh &mesh, int h, Face *face,
-                                  const QVector<int> &vertIndices, int i) {
-  int faceValence = vertIndices.size();
+                                  const int *vertIndices, int i) {
+  int faceValence = face->valence;
   int vertIdx = vertIndices[i];
   int nextVertIdx = vertIndices[(i + 1) % faceValence];
   // prev and next
@@ -119,26 +141,11 @@ void MeshInitializer::addHalfEdge(Mesh &mesh, int h, Face *face,
   setTwins(mesh, h, vertIdx, nextVertIdx);
 }
 
-/**
- * @brief createUndirectedEdge Creates an undirected edge from two vertex
- * indices.
- * @param v1 First vertex index.
- * @param v2 Second vertex index.
- * @return A pair of v1-v2. Two indices always produce the same pair, regardless
- * of their ordering.
- */
-QPair<int, int> createUndirectedEdge(int v1, int v2) {
-  // to ensure that edges are consistent, always put the lower index first
-  if (v1 > v2) {
-    return QPair<int, int>(v2, v1);
-  }
-  return QPair<int, int>(v1, v2);
-}
-
 /**
  * @brief MeshInitializer::setTwins Set the twin properties of the half-edge.
  * Simultaneously updates the edge indices by keeping track of all the edges
- * that have been (partially) covered.
+ * that have been (partially) covered. The lookup of the edge is done in the
+ * edge map, which makes this constant time.
  * @param mesh The mesh the half-edge belongs to.
  * @param h Index of the half-edge.
  * @param vertIdx1 Index of the first vertex of the edge the half-edge belongs
@@ -147,21 +154,16 @@ QPair<int, int> createUndirectedEdge(int v1, int v2) {
  * to.
  */
 void MeshInitializer::setTwins(Mesh &mesh, int h, int vertIdx1, int vertIdx2) {
-  QPair<int, int> currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
-
-  int edgeIdx = edgeList.indexOf(currentEdge);
+  int twinIdx = edgeMap.findOrInsert(vertIdx1, vertIdx2, h);
   // edge does not exist yet
-  if (edgeIdx == -1) {
-    // same as doing this after appending and adding -1
-    edgeIndices.append(edgeList.size());
-    mesh.halfEdges[h].edgeIndex = edgeList.size();
-    edgeList.append(currentEdge);
+  if (twinIdx == -1) {
+    mesh.halfEdges[h].edgeIndex = edgeCount;
+    edgeCount++;
   } else {
-    edgeIndices.append(edgeIdx);
-    mesh.halfEdges[h].edgeIndex = edgeIdx;
     // edge already existed, meaning there is a twin somewhere earlier in the
-    // list of edges
-    HalfEdge *twinEdge = &mesh.halfEdges[edgeIndices.indexOf(edgeIdx)];
+    // list of half-edges
+    HalfEdge *twinEdge = &mesh.halfEdges[twinIdx];
+    mesh.halfEdges[h].edgeIndex = twinEdge->edgeIndex;
     mesh.halfEdges[h].twin = twinEdge;
     twinEdge->twin = &mesh.halfEdges[h];
   }
@@ -2,27 +2,32 @@
 #define MESH_INITIALIZER_H
 
 #include "../mesh/mesh.h"
+#include "edgemap.h"
 #include "objfile.h"
 
 /**
- * @brief The MeshInitializer class initializes half-edge meshes from OBJFiles.
+ * @brief The MeshInitializer class initializes half-edge meshes from OBJFiles
+ * or from flat vertex and face arrays.
  */
 class MeshInitializer {
  public:
   MeshInitializer();
   Mesh constructHalfEdgeMesh(const OBJFile& loadedOBJFile);
+  Mesh constructHalfEdgeMesh(const QVector<QVector3D>& vertexCoords,
+                             const QVector<int>& faceValences,
+                             const QVector<int>& faceCoordInd);
 
  private:
   void initGeometry(Mesh& mesh, int numVertices,
                     const QVector<QVector3D>& vertexCoords);
-  void initTopology(Mesh& mesh, int numFaces,
-                     const QVector<QVector<int>>& faceCoordInd);
-  void addHalfEdge(Mesh& mesh, int h, Face* face,
-                   const QVector<int>& faceIndices, int i);
+  void initTopology(Mesh& mesh, int numFaces, const QVector<int>& faceValences,
+                    const QVector<int>& faceCoordInd);
+  void addHalfEdge(Mesh& mesh, int h, Face* face, const int* faceIndices,
+                   int i);
   void setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
 
-  QList<QPair<int, int>> edgeList;
-  QVector<int> edgeIndices;
+  EdgeMap edgeMap;
+  int edgeCount;
 };
 
 #endif  // MESH_INITIALIZER_H
@@ -1,16 +1,25 @@
 #include "objfile.h"
 
+#include <math.h>
+
 #include <QDebug>
 #include <QFile>
 #include <QMatrix4x4>
+#include <QThread>
 
+#include "util/parallel.h"
 #include "util/util.h"
 
 #define DESIRED_SCALE 2.0
+// Files are split into chunks of at least this many bytes, which are parsed in
+// parallel.
+#define MIN_CHUNK_SIZE (1 << 20)
 
 /**
  * @brief OBJFile::OBJFile Reads information from the provided .obj file and
- * stores it in this class.
+ * stores it in this class. The file is mapped into memory and tokenized in
+ * place, so no intermediate strings are allocated. Large files are split into
+ * chunks that are parsed in parallel.
  * @param fileName The path of the .obj file
  */
 OBJFile::OBJFile(const QString &fileName) {
@@ -18,102 +27,455 @@ OBJFile::OBJFile(const QString &fileName) {
   QFile newModel(fileName);
 
   if (newModel.open(QIODevice::ReadOnly)) {
-    QTextStream fileContents(&newModel);
-
-    while (!fileContents.atEnd()) {
-      QString currentLine = fileContents.readLine();
-      QStringList values = currentLine.split(" ");
-
-      const QString descriptor = values[0];
-      if (descriptor == "v") {
-        handleVertex(values);
-      } else if (descriptor == "vt") {
-        handleVertexTexCoords(values);
-      } else if (descriptor == "vn") {
-        handleVertexNormal(values);
-      } else if (descriptor == "f") {
-        handleFace(values);
-      } else {
-        qDebug() << " * Line contents ignored," << currentLine;
-      }
+    qint64 size = newModel.size();
+    const char *data =
+        reinterpret_cast<const char *>(newModel.map(0, size));
+    // Not every file can be mapped (e.g. compressed resources or empty files),
+    // in which case the contents are read into memory instead.
+    QByteArray contents;
+    if (data == nullptr) {
+      contents = newModel.readAll();
+      data = contents.constData();
+      size = contents.size();
     }
+    parseChunks(data, data + size);
+    // Closing the file also unmaps it
     newModel.close();
-    normalizeMesh(DESIRED_SCALE);
-    loadSuccess = true;
+    loadSuccess = !vertexCoords.isEmpty();
+    if (loadSuccess) {
+      normalizeMesh(DESIRED_SCALE);
+    }
   } else {
     loadSuccess = false;
   }
 }
 
+/**
+ * @brief OBJFile::OBJFile Creates an empty OBJ file. Used for the chunks of a
+ * file that is parsed in parallel.
+ */
+OBJFile::OBJFile() : loadSuccess(false) {}
+
 /**
  * @brief OBJFile::~OBJFile Deconstructor.
  */
 OBJFile::~OBJFile() {}
 
+/**
+ * @brief skipSpaces Skips spaces, tabs and carriage returns.
+ * @param p Current position in the file contents.
+ * @param end End of the file contents.
+ * @return The position of the first character that is not a space.
+ */
+static inline const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * @brief skipLine Skips the remainder of the current line.
+ * @param p Current position in the file contents.
+ * @param end End of the file contents.
+ * @return The position of the first character of the next line.
+ */
+static inline const char *skipLine(const char *p, const char *end) {
+  while (p < end && *p != '\n') {
+    p++;
+  }
+  return p < end ? p + 1 : end;
+}
+
+/**
+ * @brief isSeparator Checks whether the character ends a token.
+ * @param p Position of the character in the file contents.
+ * @param end End of the file contents.
+ * @return True if p is at the end of the contents or at whitespace.
+ */
+static inline bool isSeparator(const char *p, const char *end) {
+  return p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n';
+}
+
+/**
+ * @brief parseInt Parses a (possibly negative) integer.
+ * @param p Current position in the file contents.
+ * @param end End of the file contents.
+ * @param value Set to the parsed integer.
+ * @return The position after the integer. Equal to p if no integer could be
+ * parsed.
+ */
+static inline const char *parseInt(const char *p, const char *end,
+                                   int &value) {
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  const char *digits = p;
+  int result = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    result = 10 * result + (*p - '0');
+    p++;
+  }
+  if (p == digits) {
+    return start;
+  }
+  value = negative ? -result : result;
+  return p;
+}
+
+/**
+ * @brief parseFloat Parses a floating point number of the form
+ * [+-]digits[.digits][(e|E)[+-]digits].
+ * @param p Current position in the file contents.
+ * @param end End of the file contents.
+ * @param value Set to the parsed number.
+ * @return The position after the number. Equal to p if no number could be
+ * parsed.
+ */
+static inline const char *parseFloat(const char *p, const char *end,
+                                     float &value) {
+  // Exactly representable powers of ten
+  static const double powersOfTen[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  quint64 mantissa = 0;
+  int exponent = 0;
+  int numDigits = 0;
+  // Digits beyond the 19th do not fit in the mantissa and do not affect a
+  // single precision result.
+  while (p < end && *p >= '0' && *p <= '9') {
+    if (numDigits < 19) {
+      mantissa = 10 * mantissa + quint64(*p - '0');
+    } else {
+      exponent++;
+    }
+    numDigits++;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (numDigits < 19) {
+        mantissa = 10 * mantissa + quint64(*p - '0');
+        exponent--;
+      }
+      numDigits++;
+      p++;
+    }
+  }
+  if (numDigits == 0) {
+    return start;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int exp = 0;
+    const char *expEnd = parseInt(p + 1, end, exp);
+    if (expEnd != p + 1) {
+      exponent += exp;
+      p = expEnd;
+    }
+  }
+
+  double result = double(mantissa);
+  if (exponent < 0) {
+    result /= exponent >= -22 ? powersOfTen[-exponent] : pow(10.0, -exponent);
+  } else if (exponent > 0) {
+    result *= exponent <= 22 ? powersOfTen[exponent] : pow(10.0, exponent);
+  }
+  value = float(negative ? -result : result);
+  return p;
+}
+
+/**
+ * @brief OBJFile::parseChunks Splits the contents of an .obj file at line
+ * boundaries into chunks, parses the chunks in parallel and merges the results
+ * into this class.
+ * @param p Start of the file contents.
+ * @param end End of the file contents.
+ */
+void OBJFile::parseChunks(const char *p, const char *end) {
+  qint64 size = end - p;
+  int numChunks = int(std::min<qint64>(size / MIN_CHUNK_SIZE + 1,
+                                       4 * QThread::idealThreadCount()));
+  if (numChunks <= 1) {
+    int ignoredLines = parse(p, end);
+    if (ignoredLines > 0) {
+      qDebug() << " * Contents of" << ignoredLines << "lines ignored";
+    }
+    return;
+  }
+
+  QVector<const char *> bounds(numChunks + 1);
+  bounds[0] = p;
+  for (int c = 1; c < numChunks; c++) {
+    bounds[c] = skipLine(std::max(p + c * (size / numChunks), bounds[c - 1]),
+                         end);
+  }
+  bounds[numChunks] = end;
+
+  QVector<OBJFile> chunks(numChunks);
+  QVector<int> ignoredLines(numChunks);
+  parallelFor(
+      0, numChunks,
+      [&](int begin, int end) {
+        for (int c = begin; c < end; c++) {
+          ignoredLines[c] = chunks[c].parse(bounds[c], bounds[c + 1]);
+        }
+      },
+      1);
+  merge(chunks);
+
+  int totalIgnoredLines = 0;
+  for (int c = 0; c < numChunks; c++) {
+    totalIgnoredLines += ignoredLines[c];
+  }
+  if (totalIgnoredLines > 0) {
+    qDebug() << " * Contents of" << totalIgnoredLines << "lines ignored";
+  }
+}
+
+/**
+ * @brief appendChunk Copies the elements of a chunk into the merged vector.
+ * @param merged The merged vector. Should already have its final size.
+ * @param offset Position of the first element of the chunk in the merged
+ * vector.
+ * @param chunk The elements of the chunk.
+ */
+template <typename T>
+static void appendChunk(QVector<T> &merged, int offset,
+                        const QVector<T> &chunk) {
+  std::copy(chunk.constBegin(), chunk.constEnd(), merged.begin() + offset);
+}
+
+/**
+ * @brief OBJFile::merge Concatenates the data of the parsed chunks into this
+ * class. The offsets of every chunk follow from prefix sums over the element
+ * counts of the chunks. Relative indices in a chunk only account for the
+ * elements of that chunk, so the number of elements of all preceding chunks
+ * is added to them.
+ * @param chunks The parsed chunks, in file order.
+ */
+void OBJFile::merge(const QVector<OBJFile> &chunks) {
+  int numChunks = chunks.size();
+  // Prefix sums of the vertex, texture coordinate, normal, face and index
+  // counts. The last entry contains the total.
+  QVector<int> coordOffsets(numChunks + 1, 0);
+  QVector<int> texOffsets(numChunks + 1, 0);
+  QVector<int> normalOffsets(numChunks + 1, 0);
+  QVector<int> faceOffsets(numChunks + 1, 0);
+  QVector<int> coordIndOffsets(numChunks + 1, 0);
+  QVector<int> texIndOffsets(numChunks + 1, 0);
+  QVector<int> normalIndOffsets(numChunks + 1, 0);
+  for (int c = 0; c < numChunks; c++) {
+    const OBJFile &chunk = chunks[c];
+    coordOffsets[c + 1] = coordOffsets[c] + chunk.vertexCoords.size();
+    texOffsets[c + 1] = texOffsets[c] + chunk.textureCoords.size();
+    normalOffsets[c + 1] = normalOffsets[c] + chunk.vertexNormals.size();
+    faceOffsets[c + 1] = faceOffsets[c] + chunk.faceValences.size();
+    coordIndOffsets[c + 1] = coordIndOffsets[c] + chunk.faceCoordInd.size();
+    texIndOffsets[c + 1] = texIndOffsets[c] + chunk.faceTexInd.size();
+    normalIndOffsets[c + 1] = normalIndOffsets[c] + chunk.faceNormalInd.size();
+  }
+
+  vertexCoords.resize(coordOffsets[numChunks]);
+  textureCoords.resize(texOffsets[numChunks]);
+  vertexNormals.resize(normalOffsets[numChunks]);
+  faceValences.resize(faceOffsets[numChunks]);
+  faceCoordInd.resize(coordIndOffsets[numChunks]);
+  faceTexInd.resize(texIndOffsets[numChunks]);
+  faceNormalInd.resize(normalIndOffsets[numChunks]);
+
+  parallelFor(
+      0, numChunks,
+      [&](int begin, int end) {
+        for (int c = begin; c < end; c++) {
+          const OBJFile &chunk = chunks[c];
+          appendChunk(vertexCoords, coordOffsets[c], chunk.vertexCoords);
+          appendChunk(textureCoords, texOffsets[c], chunk.textureCoords);
+          appendChunk(vertexNormals, normalOffsets[c], chunk.vertexNormals);
+          appendChunk(faceValences, faceOffsets[c], chunk.faceValences);
+          appendChunk(faceCoordInd, coordIndOffsets[c], chunk.faceCoordInd);
+          appendChunk(faceTexInd, texIndOffsets[c], chunk.faceTexInd);
+          appendChunk(faceNormalInd, normalIndOffsets[c],
+                      chunk.faceNormalInd);
+
+          for (int i : chunk.relativeCoordInd) {
+            faceCoordInd[coordIndOffsets[c] + i] += coordOffsets[c];
+          }
+          for (int i : chunk.relativeTexInd) {
+            faceTexInd[texIndOffsets[c] + i] += texOffsets[c];
+          }
+          for (int i : chunk.relativeNormalInd) {
+            faceNormalInd[normalIndOffsets[c] + i] += normalOffsets[c];
+          }
+        }
+      },
+      1);
+}
+
+/**
+ * @brief OBJFile::parse Tokenizes the contents of (a chunk of) an .obj file
+ * and appends the data to the flat arrays of this class.
+ * @param p Start of the file contents.
+ * @param end End of the file contents.
+ * @return The number of lines whose contents were ignored.
+ */
+int OBJFile::parse(const char *p, const char *end) {
+  int ignoredLines = 0;
+  while (p < end) {
+    p = skipSpaces(p, end);
+    if (p == end) {
+      break;
+    }
+    if (p[0] == 'v' && isSeparator(p + 1, end)) {
+      p = handleVertex(p + 1, end);
+    } else if (p[0] == 'v' && p + 1 < end && p[1] == 't' &&
+               isSeparator(p + 2, end)) {
+      p = handleVertexTexCoords(p + 2, end);
+    } else if (p[0] == 'v' && p + 1 < end && p[1] == 'n' &&
+               isSeparator(p + 2, end)) {
+      p = handleVertexNormal(p + 2, end);
+    } else if (p[0] == 'f' && isSeparator(p + 1, end)) {
+      p = handleFace(p + 1, end);
+    } else if (p[0] != '\n') {
+      ignoredLines++;
+    }
+    p = skipLine(p, end);
+  }
+  return ignoredLines;
+}
+
 /**
  * @brief OBJFile::handleVertex Handles vertex coordinate data. Invoked when the
  * line starts with "v".
- * @param values Line contents split by whitespace.
+ * @param p Position after the descriptor.
+ * @param end End of the file contents.
+ * @return The position after the parsed data.
  */
-void OBJFile::handleVertex(const QStringList &values) {
+const char *OBJFile::handleVertex(const char *p, const char *end) {
   // Only x, y and z. If there's a w value (homogenous coordinates),
   // ignore it.
-  vertexCoords.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
+  float coords[3] = {0, 0, 0};
+  for (int i = 0; i < 3; i++) {
+    p = parseFloat(skipSpaces(p, end), end, coords[i]);
+  }
+  vertexCoords.append(QVector3D(coords[0], coords[1], coords[2]));
+  return p;
 }
 
 /**
  * @brief OBJFile::handleVertexTexCoords Handles vertex texture data. Invoked
  * when the line starts with "vt".
- * @param values Line contents split by whitespace.
+ * @param p Position after the descriptor.
+ * @param end End of the file contents.
+ * @return The position after the parsed data.
  */
-void OBJFile::handleVertexTexCoords(const QStringList &values) {
+const char *OBJFile::handleVertexTexCoords(const char *p, const char *end) {
   // Only u and v. If there's a w value (barycentric coordinates), ignore
   // it, it can be retrieved from 1-u-v.
-  textureCoords.append(QVector2D(values[1].toFloat(), values[2].toFloat()));
+  float coords[2] = {0, 0};
+  for (int i = 0; i < 2; i++) {
+    p = parseFloat(skipSpaces(p, end), end, coords[i]);
+  }
+  textureCoords.append(QVector2D(coords[0], coords[1]));
+  return p;
 }
 
 /**
  * @brief OBJFile::handleVertexNormal Handles vertex normal data. Invoked
  * when the line starts with "vn".
- * @param values Line contents split by whitespace.
+ * @param p Position after the descriptor.
+ * @param end End of the file contents.
+ * @return The position after the parsed data.
  */
-void OBJFile::handleVertexNormal(const QStringList &values) {
-  vertexNormals.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
+const char *OBJFile::handleVertexNormal(const char *p, const char *end) {
+  float coords[3] = {0, 0, 0};
+  for (int i = 0; i < 3; i++) {
+    p = parseFloat(skipSpaces(p, end), end, coords[i]);
+  }
+  vertexNormals.append(QVector3D(coords[0], coords[1], coords[2]));
+  return p;
+}
+
+/**
+ * @brief appendIndex Converts an OBJ index to a zero-based index and appends
+ * it. Positive indices start counting at 1, negative indices are relative to
+ * the end of the elements that were defined so far. Since a chunk only knows
+ * its own elements, the position of every relative index is recorded as well.
+ * @param indices The face indices to append to.
+ * @param relativeIndices The positions of the relative indices.
+ * @param index The index as it appears in the .obj file.
+ * @param count The number of elements defined so far in this chunk.
+ */
+static inline void appendIndex(QVector<int> &indices,
+                               QVector<int> &relativeIndices, int index,
+                               int count) {
+  if (index < 0) {
+    relativeIndices.append(indices.size());
+    indices.append(count + index);
+  } else {
+    indices.append(index - 1);
+  }
 }
 
 /**
  * @brief OBJFile::handleFace Handles face index data. Invoked
- * when the line starts with "f".
- * @param values Line contents split by whitespace.
- */
-void OBJFile::handleFace(const QStringList &values) {
-  QVector<int> faceCoordsIndices;
-  QVector<int> faceTexIndices;
-  QVector<int> faceNormalIndices;
-  for (int k = 1; k < values.size(); k++) {
-    QStringList indices = values[k].split("/");
-
-    // Note -1, OBJ starts indexing from 1.
-    faceCoordsIndices.append(indices[0].toInt() - 1);
-
-    if (indices.size() > 1) {
-      if (!indices[1].isEmpty()) {
-        faceTexIndices.append(indices[1].toInt() - 1);
+ * when the line starts with "f". Every vertex of the face is of the form v,
+ * v/vt, v//vn or v/vt/vn.
+ * @param p Position after the descriptor.
+ * @param end End of the file contents.
+ * @return The position after the parsed data.
+ */
+const char *OBJFile::handleFace(const char *p, const char *end) {
+  int valence = 0;
+  p = skipSpaces(p, end);
+  while (p < end && *p != '\n') {
+    int index;
+    const char *next = parseInt(p, end, index);
+    if (next == p) {
+      // Malformed token; skip it
+      while (!isSeparator(p, end)) {
+        p++;
       }
+      p = skipSpaces(p, end);
+      continue;
+    }
+    p = next;
+    appendIndex(faceCoordInd, relativeCoordInd, index, vertexCoords.size());
+    valence++;
 
-      if (indices.size() > 2) {
-        if (!indices[2].isEmpty()) {
-          faceNormalIndices.append(indices[2].toInt() - 1);
+    if (p < end && *p == '/') {
+      next = parseInt(p + 1, end, index);
+      if (next != p + 1) {
+        appendIndex(faceTexInd, relativeTexInd, index,
+                    textureCoords.size());
+      }
+      p = next;
+      if (p < end && *p == '/') {
+        next = parseInt(p + 1, end, index);
+        if (next != p + 1) {
+          appendIndex(faceNormalInd, relativeNormalInd, index,
+                      vertexNormals.size());
         }
+        p = next;
       }
     }
+    p = skipSpaces(p, end);
+  }
+  if (valence > 0) {
+    faceValences.append(valence);
   }
-  faceCoordInd.append(faceCoordsIndices);
-  faceTexIndices.append(faceTexIndices);
-  faceNormalIndices.append(faceNormalIndices);
-  faceValences.append(values.size() - 1);
+  return p;
 }
 
 /**
@@ -7,10 +7,13 @@
 #include <QVector>
 
 /**
- * @brief The OBJFile class is used for storing info from the .obj files.
+ * @brief The OBJFile class is used for storing info from the .obj files. The
+ * face indices are stored in flat arrays: the indices of face f start at the
+ * sum of the valences of all faces before f.
  */
 class OBJFile {
  public:
+  OBJFile();
   OBJFile(const QString& fileName);
   ~OBJFile();
 
@@ -18,18 +21,28 @@ class OBJFile {
   void normalizeMesh(float desiredScale);
 
  private:
-  void handleVertex(const QStringList& values);
-  void handleVertexTexCoords(const QStringList& values);
-  void handleVertexNormal(const QStringList& values);
-  void handleFace(const QStringList& values);
+  void parseChunks(const char* p, const char* end);
+  void merge(const QVector<OBJFile>& chunks);
+  int parse(const char* p, const char* end);
+  const char* handleVertex(const char* p, const char* end);
+  const char* handleVertexTexCoords(const char* p, const char* end);
+  const char* handleVertexNormal(const char* p, const char* end);
+  const char* handleFace(const char* p, const char* end);
 
   QVector<QVector3D> vertexCoords;
   QVector<QVector2D> textureCoords;
   QVector<QVector3D> vertexNormals;
   QVector<int> faceValences;
-  QVector<QVector<int>> faceCoordInd;
-  QVector<QVector<int>> faceTexInd;
-  QVector<QVector<int>> faceNormalInd;
+  QVector<int> faceCoordInd;
+  QVector<int> faceTexInd;
+  QVector<int> faceNormalInd;
+
+  // Positions in the face index arrays of negative (relative) indices. Only
+  // used while parsing a chunk, since these indices are relative to the
+  // elements of all preceding chunks.
+  QVector<int> relativeCoordInd;
+  QVector<int> relativeTexInd;
+  QVector<int> relativeNormalInd;
 
   bool loadSuccess;
 
@@ -2,8 +2,10 @@
 
 #include <math.h>
 
+#include <QDateTime>
 #include <QLoggingCategory>
 #include <QOpenGLVersionFunctionsFactory>
+#include <QPainter>
 
 /**
  * @brief MainView::MainView
@@ -54,8 +56,12 @@ void MainView::initializeGL() {
           this->context());
 
   // initialize renderers here with the current context
-  meshRenderer.init(functions, &settings);
-  tessellationRenderer.init(functions, &settings);
+  vertexBuffers.init(functions);
+  settingsBuffer.init(functions);
+  meshRenderer.init(functions, &settings, &vertexBuffers);
+  tessellationRenderer.init(functions, &settings, &vertexBuffers);
+  pretessellatedRenderer.init(functions, &settings, &vertexBuffers);
+  frameProfiler.init(functions);
 
   updateMatrices();
 }
@@ -69,6 +75,7 @@ void MainView::resizeGL(int newWidth, int newHeight) {
   qDebug() << ".. resizeGL";
 
   settings.dispRatio = float(newWidth) / float(newHeight);
+  settings.viewportHeight = newHeight;
 
   settings.projectionMatrix.setToIdentity();
   settings.projectionMatrix.perspective(settings.FoV, settings.dispRatio, 0.1f,
@@ -94,27 +101,40 @@ void MainView::updateMatrices() {
 }
 
 /**
- * @brief MainView::updateBuffers Updates the buffers of the renderers.
+ * @brief MainView::updateBuffers Updates the buffers of the renderers. The
+ * attributes of the mesh should already be extracted, which is done by the
+ * MeshPipeline.
  * @param mesh The mesh used to update the buffer content with.
+ * @param bvh The hierarchy over the regular patches of the mesh, or a null
+ * pointer if its patches were not extracted.
  */
-void MainView::updateBuffers(Mesh &mesh) {
-  mesh.extractAttributes();
-  // Only extract/compute the following attributes when the corresponding mode
-  // is selected.
-  if (settings.currentTessellationShader == ShaderType::BICUBIC or
-      settings.currentTessellationShader == ShaderType::DISPLACEMENT) {
-    mesh.computeRegularPatchIndices();
-  }
-
+void MainView::updateBuffers(Mesh &mesh,
+                             const QSharedPointer<const PatchBVH> &bvh) {
+  ScopedStageTimer timer(&frameProfiler.preparationTimings(), "upload");
+  vertexBuffers.update(mesh);
   meshRenderer.updateBuffers(mesh);
-  tessellationRenderer.updateBuffers(mesh);
+  tessellationRenderer.updateBuffers(mesh, bvh);
+  pretessellatedRenderer.updateBuffers(mesh, bvh);
   update();
 }
 
 /**
- * @brief MainView::paintGL Draw call.
+ * @brief MainView::paintGL Draw call. While the frame statistics are shown or
+ * the level of detail is kept within a budget, the draw calls are profiled
+ * and new frames are requested continuously.
  */
 void MainView::paintGL() {
+  bool profiling = settings.showFrameStats || settings.lodBudget != NO_BUDGET;
+  if (profiling) {
+    frameProfiler.beginFrame(settings,
+                             tessellationRenderer.numPatches() +
+                                 tessellationRenderer.numIrregularPatches());
+  }
+
+  // The overlay is drawn with a QPainter, which changes the state.
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+
   glClearColor(0.0, 0.0, 0.0, 1.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -125,17 +145,110 @@ void MainView::paintGL() {
   }
 
   if (settings.modelLoaded) {
+    if (settings.uniformUpdateRequired) {
+      settingsBuffer.update(settings);
+    }
     if (settings.showCpuMesh) {
+      if (profiling) {
+        frameProfiler.beginStage(MESH_DRAW);
+      }
       meshRenderer.draw();
+      if (profiling) {
+        frameProfiler.endStage(MESH_DRAW);
+      }
     }
-    if (settings.tesselationMode) {
+    bool pretessellated =
+        settings.pretessellated &&
+        settings.currentTessellationShader == ShaderType::DISPLACEMENT;
+    if (settings.tesselationMode && pretessellated) {
+      // The capture reads the baked coefficients of the tessellation renderer.
+      // If it fails, the surface is tessellated every frame instead.
+      tessellationRenderer.updateCoefficientTexture();
+      pretessellated = pretessellatedRenderer.updateTessellation();
+    }
+    if (settings.tesselationMode && pretessellated) {
+      if (profiling) {
+        frameProfiler.beginStage(TESSELLATION_DRAW);
+      }
+      pretessellatedRenderer.draw();
+      if (profiling) {
+        frameProfiler.endStage(TESSELLATION_DRAW);
+        frameProfiler.setPretessellated(true);
+      }
+    } else if (settings.tesselationMode) {
+      if (profiling) {
+        frameProfiler.beginStage(TESSELLATION_DRAW);
+      }
       tessellationRenderer.draw();
+      if (profiling) {
+        frameProfiler.endStage(TESSELLATION_DRAW);
+        frameProfiler.setCulledPatches(tessellationRenderer.numFrustumCulled(),
+                                       tessellationRenderer.numBackFacing());
+      }
     }
 
     if (settings.uniformUpdateRequired) {
       settings.uniformUpdateRequired = false;
     }
   }
+
+  if (profiling) {
+    frameProfiler.endFrame();
+    // Applies to the next frame, so its statistics record the new settings.
+    FrameStats latest;
+    if (frameProfiler.latestFrame(latest)) {
+      if (lodController.update(latest, settings) &&
+          !settings.errorDrivenLoD) {
+        emit tessDetailChanged(settings.tessDetail);
+      }
+    }
+    if (settings.showFrameStats) {
+      drawFrameStats();
+    }
+    update();
+  }
+}
+
+/**
+ * @brief MainView::drawFrameStats Draws the frame statistics on top of the
+ * rendered frame.
+ */
+void MainView::drawFrameStats() {
+  QStringList lines = frameProfiler.overlayLines();
+  if (lines.isEmpty()) {
+    return;
+  }
+  if (settings.lodBudget == TRIANGLE_BUDGET) {
+    lines << QString("LoD budget: %1 triangles").arg(settings.triangleBudget);
+  } else if (settings.lodBudget == GPU_TIME_BUDGET) {
+    lines << QString("LoD budget: %1 ms GPU time").arg(settings.gpuTimeBudget);
+  }
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  QPainter painter(this);
+  painter.setPen(Qt::white);
+  painter.drawText(rect().adjusted(8, 8, -8, -8), Qt::AlignLeft | Qt::AlignTop,
+                   lines.join("\n"));
+}
+
+/**
+ * @brief MainView::toggleRecording Starts recording the frame statistics, or
+ * stops recording and writes them to a CSV file in the working directory.
+ * Recording shows the statistics, since they are only measured while shown.
+ */
+void MainView::toggleRecording() {
+  if (frameProfiler.isRecording()) {
+    QString fileName =
+        "frames-" +
+        QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".csv";
+    frameProfiler.stopRecording(fileName);
+  } else {
+    if (!settings.showFrameStats) {
+      settings.showFrameStats = true;
+      frameProfiler.reset();
+    }
+    frameProfiler.startRecording();
+  }
+  update();
 }
 
 /**
@@ -226,7 +339,14 @@ void MainView::wheelEvent(QWheelEvent *event) {
 
 /**
  * @brief MainView::keyPressEvent Handles keyboard shortcuts. Currently support
- * 'Z' for wireframe mode and 'R' to reset orientation.
+ * 'Z' for wireframe mode, 'R' to reset orientation, 'P' to show the frame
+ * statistics, 'C' to record them to a CSV file, 'B' to read the
+ * displacement coefficients from a baked texture, 'F' for frustum culling,
+ * 'K' for back-patch culling, 'E' for error-driven level of detail, '+' and
+ * '-' to change its pixel error, 'G' to cycle through the level of detail
+ * budgets, '[' and ']' to change the budget, 'T' to draw the displaced
+ * surface from vertices that are captured once, 'D' to change their density
+ * and 'V' to compare them to the Tessellator.
  * @param event Mouse event.
  */
 void MainView::keyPressEvent(QKeyEvent *event) {
@@ -241,6 +361,78 @@ void MainView::keyPressEvent(QKeyEvent *event) {
     updateMatrices();
     update();
     break;
+  case 'P':
+    settings.showFrameStats = !settings.showFrameStats;
+    frameProfiler.reset();
+    update();
+    break;
+  case 'C':
+    toggleRecording();
+    break;
+  case 'B':
+    settings.bakedDisplacement = !settings.bakedDisplacement;
+    settings.uniformUpdateRequired = true;
+    update();
+    break;
+  case 'F':
+    settings.frustumCulling = !settings.frustumCulling;
+    update();
+    break;
+  case 'K':
+    settings.backPatchCulling = !settings.backPatchCulling;
+    settings.uniformUpdateRequired = true;
+    update();
+    break;
+  case 'E':
+    settings.errorDrivenLoD = !settings.errorDrivenLoD;
+    settings.uniformUpdateRequired = true;
+    update();
+    break;
+  case '+':
+  case '-':
+    settings.pixelError *= event->key() == '+' ? 2.0f : 0.5f;
+    settings.pixelError =
+        qBound(MIN_PIXEL_ERROR, settings.pixelError, MAX_PIXEL_ERROR);
+    qDebug() << ":: Pixel error" << settings.pixelError;
+    settings.uniformUpdateRequired = true;
+    update();
+    break;
+  case 'T':
+    settings.pretessellated = !settings.pretessellated;
+    update();
+    break;
+  case 'D':
+    // Cycles through 1, 2, 4 and 8 samples per tile.
+    settings.tessDensity =
+        settings.tessDensity >= 8 ? 1 : 2 * settings.tessDensity;
+    qDebug() << ":: Tessellation density" << settings.tessDensity;
+    update();
+    break;
+  case 'V': {
+    // Prints the result.
+    CaptureComparison comparison;
+    makeCurrent();
+    pretessellatedRenderer.compareWithTessellator(comparison);
+    doneCurrent();
+    break;
+  }
+  case 'G':
+    settings.lodBudget = (settings.lodBudget + 1) % NUM_LOD_BUDGETS;
+    update();
+    break;
+  case '[':
+  case ']':
+    if (event->key() == ']') {
+      settings.triangleBudget *= 2;
+      settings.gpuTimeBudget *= 2.0f;
+    } else {
+      settings.triangleBudget = qMax(settings.triangleBudget / 2, qint64(1000));
+      settings.gpuTimeBudget = qMax(settings.gpuTimeBudget / 2.0f, 0.25f);
+    }
+    qDebug() << ":: LoD budget" << settings.triangleBudget << "triangles,"
+             << settings.gpuTimeBudget << "ms";
+    update();
+    break;
   }
 }
 
@@ -8,8 +8,13 @@
 #include <QOpenGLWidget>
 
 #include "mesh/mesh.h"
+#include "renderers/frameprofiler.h"
+#include "renderers/lodcontroller.h"
 #include "renderers/meshrenderer.h"
+#include "renderers/pretessrenderer.h"
+#include "renderers/settingsbuffer.h"
 #include "renderers/tessrenderer.h"
+#include "renderers/vertexbuffers.h"
 
 /**
  * @brief The MainView class represents the main view of the UI. It handles and
@@ -24,7 +29,8 @@ public:
 
   void updateMatrices();
   void updateUniforms();
-  void updateBuffers(Mesh &currentMesh);
+  void updateBuffers(Mesh &currentMesh,
+                     const QSharedPointer<const PatchBVH> &bvh);
 
 protected:
   void initializeGL() override;
@@ -38,6 +44,8 @@ protected:
 
 private:
   QVector2D toNormalizedScreenCoordinates(float x, float y);
+  void drawFrameStats();
+  void toggleRecording();
 
   QOpenGLDebugLogger debugLogger;
 
@@ -47,13 +55,21 @@ private:
   QQuaternion rotationQuaternion;
   bool dragging;
 
+  VertexBuffers vertexBuffers;
+  SettingsBuffer settingsBuffer;
   MeshRenderer meshRenderer;
   TessellationRenderer tessellationRenderer;
+  PretessellatedRenderer pretessellatedRenderer;
+  FrameProfiler frameProfiler;
+  LoDController lodController;
 
   Settings settings;
 
   // we make mainwindow a friend so it can access settings
   friend class MainWindow;
+signals:
+  // Emitted when the LoDController changed the tessellation detail.
+  void tessDetailChanged(float tessDetail);
 private slots:
   void onMessageLogged(QOpenGLDebugMessage Message);
 };
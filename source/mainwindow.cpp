@@ -1,9 +1,11 @@
 #include "mainwindow.h"
 
+#include <QElapsedTimer>
+#include <QSignalBlocker>
+
+#include "initialization/meshcache.h"
 #include "initialization/meshinitializer.h"
 #include "initialization/objfile.h"
-#include "subdivision/catmullclarksubdivider.h"
-#include "subdivision/subdivider.h"
 #include "ui_mainwindow.h"
 
 /**
@@ -24,33 +26,60 @@ MainWindow::MainWindow(QWidget *parent)
       ui->MainDisplay->settings.tesselationMode &&
       ui->MainDisplay->settings.currentTessellationShader ==
           ShaderType::DISPLACEMENT);
+  connect(&meshWatcher, &QFutureWatcher<PreparedMesh>::finished, this,
+          &MainWindow::showPreparedMesh);
+  connect(ui->MainDisplay, &MainView::tessDetailChanged, this,
+          &MainWindow::showTessDetail);
+  meshPipeline.setStageTimings(
+      &ui->MainDisplay->frameProfiler.preparationTimings());
+  // Reloading a model whose topology did not change, e.g. the next frame of
+  // an animation, only moves the vertices of the cached levels.
+  meshPipeline.setStencilMode(true);
 }
 
 /**
  * @brief MainWindow::~MainWindow Deconstructs the main window.
  */
 MainWindow::~MainWindow() {
+  meshPipeline.cancel();
+  meshPipeline.waitForFinished();
   delete ui;
 
-  meshes.clear();
-  meshes.squeeze();
+  currentMesh.clear();
 }
 
 /**
- * @brief MainWindow::importOBJ Imports an obj file and adds the constructed
- * half-edge to the collection of meshes.
+ * @brief MainWindow::importOBJ Imports an obj file and uses the constructed
+ * half-edge mesh as the control mesh of the mesh pipeline.
  * @param fileName Path of the .obj file.
  */
 void MainWindow::importOBJ(const QString &fileName) {
-  OBJFile newModel = OBJFile(fileName);
-  meshes.clear();
-  meshes.squeeze();
-
-  if (newModel.loadedSuccessfully()) {
-    MeshInitializer meshInitializer;
-    meshes.append(meshInitializer.constructHalfEdgeMesh(newModel));
-    ui->MainDisplay->updateBuffers(meshes[0]);
-    currentMesh = &meshes[0];
+  QSharedPointer<Mesh> controlMesh = QSharedPointer<Mesh>::create();
+
+  QElapsedTimer timer;
+  timer.start();
+  // Try the binary cache first, which skips parsing and mesh construction.
+  MeshCache meshCache;
+  bool loaded = meshCache.load(fileName, *controlMesh);
+  if (loaded) {
+    qDebug() << ":: Loaded" << controlMesh->numFaces() << "faces from cache in"
+             << timer.elapsed() << "ms";
+  } else {
+    OBJFile newModel = OBJFile(fileName);
+    qint64 loadTime = timer.restart();
+    loaded = newModel.loadedSuccessfully();
+    if (loaded) {
+      MeshInitializer meshInitializer;
+      *controlMesh = meshInitializer.constructHalfEdgeMesh(newModel);
+      qDebug() << ":: Loaded" << controlMesh->numFaces() << "faces in"
+               << loadTime << "ms, constructed half-edge mesh in"
+               << timer.elapsed() << "ms";
+      meshCache.store(fileName, *controlMesh);
+    }
+  }
+
+  if (loaded) {
+    meshPipeline.setControlMesh(controlMesh);
     ui->MainDisplay->settings.modelLoaded = true;
   } else {
     ui->MainDisplay->settings.modelLoaded = false;
@@ -66,10 +95,44 @@ void MainWindow::importOBJ(const QString &fileName) {
       ui->MainDisplay->settings.currentTessellationShader ==
           ShaderType::DISPLACEMENT);
 
-  ui->SubdivSteps->setValue(0);
+  // Changing the value requests the new mesh, otherwise request it here.
+  if (ui->SubdivSteps->value() != 0) {
+    ui->SubdivSteps->setValue(0);
+  } else if (loaded) {
+    requestMesh();
+  }
   ui->MainDisplay->update();
 }
 
+/**
+ * @brief MainWindow::requestMesh Requests the mesh for the current settings
+ * from the mesh pipeline. The current mesh keeps being rendered until the new
+ * mesh is prepared, after which showPreparedMesh swaps them. Results of
+ * earlier requests are discarded.
+ */
+void MainWindow::requestMesh() {
+  const Settings &settings = ui->MainDisplay->settings;
+  // Only compute the regular patches when the corresponding mode is selected.
+  bool regularPatches =
+      settings.currentTessellationShader == ShaderType::BICUBIC or
+      settings.currentTessellationShader == ShaderType::DISPLACEMENT;
+  meshWatcher.setFuture(meshPipeline.prepare(
+      settings.subdivSteps, settings.adaptiveSubdivision, regularPatches));
+}
+
+/**
+ * @brief MainWindow::showPreparedMesh Replaces the current mesh by the mesh
+ * that the pipeline just prepared and uploads its buffers.
+ */
+void MainWindow::showPreparedMesh() {
+  if (meshWatcher.isCanceled() || meshWatcher.future().resultCount() == 0) {
+    return;
+  }
+  PreparedMesh prepared = meshWatcher.result();
+  currentMesh = prepared.mesh;
+  ui->MainDisplay->updateBuffers(*currentMesh, prepared.bvh);
+}
+
 void MainWindow::on_LoadOBJ_pressed() {
   QString filename = QFileDialog::getOpenFileName(
       this, "Import OBJ File", "../", tr("Obj Files (*.obj)"));
@@ -83,13 +146,12 @@ void MainWindow::on_MeshPresetComboBox_currentTextChanged(
 
 void MainWindow::on_SubdivSteps_valueChanged(int value) {
   ui->MainDisplay->settings.subdivSteps = value;
-  Subdivider *subdivider = new CatmullClarkSubdivider();
-  for (int k = meshes.size() - 1; k < value; k++) {
-    meshes.append(subdivider->subdivide(meshes[k]));
-  }
-  ui->MainDisplay->updateBuffers(meshes[value]);
-  currentMesh = &meshes[value];
-  delete subdivider;
+  requestMesh();
+}
+
+void MainWindow::on_AdaptiveCheckBox_toggled(bool checked) {
+  ui->MainDisplay->settings.adaptiveSubdivision = checked;
+  requestMesh();
 }
 
 void MainWindow::on_TessellationCheckBox_toggled(bool checked) {
@@ -135,7 +197,7 @@ void MainWindow::on_bicubicButton_clicked() {
   ui->DynamicTessGroupBox->setEnabled(false);
 
   ui->MainDisplay->settings.uniformUpdateRequired = true;
-  ui->MainDisplay->updateBuffers(*currentMesh);
+  requestMesh();
 }
 
 void MainWindow::on_displacementButton_clicked() {
@@ -147,7 +209,7 @@ void MainWindow::on_displacementButton_clicked() {
   ui->DynamicTessGroupBox->setEnabled(true);
 
   ui->MainDisplay->settings.uniformUpdateRequired = true;
-  ui->MainDisplay->updateBuffers(*currentMesh);
+  requestMesh();
 }
 
 void MainWindow::on_TileSizeLevel_valueChanged(int arg1) {
@@ -168,6 +230,17 @@ void MainWindow::on_detailSlider_valueChanged(int value) {
   ui->MainDisplay->update();
 }
 
+/**
+ * @brief MainWindow::showTessDetail Moves the detail slider to the
+ * tessellation detail chosen by the LoDController. The slider does not write
+ * the rounded value back to the settings.
+ * @param tessDetail The tessellation detail.
+ */
+void MainWindow::showTessDetail(float tessDetail) {
+  QSignalBlocker blocker(ui->detailSlider);
+  ui->detailSlider->setValue(qRound(tessDetail));
+}
+
 void MainWindow::on_amplitudeSlider_valueChanged(int value) {
   ui->MainDisplay->settings.amplitude = static_cast<float>(value) / 50;
   ui->MainDisplay->settings.uniformUpdateRequired = true;
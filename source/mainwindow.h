@@ -2,10 +2,12 @@
 #define MAINWINDOW_H
 
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QMainWindow>
+#include <QSharedPointer>
 
 #include "mesh/mesh.h"
-#include "subdivision/subdivider.h"
+#include "meshpipeline.h"
 
 namespace Ui {
 class MainWindow;
@@ -25,6 +27,7 @@ private slots:
   void on_LoadOBJ_pressed();
   void on_MeshPresetComboBox_currentTextChanged(const QString &meshName);
   void on_SubdivSteps_valueChanged(int subdivLevel);
+  void on_AdaptiveCheckBox_toggled(bool checked);
   void on_TessellationCheckBox_toggled(bool checked);
 
   void on_HideMeshCheckBox_toggled(bool checked);
@@ -53,13 +56,17 @@ private slots:
   void on_approx_norms_clicked();
   void on_interpolated_norms_clicked();
 
+  void showPreparedMesh();
+  void showTessDetail(float tessDetail);
+
 private:
   void importOBJ(const QString &fileName);
+  void requestMesh();
 
   Ui::MainWindow *ui;
-  Subdivider *subdivider;
-  QVector<Mesh> meshes;
-  Mesh *currentMesh;
+  MeshPipeline meshPipeline;
+  QFutureWatcher<PreparedMesh> meshWatcher;
+  QSharedPointer<Mesh> currentMesh;
 };
 
 #endif // MAINWINDOW_H
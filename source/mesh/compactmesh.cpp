@@ -0,0 +1,343 @@
+#include "compactmesh.h"
+
+#include <math.h>
+
+#include <QDebug>
+
+#include "util/util.h"
+
+/**
+ * @brief CompactMesh::CompactMesh Initializes an empty mesh.
+ */
+CompactMesh::CompactMesh() : edgeCount(0) {}
+
+/**
+ * @brief CompactMesh::CompactMesh Converts a pointer-based half-edge mesh to
+ * its compact representation. The half-edges are renumbered such that the
+ * half-edges of every face are consecutive, starting at the half-edge with the
+ * lowest index in that face. For meshes created by the MeshInitializer or the
+ * CatmullClarkSubdivider this leaves all indices unchanged.
+ * @param mesh The mesh to convert.
+ */
+CompactMesh::CompactMesh(Mesh &mesh) : edgeCount(mesh.numEdges()) {
+  QVector<Vertex> &vertices = mesh.getVertices();
+  QVector<HalfEdge> &halfEdges = mesh.getHalfEdges();
+  QVector<Face> &faces = mesh.getFaces();
+
+  bool quadMesh = true;
+  for (int f = 0; f < faces.size(); f++) {
+    if (faces[f].valence != 4) {
+      quadMesh = false;
+      break;
+    }
+  }
+  if (!quadMesh) {
+    faceOffsets.resize(faces.size() + 1);
+    halfEdgeFace.resize(halfEdges.size());
+  }
+
+  QVector<int> newIndices(halfEdges.size());
+  int h = 0;
+  for (int f = 0; f < faces.size(); f++) {
+    HalfEdge *first = faces[f].side;
+    HalfEdge *currentEdge = first->next;
+    for (int m = 1; m < faces[f].valence; m++) {
+      if (currentEdge->index < first->index) {
+        first = currentEdge;
+      }
+      currentEdge = currentEdge->next;
+    }
+
+    if (!quadMesh) {
+      faceOffsets[f] = h;
+    }
+    currentEdge = first;
+    for (int m = 0; m < faces[f].valence; m++) {
+      newIndices[currentEdge->index] = h;
+      if (!quadMesh) {
+        halfEdgeFace[h] = f;
+      }
+      currentEdge = currentEdge->next;
+      h++;
+    }
+  }
+  if (!quadMesh) {
+    faceOffsets[faces.size()] = h;
+  }
+
+  halfEdgeOrigin.resize(halfEdges.size());
+  halfEdgeTwin.resize(halfEdges.size());
+  halfEdgeEdge.resize(halfEdges.size());
+  for (int e = 0; e < halfEdges.size(); e++) {
+    const HalfEdge &halfEdge = halfEdges[e];
+    int newIdx = newIndices[e];
+    halfEdgeOrigin[newIdx] = halfEdge.origin->index;
+    halfEdgeTwin[newIdx] =
+        halfEdge.twin == nullptr ? -1 : newIndices[halfEdge.twin->index];
+    halfEdgeEdge[newIdx] = halfEdge.edgeIndex;
+  }
+
+  vertexCoords.resize(vertices.size());
+  vertexOut.resize(vertices.size());
+  vertexValence.resize(vertices.size());
+  for (int v = 0; v < vertices.size(); v++) {
+    vertexCoords[v] = vertices[v].coords;
+    vertexOut[v] =
+        vertices[v].out == nullptr ? -1 : newIndices[vertices[v].out->index];
+    vertexValence[v] = vertices[v].valence;
+  }
+}
+
+/**
+ * @brief CompactMesh::isBoundaryVertex Determines whether a vertex lies on a
+ * boundary or not.
+ * @param v Index of the vertex.
+ * @return True if the vertex lies on a boundary; false otherwise, including
+ * isolated vertices, which have no out-going half-edge.
+ */
+bool CompactMesh::isBoundaryVertex(int v) const {
+  int h = vertexOut[v];
+  if (h < 0) {
+    return false;
+  }
+  if (halfEdgeTwin[h] < 0) {
+    return true;
+  }
+  int hNext = next(halfEdgeTwin[h]);
+  while (hNext != h) {
+    if (halfEdgeTwin[hNext] < 0) {
+      return true;
+    }
+    hNext = next(halfEdgeTwin[hNext]);
+  }
+  return false;
+}
+
+/**
+ * @brief CompactMesh::nextBoundaryHalfEdge Retrieves the boundary half-edge
+ * that originates from the provided boundary vertex by following the
+ * twin->next loop. Only works if the vertex is a boundary vertex.
+ * @param v Index of the vertex.
+ * @return Index of a boundary half-edge that originates from the vertex.
+ */
+int CompactMesh::nextBoundaryHalfEdge(int v) const {
+  int h = vertexOut[v];
+  while (halfEdgeTwin[h] >= 0) {
+    h = next(halfEdgeTwin[h]);
+  }
+  return h;
+}
+
+/**
+ * @brief CompactMesh::prevBoundaryHalfEdge Retrieves the boundary half-edge
+ * that points to the provided boundary vertex by following the prev->twin
+ * loop. Only works if the vertex is a boundary vertex.
+ * @param v Index of the vertex.
+ * @return Index of a boundary half-edge that points to the vertex.
+ */
+int CompactMesh::prevBoundaryHalfEdge(int v) const {
+  int h = prev(vertexOut[v]);
+  while (halfEdgeTwin[h] >= 0) {
+    h = prev(halfEdgeTwin[h]);
+  }
+  return h;
+}
+
+/**
+ * @brief CompactMesh::computeFaceNormal Computes the normal of a face. Note
+ * that this will not give the most accurate normal for non-planar faces.
+ * @param f Index of the face.
+ * @return The normal of the face.
+ */
+QVector3D CompactMesh::computeFaceNormal(int f) const {
+  int h = side(f);
+  QVector3D pPrev = vertexCoords[halfEdgeOrigin[prev(h)]];
+  QVector3D pCur = vertexCoords[halfEdgeOrigin[h]];
+  QVector3D pNext = vertexCoords[halfEdgeOrigin[next(h)]];
+
+  QVector3D edgeA = pPrev - pCur;
+  QVector3D edgeB = pNext - pCur;
+
+  QVector3D faceNormal = QVector3D::crossProduct(edgeB, edgeA);
+  // don't use normalized, since this presents issues with small numbers
+  return faceNormal / faceNormal.length();
+}
+
+/**
+ * @brief CompactMesh::recalculateNormals Recalculates the face and vertex
+ * normals.
+ */
+void CompactMesh::recalculateNormals() {
+  faceNormals.resize(numFaces());
+  for (int f = 0; f < numFaces(); f++) {
+    faceNormals[f] = computeFaceNormal(f);
+  }
+
+  vertexNormals.clear();
+  vertexNormals.fill({0, 0, 0}, numVerts());
+
+  // normal computation
+  for (int h = 0; h < numHalfEdges(); ++h) {
+    QVector3D pPrev = vertexCoords[halfEdgeOrigin[prev(h)]];
+    QVector3D pCur = vertexCoords[halfEdgeOrigin[h]];
+    QVector3D pNext = vertexCoords[halfEdgeOrigin[next(h)]];
+
+    QVector3D edgeA = (pPrev - pCur);
+    QVector3D edgeB = (pNext - pCur);
+
+    float edgeLengths = edgeA.length() * edgeB.length();
+    float edgeDot = QVector3D::dotProduct(edgeA, edgeB) / edgeLengths;
+    float angle = sqrt(1 - edgeDot * edgeDot);
+
+    vertexNormals[halfEdgeOrigin[h]] +=
+        (angle * faceNormals[face(h)]) / edgeLengths;
+  }
+
+  for (int v = 0; v < numVerts(); ++v) {
+    // Vertices without faces, such as the vertices that the AdaptiveSubdivider
+    // only keeps for the patches, keep a zero normal.
+    float length = vertexNormals[v].length();
+    if (length > 0.0f) {
+      vertexNormals[v] /= length;
+    }
+  }
+}
+
+/**
+ * @brief CompactMesh::computeRegularPatchIndices Computes the indices for
+ * regular quad grid patches. The resulting indices are stored in
+ * regularPatchIndices. Faces touching a boundary are never regular.
+ */
+void CompactMesh::computeRegularPatchIndices() {
+  regularPatchIndices.clear();
+
+  unsigned int newRegularPatchIndices[16];
+
+  // Maps vertex indices to 4x4 row-major ordering.
+  const int map[16] = {1,  5,  4,  0,  7, 6, 2,  3,
+                       14, 10, 11, 15, 8, 9, 13, 12};
+
+  for (int f = 0; f < numFaces(); f++) {
+    if (faceValence(f) != 4) {
+      continue;
+    }
+
+    bool isRegularPatch = true;
+    int currentEdge = side(f);
+    // Check the valence of the connected faces
+    // and vertices of the central face.
+    for (int m = 0; m < 4; m++) {
+      int twinEdge = halfEdgeTwin[currentEdge];
+      if (vertexValence[halfEdgeOrigin[currentEdge]] != 4 || twinEdge < 0 ||
+          faceValence(face(twinEdge)) != 4 ||
+          halfEdgeTwin[next(twinEdge)] < 0 ||
+          faceValence(face(halfEdgeTwin[next(twinEdge)])) != 4) {
+        isRegularPatch = false;
+        break;
+      }
+      currentEdge = next(currentEdge);
+    }
+
+    if (isRegularPatch) {
+      int currentInnerEdge = side(f);
+      // For rotating around inner quad
+      for (int m = 0; m < 4; m++) {
+        int currentOuterEdge =
+            halfEdgeTwin[next(halfEdgeTwin[currentInnerEdge])];
+        // For rotating around outer corner quad
+        for (int n = 0; n < 4; n++) {
+          newRegularPatchIndices[map[m * 4 + n]] =
+              halfEdgeOrigin[currentOuterEdge];
+          currentOuterEdge = next(currentOuterEdge);
+        }
+        currentInnerEdge = next(currentInnerEdge);
+      }
+      for (int i = 0; i < 16; i++) {
+        regularPatchIndices.append(newRegularPatchIndices[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief CompactMesh::extractAttributes Extracts the normals and indices into
+ * easy-to-access buffers. The vertex coordinates are stored in a buffer
+ * already.
+ */
+void CompactMesh::extractAttributes() {
+  recalculateNormals();
+
+  polyIndices.clear();
+  polyIndices.reserve(numHalfEdges() + numFaces());
+  for (int f = 0; f < numFaces(); f++) {
+    int currentEdge = side(f);
+    for (int m = 0; m < faceValence(f); m++) {
+      polyIndices.append(halfEdgeOrigin[currentEdge]);
+      currentEdge = next(currentEdge);
+    }
+    // append MAX_INT to signify end of face
+    polyIndices.append(INT_MAX);
+  }
+
+  quadIndices.clear();
+  quadIndices.reserve(numHalfEdges());
+  for (int f = 0; f < numFaces(); f++) {
+    if (faceValence(f) == 4) {
+      int currentEdge = side(f);
+      for (int m = 0; m < 4; m++) {
+        quadIndices.append(halfEdgeOrigin[currentEdge]);
+        currentEdge = next(currentEdge);
+      }
+    }
+  }
+  quadIndices.squeeze();
+}
+
+/**
+ * @brief CompactMesh::numVerts Retrieves the number of vertices.
+ * @return The number of vertices.
+ */
+int CompactMesh::numVerts() const { return vertexCoords.size(); }
+
+/**
+ * @brief CompactMesh::numHalfEdges Retrieves the number of half-edges.
+ * @return The number of half-edges.
+ */
+int CompactMesh::numHalfEdges() const { return halfEdgeOrigin.size(); }
+
+/**
+ * @brief CompactMesh::numFaces Retrieves the number of faces.
+ * @return The number of faces.
+ */
+int CompactMesh::numFaces() const {
+  return faceOffsets.isEmpty() ? halfEdgeOrigin.size() / 4
+                               : faceOffsets.size() - 1;
+}
+
+/**
+ * @brief CompactMesh::numEdges Retrieves the number of edges.
+ * @return The number of edges.
+ */
+int CompactMesh::numEdges() const { return edgeCount; }
+
+/**
+ * @brief CompactMesh::isQuadMesh Checks whether all faces of this mesh are
+ * quads, in which case no face data is stored.
+ * @return True if all faces are quads; false otherwise.
+ */
+bool CompactMesh::isQuadMesh() const { return faceOffsets.isEmpty(); }
+
+/**
+ * @brief CompactMesh::memoryUsage Computes the amount of memory allocated by
+ * this mesh, including the attribute buffers.
+ * @return The number of allocated bytes.
+ */
+qint64 CompactMesh::memoryUsage() const {
+  return vectorMemory(vertexCoords) + vectorMemory(vertexOut) +
+         vectorMemory(vertexValence) + vectorMemory(halfEdgeOrigin) +
+         vectorMemory(halfEdgeTwin) + vectorMemory(halfEdgeEdge) +
+         vectorMemory(faceOffsets) + vectorMemory(halfEdgeFace) +
+         vectorMemory(faceNormals) + vectorMemory(vertexNormals) +
+         vectorMemory(polyIndices) + vectorMemory(quadIndices) +
+         vectorMemory(regularPatchIndices);
+}
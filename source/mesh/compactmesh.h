@@ -0,0 +1,108 @@
+#ifndef COMPACT_MESH_H
+#define COMPACT_MESH_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh.h"
+
+/**
+ * @brief The CompactMesh class is an index-based representation of a
+ * half-edge mesh. All data is stored in separate arrays of 32-bit indices
+ * (structure of arrays) instead of objects linked by pointers. The half-edges
+ * of every face are stored contiguously, so next, prev and face are not stored
+ * per half-edge. For quad meshes (e.g. every mesh after a subdivision step),
+ * the half-edges of face f are 4f, 4f+1, 4f+2 and 4f+3, so no face data is
+ * stored at all.
+ */
+class CompactMesh {
+ public:
+  CompactMesh();
+  CompactMesh(Mesh& mesh);
+
+  inline QVector<QVector3D>& getVertexCoords() { return vertexCoords; }
+  inline QVector<QVector3D>& getVertexNorms() { return vertexNormals; }
+
+  inline QVector<unsigned int>& getPolyIndices() { return polyIndices; }
+  inline QVector<unsigned int>& getQuadIndices() { return quadIndices; }
+  inline QVector<unsigned int>& getRegularPatchIndices() {
+    return regularPatchIndices;
+  }
+
+  void extractAttributes();
+  void recalculateNormals();
+  void computeRegularPatchIndices();
+
+  int numVerts() const;
+  int numHalfEdges() const;
+  int numFaces() const;
+  int numEdges() const;
+  bool isQuadMesh() const;
+  qint64 memoryUsage() const;
+
+  inline int origin(int h) const { return halfEdgeOrigin[h]; }
+  inline int twin(int h) const { return halfEdgeTwin[h]; }
+  inline int edge(int h) const { return halfEdgeEdge[h]; }
+  inline int face(int h) const {
+    return faceOffsets.isEmpty() ? h / 4 : halfEdgeFace[h];
+  }
+  inline int next(int h) const {
+    if (faceOffsets.isEmpty()) {
+      return h % 4 == 3 ? h - 3 : h + 1;
+    }
+    int f = halfEdgeFace[h];
+    return h + 1 == faceOffsets[f + 1] ? faceOffsets[f] : h + 1;
+  }
+  inline int prev(int h) const {
+    if (faceOffsets.isEmpty()) {
+      return h % 4 == 0 ? h + 3 : h - 1;
+    }
+    int f = halfEdgeFace[h];
+    return h == faceOffsets[f] ? faceOffsets[f + 1] - 1 : h - 1;
+  }
+  inline int side(int f) const {
+    return faceOffsets.isEmpty() ? 4 * f : faceOffsets[f];
+  }
+  inline int faceValence(int f) const {
+    return faceOffsets.isEmpty() ? 4 : faceOffsets[f + 1] - faceOffsets[f];
+  }
+  inline int out(int v) const { return vertexOut[v]; }
+  inline int valence(int v) const { return vertexValence[v]; }
+
+  bool isBoundaryVertex(int v) const;
+  int nextBoundaryHalfEdge(int v) const;
+  int prevBoundaryHalfEdge(int v) const;
+
+ private:
+  QVector3D computeFaceNormal(int f) const;
+
+  // Vertex data. The coordinates double as the vertex attribute buffer.
+  QVector<QVector3D> vertexCoords;
+  QVector<int> vertexOut;
+  QVector<int> vertexValence;
+
+  // Half-edge data. Twin is -1 for boundary half-edges.
+  QVector<int> halfEdgeOrigin;
+  QVector<int> halfEdgeTwin;
+  QVector<int> halfEdgeEdge;
+
+  // Face data. Both are empty for quad meshes. Otherwise, the half-edges of
+  // face f are faceOffsets[f] up to (excluding) faceOffsets[f + 1].
+  QVector<int> faceOffsets;
+  QVector<int> halfEdgeFace;
+
+  QVector<QVector3D> faceNormals;
+  QVector<QVector3D> vertexNormals;
+
+  QVector<unsigned int> polyIndices;
+  // for quad tessellation
+  QVector<unsigned int> quadIndices;
+  // for cubic B-splines tessellation
+  QVector<unsigned int> regularPatchIndices;
+
+  int edgeCount;
+
+  friend class CatmullClarkSubdivider;
+};
+
+#endif  // COMPACT_MESH_H
@@ -52,6 +52,62 @@ QVector3D Face::computeNormal() const {
   return faceNormal / faceNormal.length();
 }
 
+/**
+ * @brief Face::isRegular Determines whether this face and its one-ring of
+ * faces form a regular quad grid. In that case, the face corresponds to a
+ * bicubic B-spline patch.
+ * @return True if this face is a quad, all its vertices are interior vertices
+ * of valence 4 and all surrounding faces are quads; false otherwise.
+ */
+bool Face::isRegular() const {
+  if (valence != 4) {
+    return false;
+  }
+  HalfEdge *currentEdge = side;
+  // Check the valence of the connected faces and vertices of the central face.
+  for (int m = 0; m < valence; m++) {
+    HalfEdge *twinEdge = currentEdge->twin;
+    if (currentEdge->origin->valence != 4 ||
+        currentEdge->origin->isBoundaryVertex() || twinEdge == nullptr ||
+        twinEdge->face->valence != 4 || twinEdge->next->twin == nullptr ||
+        twinEdge->next->twin->face->valence != 4) {
+      return false;
+    }
+    currentEdge = currentEdge->next;
+  }
+  return true;
+}
+
+/**
+ * @brief Face::appendPatchIndices Appends the indices of the 16 control points
+ * of the bicubic B-spline patch of this face in 4x4 row-major ordering. Should
+ * only be called on regular faces.
+ * @param indices The vector the indices are appended to.
+ * @param offset Offset added to every vertex index.
+ */
+void Face::appendPatchIndices(QVector<unsigned int> &indices,
+                              unsigned int offset) const {
+  // Maps vertex indices to 4x4 row-major ordering.
+  static const unsigned int map[16] = {1,  5,  4,  0,  7, 6, 2,  3,
+                                       14, 10, 11, 15, 8, 9, 13, 12};
+  int start = indices.size();
+  indices.resize(start + 16);
+  unsigned int *patchIndices = indices.data() + start;
+
+  HalfEdge *currentInnerEdge = side;
+  // For rotating around inner quad
+  for (int m = 0; m < valence; m++) {
+    HalfEdge *currentOuterEdge = currentInnerEdge->twin->next->twin;
+    // For rotating around outer corner quad
+    for (int n = 0; n < valence; n++) {
+      patchIndices[map[m * valence + n]] =
+          offset + currentOuterEdge->origin->index;
+      currentOuterEdge = currentOuterEdge->next;
+    }
+    currentInnerEdge = currentInnerEdge->next;
+  }
+}
+
 /**
  * @brief Face::debugInfo Prints some debug info of this face.
  */
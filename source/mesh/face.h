@@ -2,6 +2,7 @@
 #define FACE
 
 #include <QVector3D>
+#include <QVector>
 
 // Forward declaration
 class HalfEdge;
@@ -15,6 +16,9 @@ class Face {
   Face(HalfEdge* side, int valence, int index);
   void recalculateNormal();
   QVector3D computeNormal() const;
+  bool isRegular() const;
+  void appendPatchIndices(QVector<unsigned int>& indices,
+                          unsigned int offset = 0) const;
   void debugInfo() const;
 
   HalfEdge* side;
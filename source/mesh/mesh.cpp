@@ -5,10 +5,12 @@
 
 #include <QDebug>
 
+#include "util/util.h"
+
 /**
  * @brief Mesh::Mesh Initializes an empty mesh.
  */
-Mesh::Mesh() {}
+Mesh::Mesh() : adaptive(false) {}
 
 /**
  * @brief Mesh::~Mesh Deconstructor. Clears all the data of the half-edge data.
@@ -52,59 +54,260 @@ void Mesh::recalculateNormals() {
   }
 
   for (int v = 0; v < numVerts(); ++v) {
-    vertexNormals[v] /= vertexNormals[v].length();
+    // Vertices without faces, such as the vertices that the AdaptiveSubdivider
+    // only keeps for the patches, keep a zero normal.
+    float length = vertexNormals[v].length();
+    if (length > 0.0f) {
+      vertexNormals[v] /= length;
+    }
   }
 }
 
+/**
+ * @brief Mesh::setVertexPositions Moves the vertices without changing the
+ * topology. The attributes have to be extracted again afterwards.
+ * @param coords The new coordinates of every vertex.
+ */
+void Mesh::setVertexPositions(const QVector<QVector3D> &coords) {
+  for (int v = 0; v < vertices.size(); v++) {
+    vertices[v].coords = coords[v];
+  }
+}
+
+/**
+ * @brief Mesh::detachedCopy Creates a copy of this mesh with its own half-edge
+ * data. A plain copy shares the vectors of this mesh, and its pointers keep
+ * pointing into them once the copy detaches. The pointers of this copy point
+ * into its own vectors instead, so this mesh is not modified and can still be
+ * read while the copy is.
+ * @return The copy, including the extracted attributes.
+ */
+QSharedPointer<Mesh> Mesh::detachedCopy() const {
+  auto mesh = QSharedPointer<Mesh>::create(*this);
+  mesh->vertices = QVector<Vertex>(vertices.constBegin(), vertices.constEnd());
+  mesh->faces = QVector<Face>(faces.constBegin(), faces.constEnd());
+  mesh->halfEdges =
+      QVector<HalfEdge>(halfEdges.constBegin(), halfEdges.constEnd());
+
+  // The copied pointers still point into the vectors of this mesh.
+  for (Vertex &vertex : mesh->vertices) {
+    if (vertex.out != nullptr) {
+      vertex.out = &mesh->halfEdges[vertex.out->index];
+    }
+  }
+  for (Face &face : mesh->faces) {
+    face.side = &mesh->halfEdges[face.side->index];
+  }
+  for (HalfEdge &halfEdge : mesh->halfEdges) {
+    halfEdge.origin = &mesh->vertices[halfEdge.origin->index];
+    halfEdge.next = &mesh->halfEdges[halfEdge.next->index];
+    halfEdge.prev = &mesh->halfEdges[halfEdge.prev->index];
+    if (halfEdge.twin != nullptr) {
+      halfEdge.twin = &mesh->halfEdges[halfEdge.twin->index];
+    }
+    halfEdge.face = &mesh->faces[halfEdge.face->index];
+  }
+  return mesh;
+}
+
+/**
+ * @brief Mesh::movedCopy Creates a copy of this mesh with moved vertices, see
+ * detachedCopy(). The attributes of the copy have to be extracted again.
+ * @param coords The new coordinates of every vertex.
+ * @return The copy.
+ */
+QSharedPointer<Mesh> Mesh::movedCopy(const QVector<QVector3D> &coords) const {
+  QSharedPointer<Mesh> mesh = detachedCopy();
+  mesh->setVertexPositions(coords);
+  return mesh;
+}
+
+/**
+ * @brief Mesh::hasSameTopology Determines whether another mesh has the same
+ * connectivity, including the numbering of its vertices, half-edges and faces.
+ * Such meshes only differ in their vertex positions.
+ * @param other The other mesh.
+ * @return True if the topology is identical; false otherwise.
+ */
+bool Mesh::hasSameTopology(Mesh &other) {
+  if (numVerts() != other.numVerts() || numFaces() != other.numFaces() ||
+      numHalfEdges() != other.numHalfEdges()) {
+    return false;
+  }
+  for (int h = 0; h < halfEdges.size(); h++) {
+    const HalfEdge &edge = halfEdges[h];
+    const HalfEdge &otherEdge = other.halfEdges[h];
+    if (edge.origin->index != otherEdge.origin->index ||
+        edge.nextIdx() != otherEdge.nextIdx() ||
+        edge.twinIdx() != otherEdge.twinIdx() ||
+        edge.faceIdx() != otherEdge.faceIdx()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 /**
  * @brief Mesh::computeRegularPatchIndices Computes the indices for regular quad
- * grid patches. The resulting indices are stored in regularPatchIndices.
+ * grid patches. The resulting indices are stored in regularPatchIndices. Meshes
+ * created by the AdaptiveSubdivider already contain their patches, so those
+ * are left untouched.
  */
 void Mesh::computeRegularPatchIndices() {
+  if (adaptive) {
+    return;
+  }
   regularPatchIndices.clear();
 
-  QVector<unsigned int> newRegularPatchIndices;
-  newRegularPatchIndices.resize(16);
+  for (int f = 0; f < faces.size(); f++) {
+    if (faces[f].isRegular()) {
+      faces[f].appendPatchIndices(regularPatchIndices);
+    }
+  }
+}
+
+/**
+ * @brief hasQuadRing Determines whether a vertex is an interior vertex whose
+ * surrounding faces are all quads.
+ * @param vertex The vertex.
+ * @return True if the vertex is surrounded by quads; false otherwise.
+ */
+static bool hasQuadRing(const Vertex &vertex) {
+  if (vertex.isBoundaryVertex()) {
+    return false;
+  }
+  HalfEdge *edge = vertex.out;
+  do {
+    if (edge->face->valence != 4) {
+      return false;
+    }
+    edge = edge->twin->next;
+  } while (edge != vertex.out);
+  return true;
+}
 
-  // Maps vertex indices to 4x4 row-major ordering.
-  QVector<unsigned int> map = {1,  5,  4,  0,  7, 6, 2,  3,
-                               14, 10, 11, 15, 8, 9, 13, 12};
+/**
+ * @brief Mesh::computeIrregularPatches Approximates the quads that are not
+ * regular by bicubic Bezier patches, following the ACC geometry patches of
+ * Loop and Schaefer. Every corner of a quad gets a face point
+ * (n v + 2 (e_a + e_b) + f) / (n + 5), where n is the valence of the corner
+ * vertex v, e_a and e_b its neighbours in the quad and f the opposite vertex.
+ * The inner control points are the face points, the edge control points
+ * average the face points on both sides of the edge and the corners average
+ * all face points around the vertex, which is the limit position.
+ *
+ * For regular quads this is exactly the B-spline patch. The control points on
+ * an edge only depend on the faces around its vertices and are computed once,
+ * so adjacent patches share their boundary curves. Quads touching the
+ * boundary or a non-quad are skipped. Meshes created by the
+ * AdaptiveSubdivider are left untouched.
+ *
+ * The sides of the regular patches that border these patches are recorded as
+ * well, since both patches have to tessellate their common side alike.
+ */
+void Mesh::computeIrregularPatches() {
+  irregularPatchCoords.clear();
+  irregularSides.clear();
+  if (adaptive) {
+    return;
+  }
 
+  QVector<int> patchFaces;
+  QVector<bool> patchFace(faces.size(), false);
+  QVector<bool> usedVertices(vertices.size(), false);
   for (int f = 0; f < faces.size(); f++) {
-    Face *face = &faces[f];
-    if (face->valence != 4) {
+    const Face &face = faces[f];
+    if (face.valence != 4 || face.isRegular()) {
+      continue;
+    }
+    bool supported = true;
+    HalfEdge *edge = face.side;
+    for (int m = 0; m < 4; m++) {
+      supported = supported && hasQuadRing(*edge->origin);
+      edge = edge->next;
+    }
+    if (!supported) {
       continue;
     }
+    patchFaces.append(f);
+    patchFace[f] = true;
+    for (int m = 0; m < 4; m++) {
+      usedVertices[edge->origin->index] = true;
+      edge = edge->next;
+    }
+  }
 
-    bool isRegularPatch = true;
-    HalfEdge *currentEdge = face->side;
-    // Check the valence of the connected faces
-    // and vertices of the central face.
-    for (int m = 0; m < face->valence; m++) {
-      HalfEdge *twinEdge = currentEdge->twin;
-      if (currentEdge->origin->valence != 4 || twinEdge->face->valence != 4 ||
-          twinEdge->next->twin->face->valence != 4) {
-        isRegularPatch = false;
-        break;
-      }
-      currentEdge = currentEdge->next;
+  // Face points of the corners around the used vertices, indexed by the
+  // half-edge that leaves the corner, and the corner points of the vertices.
+  QVector<QVector3D> facePoints(halfEdges.size());
+  QVector<QVector3D> cornerPoints(vertices.size());
+  for (int v = 0; v < vertices.size(); v++) {
+    if (!usedVertices[v]) {
+      continue;
     }
+    const Vertex &vertex = vertices[v];
+    float n = vertex.valence;
+    QVector3D sum;
+    HalfEdge *edge = vertex.out;
+    do {
+      QVector3D facePoint =
+          (n * vertex.coords +
+           2.0f * (edge->next->origin->coords + edge->prev->origin->coords) +
+           edge->next->next->origin->coords) /
+          (n + 5.0f);
+      facePoints[edge->index] = facePoint;
+      sum += facePoint;
+      edge = edge->twin->next;
+    } while (edge != vertex.out);
+    cornerPoints[v] = sum / n;
+  }
+  // The edge point near the origin of a half-edge.
+  auto edgePoint = [&facePoints](const HalfEdge *edge) {
+    return (facePoints[edge->index] + facePoints[edge->twin->next->index]) /
+           2.0f;
+  };
 
-    if (isRegularPatch) {
-      HalfEdge *currentInnerEdge = face->side;
-      // For rotating around inner quad
-      for (int m = 0; m < face->valence; m++) {
-        HalfEdge *currentOuterEdge = currentInnerEdge->twin->next->twin;
-        // For rotating around outer corner quad
-        for (int n = 0; n < face->valence; n++) {
-          newRegularPatchIndices[map[m * face->valence + n]] =
-              currentOuterEdge->origin->index;
-          currentOuterEdge = currentOuterEdge->next;
-        }
-        currentInnerEdge = currentInnerEdge->next;
+  // Positions of the corners in the 4x4 grid, and the directions of the
+  // sides that start at them.
+  static const int cornerI[4] = {0, 3, 3, 0};
+  static const int cornerJ[4] = {0, 0, 3, 3};
+  static const int sideI[4] = {1, 0, -1, 0};
+  static const int sideJ[4] = {0, 1, 0, -1};
+  irregularPatchCoords.resize(16 * patchFaces.size());
+  for (int p = 0; p < patchFaces.size(); p++) {
+    QVector3D *points = irregularPatchCoords.data() + 16 * p;
+    HalfEdge *edge = faces[patchFaces[p]].side;
+    for (int k = 0; k < 4; k++) {
+      int i = cornerI[k];
+      int j = cornerJ[k];
+      // The previous side ends at this corner, so it is walked backwards.
+      int backI = -sideI[(k + 3) % 4];
+      int backJ = -sideJ[(k + 3) % 4];
+      points[4 * j + i] = cornerPoints[edge->origin->index];
+      points[4 * (j + sideJ[k]) + i + sideI[k]] = edgePoint(edge);
+      points[4 * (j + backJ) + i + backI] = edgePoint(edge->prev->twin);
+      points[4 * (j + sideJ[k] + backJ) + i + sideI[k] + backI] =
+          facePoints[edge->index];
+      edge = edge->next;
+    }
+  }
+
+  // The regular patches in the order of computeRegularPatchIndices(). Side m
+  // of a face starts at control point 5, 6, 10 and 9 respectively, which is
+  // outer level m + 1.
+  for (int f = 0; f < faces.size(); f++) {
+    if (!faces[f].isRegular()) {
+      continue;
+    }
+    int sides = 0;
+    HalfEdge *edge = faces[f].side;
+    for (int m = 0; m < 4; m++) {
+      if (patchFace[edge->twin->face->index]) {
+        sides |= 1 << ((m + 1) % 4);
       }
-      regularPatchIndices.append(newRegularPatchIndices);
+      edge = edge->next;
     }
+    irregularSides.append(sides);
   }
 }
 
@@ -172,3 +375,17 @@ int Mesh::numFaces() { return faces.size(); }
  * @return The number of edges.
  */
 int Mesh::numEdges() { return edgeCount; }
+
+/**
+ * @brief Mesh::memoryUsage Computes the amount of memory allocated by this
+ * mesh, including the attribute buffers.
+ * @return The number of allocated bytes.
+ */
+qint64 Mesh::memoryUsage() const {
+  return vectorMemory(vertices) + vectorMemory(halfEdges) +
+         vectorMemory(faces) + vectorMemory(vertexCoords) +
+         vectorMemory(vertexNormals) + vectorMemory(polyIndices) +
+         vectorMemory(quadIndices) + vectorMemory(regularPatchIndices) +
+         vectorMemory(irregularPatchCoords) + vectorMemory(patchLevels) +
+         vectorMemory(irregularSides);
+}
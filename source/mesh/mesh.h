@@ -1,6 +1,7 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <QSharedPointer>
 #include <QVector>
 
 #include "face.h"
@@ -26,15 +27,24 @@ class Mesh {
   inline QVector<unsigned int>& getPolyIndices() { return polyIndices; }
   inline QVector<unsigned int>& getQuadIndices() { return quadIndices; }
   inline QVector<unsigned int>& getRegularPatchIndices() { return regularPatchIndices; }
+  inline QVector<QVector3D>& getIrregularPatchCoords() { return irregularPatchCoords; }
+  inline QVector<int>& getPatchLevels() { return patchLevels; }
+  inline QVector<int>& getIrregularSides() { return irregularSides; }
 
+  void setVertexPositions(const QVector<QVector3D>& coords);
+  QSharedPointer<Mesh> detachedCopy() const;
+  QSharedPointer<Mesh> movedCopy(const QVector<QVector3D>& coords) const;
+  bool hasSameTopology(Mesh& other);
   void extractAttributes();
   void recalculateNormals();
   void computeRegularPatchIndices();
+  void computeIrregularPatches();
 
   int numVerts();
   int numHalfEdges();
   int numFaces();
   int numEdges();
+  qint64 memoryUsage() const;
 
  private:
   QVector<QVector3D> vertexCoords;
@@ -45,17 +55,32 @@ class Mesh {
   QVector<unsigned int> quadIndices;
   // for cubic B-splines tessellation
   QVector<unsigned int> regularPatchIndices;
+  // 16 control points per bicubic Bezier patch that approximates the quads
+  // that are not regular, in 4x4 row-major ordering.
+  QVector<QVector3D> irregularPatchCoords;
+  // For every regular patch, a bit mask of the sides that border the patch of
+  // an irregular face, in the order of the outer tessellation levels.
+  QVector<int> irregularSides;
+  // Only for meshes created by the AdaptiveSubdivider: five entries per
+  // regular patch, its subdivision level followed by the levels of the
+  // patches across its sides, in the order of the outer tessellation levels.
+  QVector<int> patchLevels;
 
   QVector<Vertex> vertices;
   QVector<Face> faces;
   QVector<HalfEdge> halfEdges;
 
   int edgeCount;
+  // Set for meshes created by the AdaptiveSubdivider, whose regular patches
+  // are determined during refinement.
+  bool adaptive;
 
   // These classes require access to the private fields to prevent a bunch of
   // function calls.
   friend class MeshInitializer;
+  friend class MeshCache;
   friend class Subdivider;
+  friend class AdaptiveSubdivider;
   friend class CatmullClarkSubdivider;
 };
 
@@ -0,0 +1,194 @@
+#include "meshpipeline.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QPromise>
+
+#include "subdivision/adaptivesubdivider.h"
+
+/**
+ * @brief MeshPipeline::MeshPipeline Creates a new pipeline without a control
+ * mesh.
+ */
+MeshPipeline::MeshPipeline()
+    : adaptiveLevel(-1), adaptiveBuffers(0), stageTimings(nullptr) {
+  worker.setMaxThreadCount(1);
+}
+
+/**
+ * @brief MeshPipeline::~MeshPipeline Cancels the pending requests and waits for
+ * the running request to stop.
+ */
+MeshPipeline::~MeshPipeline() {
+  cancel();
+  waitForFinished();
+}
+
+/**
+ * @brief MeshPipeline::setControlMesh Replaces the control mesh. Cancels and
+ * waits for the running request first, since it might still use the previous
+ * control mesh.
+ * @param controlMesh The new control mesh.
+ */
+void MeshPipeline::setControlMesh(const QSharedPointer<Mesh> &controlMesh) {
+  cancel();
+  waitForFinished();
+  subdivisionCache.setControlMesh(controlMesh);
+  adaptiveMesh.clear();
+  adaptiveLevel = -1;
+  adaptiveBVH.clear();
+  levelBVHs.clear();
+}
+
+/**
+ * @brief MeshPipeline::setStageTimings Sets where the durations of the
+ * subdivision and extraction stages are recorded. Should be set before the
+ * first request.
+ * @param timings The timings, or a null pointer to not record them.
+ */
+void MeshPipeline::setStageTimings(StageTimings *timings) {
+  stageTimings = timings;
+}
+
+/**
+ * @brief MeshPipeline::setStencilMode Enables or disables the stencil mode of
+ * the subdivision cache. Waits for the running request first.
+ * @param enabled Whether control meshes with the same topology only move the
+ * cached levels. See SubdivisionCache.
+ */
+void MeshPipeline::setStencilMode(bool enabled) {
+  cancel();
+  waitForFinished();
+  subdivisionCache.setStencilMode(enabled);
+}
+
+/**
+ * @brief MeshPipeline::prepare Requests a mesh that is ready to be uploaded to
+ * the GPU. Cancels the previous request.
+ * @param level The subdivision level.
+ * @param adaptive Whether to use feature-adaptive subdivision instead of
+ * uniform subdivision.
+ * @param regularPatches Whether the regular patch indices and their hierarchy
+ * are needed.
+ * @return A future that contains the prepared mesh once it is finished. The
+ * future contains no result if the request was canceled.
+ */
+QFuture<PreparedMesh> MeshPipeline::prepare(int level, bool adaptive,
+                                            bool regularPatches) {
+  cancel();
+
+  // QPromise can only be moved, so it is shared with the task instead.
+  auto promise = QSharedPointer<QPromise<PreparedMesh>>::create();
+  currentRequest = promise->future();
+  worker.start([this, promise, level, adaptive, regularPatches]() {
+    promise->start();
+    auto isCanceled = [&promise]() { return promise->isCanceled(); };
+
+    QElapsedTimer timer;
+    timer.start();
+    QSharedPointer<Mesh> mesh;
+    int buffers = 0;
+    if (adaptive) {
+      if (adaptiveMesh.isNull() || adaptiveLevel != level) {
+        QSharedPointer<Mesh> controlMesh = subdivisionCache.level(0);
+        if (!controlMesh.isNull() && !isCanceled()) {
+          AdaptiveSubdivider adaptiveSubdivider;
+          adaptiveMesh = QSharedPointer<Mesh>::create(
+              adaptiveSubdivider.subdivide(*controlMesh, level));
+          adaptiveLevel = level;
+          adaptiveBuffers = 0;
+          qDebug() << ":: Adaptively subdivided to level" << level << "with"
+                   << adaptiveMesh->getRegularPatchIndices().size() / 16
+                   << "patches in" << timer.elapsed() << "ms";
+        }
+      }
+      if (adaptiveLevel == level) {
+        mesh = adaptiveMesh;
+        buffers = adaptiveBuffers;
+      }
+    } else {
+      mesh = subdivisionCache.level(level, isCanceled);
+      buffers = subdivisionCache.preparedFlags(level);
+    }
+    if (!mesh.isNull() && stageTimings != nullptr) {
+      stageTimings->record("subdivide", timer.nsecsElapsed() / 1e6);
+    }
+
+    if (!mesh.isNull() && !isCanceled()) {
+      timer.restart();
+      bool missing = !(buffers & VERTEX_ATTRIBUTES) ||
+                     (regularPatches && !(buffers & PATCH_INDICES));
+      if (buffers != 0 && missing) {
+        // The mesh was handed out before and may still be read by the GUI, so
+        // the missing buffers are extracted into a copy that replaces it.
+        mesh = mesh->detachedCopy();
+        if (adaptive) {
+          adaptiveMesh = mesh;
+        } else {
+          subdivisionCache.replaceLevel(level, mesh);
+        }
+      }
+      if (!(buffers & VERTEX_ATTRIBUTES)) {
+        mesh->extractAttributes();
+        buffers |= VERTEX_ATTRIBUTES;
+      }
+      QSharedPointer<const PatchBVH> &bvh =
+          adaptive ? adaptiveBVH : levelBVH(level);
+      if (regularPatches && !(buffers & PATCH_INDICES)) {
+        mesh->computeRegularPatchIndices();
+        mesh->computeIrregularPatches();
+        auto patchBVH = QSharedPointer<PatchBVH>::create();
+        patchBVH->build(mesh->getVertexCoords(),
+                        mesh->getRegularPatchIndices(),
+                        mesh->getPatchLevels(), mesh->getIrregularSides());
+        bvh = patchBVH;
+        buffers |= PATCH_INDICES;
+      }
+      if (adaptive) {
+        adaptiveBuffers = buffers;
+      } else {
+        subdivisionCache.setPreparedFlags(level, buffers);
+      }
+      if (stageTimings != nullptr) {
+        stageTimings->record("extract", timer.nsecsElapsed() / 1e6);
+      }
+      qDebug() << ":: Prepared buffers in" << timer.elapsed() << "ms";
+      if (!(buffers & PATCH_INDICES)) {
+        // Left over from an earlier mesh of the level.
+        bvh.clear();
+      }
+      PreparedMesh prepared;
+      prepared.mesh = mesh;
+      prepared.bvh = bvh;
+      promise->addResult(prepared);
+    }
+    promise->finish();
+  });
+  return currentRequest;
+}
+
+/**
+ * @brief MeshPipeline::levelBVH Retrieves the slot of the hierarchy of a
+ * cached level. Only valid while the patches of the level are extracted, see
+ * SubdivisionCache::preparedFlags().
+ * @param level The subdivision level.
+ * @return The hierarchy, which can be replaced.
+ */
+QSharedPointer<const PatchBVH> &MeshPipeline::levelBVH(int level) {
+  if (level >= levelBVHs.size()) {
+    levelBVHs.resize(level + 1);
+  }
+  return levelBVHs[level];
+}
+
+/**
+ * @brief MeshPipeline::cancel Cancels the current request. A running request
+ * stops at the next subdivision step.
+ */
+void MeshPipeline::cancel() { currentRequest.cancel(); }
+
+/**
+ * @brief MeshPipeline::waitForFinished Waits until all requests are finished or
+ * have stopped.
+ */
+void MeshPipeline::waitForFinished() { worker.waitForDone(); }
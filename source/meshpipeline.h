@@ -0,0 +1,78 @@
+#ifndef MESH_PIPELINE_H
+#define MESH_PIPELINE_H
+
+#include <QFuture>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include "evaluation/patchbvh.h"
+#include "mesh/mesh.h"
+#include "subdivision/subdivisioncache.h"
+#include "util/stagetimings.h"
+
+/**
+ * @brief The PreparedBuffer enum lists the buffers that the MeshPipeline
+ * extracts from a mesh. Used as flags.
+ */
+enum PreparedBuffer { VERTEX_ATTRIBUTES = 1, PATCH_INDICES = 2 };
+
+/**
+ * @brief The PreparedMesh struct is the result of a request to the
+ * MeshPipeline: the mesh with its extracted buffers and, if the patches were
+ * requested, the bounding volume hierarchy over its regular patches. Neither
+ * is modified after the request finished.
+ */
+typedef struct PreparedMesh {
+  QSharedPointer<Mesh> mesh;
+  QSharedPointer<const PatchBVH> bvh;
+} PreparedMesh;
+
+/**
+ * @brief The MeshPipeline class prepares meshes for rendering on a background
+ * thread. Preparing a mesh consists of subdividing the control mesh to the
+ * requested level and extracting the vertex attributes and indices that are
+ * uploaded to the GPU. Requests are handled one at a time, in order. A new
+ * request cancels the previous one, which stops at the next subdivision step.
+ *
+ * The buffers are extracted in place, in the meshes of the subdivision cache.
+ * The pipeline records which buffers of every cached level are extracted, so
+ * requesting a level again only extracts what is missing. The hierarchy over
+ * the patches is built and kept along with the patches. Meshes are only
+ * modified before their buffers are first handed out, or when a request needs
+ * additional buffers. The result of the adaptive subdivision is cached as well
+ * until the control mesh changes.
+ */
+class MeshPipeline {
+ public:
+  MeshPipeline();
+  ~MeshPipeline();
+
+  void setControlMesh(const QSharedPointer<Mesh>& controlMesh);
+  void setStageTimings(StageTimings* timings);
+  void setStencilMode(bool enabled);
+  QFuture<PreparedMesh> prepare(int level, bool adaptive, bool regularPatches);
+  void cancel();
+  void waitForFinished();
+
+  inline SubdivisionCache& getSubdivisionCache() { return subdivisionCache; }
+
+ private:
+  QSharedPointer<const PatchBVH>& levelBVH(int level);
+
+  // Runs the requests. Has a single thread, so only one request accesses the
+  // subdivision cache at any time.
+  QThreadPool worker;
+  QFuture<PreparedMesh> currentRequest;
+  SubdivisionCache subdivisionCache;
+  // The hierarchies of the cached levels whose patches are extracted.
+  QVector<QSharedPointer<const PatchBVH>> levelBVHs;
+  // The last adaptively subdivided mesh, its level, its extracted buffers and
+  // its hierarchy.
+  QSharedPointer<Mesh> adaptiveMesh;
+  int adaptiveLevel;
+  int adaptiveBuffers;
+  QSharedPointer<const PatchBVH> adaptiveBVH;
+  StageTimings* stageTimings;
+};
+
+#endif  // MESH_PIPELINE_H
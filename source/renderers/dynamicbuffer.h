@@ -0,0 +1,175 @@
+#ifndef DYNAMIC_BUFFER_H
+#define DYNAMIC_BUFFER_H
+
+#include <QHash>
+#include <QOpenGLFunctions_4_1_Core>
+#include <QPair>
+#include <QVector>
+
+// Number of elements per hashed chunk of the contents.
+#define DYNAMIC_BUFFER_CHUNK 64
+// Changed chunks that are at most this many chunks apart are uploaded as a
+// single range.
+#define DYNAMIC_BUFFER_MERGE_GAP 1
+// Above this number of ranges, the changed chunks are uploaded as one range.
+#define DYNAMIC_BUFFER_MAX_RANGES 64
+
+/**
+ * @brief The DynamicBuffer class is a GL buffer whose contents are replaced as
+ * a whole, but which only uploads what changed. It does not keep the uploaded
+ * contents, which would keep e.g. the vectors of evicted meshes alive, but only
+ * their size and a hash of every chunk of DYNAMIC_BUFFER_CHUNK elements.
+ *
+ * - Contents of the same size are compared to the previous upload chunk by
+ *   chunk, and only the ranges of changed chunks are uploaded with
+ *   glBufferSubData. If most of the buffer changed, the storage is orphaned
+ *   first so the upload does not wait for draw calls that still use it.
+ * - Contents of a different size reuse the storage if they fit and it is not
+ *   much larger than needed. The storage is orphaned before it is reused.
+ *
+ * Uploads use the GL_COPY_WRITE_BUFFER target so they do not affect the
+ * bindings of vertex array objects.
+ */
+template <typename T>
+class DynamicBuffer {
+ public:
+  DynamicBuffer() : gl(nullptr), buffer(0), capacity(0), count(0) {}
+  ~DynamicBuffer() {
+    if (gl != nullptr) {
+      gl->glDeleteBuffers(1, &buffer);
+    }
+  }
+
+  /**
+   * @brief DynamicBuffer::create Creates the buffer in the current context.
+   * @param f OpenGL functions pointer.
+   */
+  void create(QOpenGLFunctions_4_1_Core* f) {
+    gl = f;
+    gl->glGenBuffers(1, &buffer);
+  }
+
+  /**
+   * @brief DynamicBuffer::upload Replaces the contents of the buffer.
+   * @param data The new contents.
+   * @return The number of bytes that were uploaded.
+   */
+  qint64 upload(const QVector<T>& data) {
+    QVector<size_t> nextHashes = chunkHashes(data);
+    qint64 uploaded = 0;
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (data.size() > capacity || 4 * data.size() < capacity) {
+      // Allocate new storage with exactly the required size.
+      capacity = data.size();
+      gl->glBufferData(GL_COPY_WRITE_BUFFER, bytes(capacity), data.constData(),
+                       GL_DYNAMIC_DRAW);
+      uploaded = bytes(data.size());
+    } else if (data.size() != count) {
+      uploaded = replace(data);
+    } else {
+      uploaded = update(data, nextHashes);
+    }
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    count = data.size();
+    hashes = nextHashes;
+    return uploaded;
+  }
+
+  inline GLuint id() const { return buffer; }
+  inline int size() const { return count; }
+
+ private:
+  static inline GLsizeiptr bytes(int count) {
+    return static_cast<GLsizeiptr>(sizeof(T)) * count;
+  }
+
+  /**
+   * @brief DynamicBuffer::chunkHashes Hashes the contents in chunks of
+   * DYNAMIC_BUFFER_CHUNK elements. The last chunk may be shorter.
+   * @param data The contents.
+   * @return The hash of every chunk.
+   */
+  static QVector<size_t> chunkHashes(const QVector<T>& data) {
+    int chunks =
+        (data.size() + DYNAMIC_BUFFER_CHUNK - 1) / DYNAMIC_BUFFER_CHUNK;
+    QVector<size_t> chunkHashes(chunks);
+    for (int c = 0; c < chunks; c++) {
+      int begin = c * DYNAMIC_BUFFER_CHUNK;
+      int end = qMin(begin + DYNAMIC_BUFFER_CHUNK, int(data.size()));
+      chunkHashes[c] = qHashBits(data.constData() + begin,
+                                 size_t(bytes(end - begin)));
+    }
+    return chunkHashes;
+  }
+
+  /**
+   * @brief DynamicBuffer::replace Orphans the storage and uploads the new
+   * contents into it. Assumes the buffer is bound.
+   * @param data The new contents. Fit in the storage.
+   * @return The number of bytes that were uploaded.
+   */
+  qint64 replace(const QVector<T>& data) {
+    gl->glBufferData(GL_COPY_WRITE_BUFFER, bytes(capacity), nullptr,
+                     GL_DYNAMIC_DRAW);
+    gl->glBufferSubData(GL_COPY_WRITE_BUFFER, 0, bytes(data.size()),
+                        data.constData());
+    return bytes(data.size());
+  }
+
+  /**
+   * @brief DynamicBuffer::update Uploads the ranges of chunks whose hashes
+   * differ from those of the current contents. Assumes the buffer is bound.
+   * @param data The new contents. Have the same size as the current contents.
+   * @param nextHashes The hashes of the chunks of the new contents.
+   * @return The number of bytes that were uploaded.
+   */
+  qint64 update(const QVector<T>& data, const QVector<size_t>& nextHashes) {
+    const T* next = data.constData();
+    // Ranges of changed chunks as pairs of begin and end (exclusive).
+    QVector<QPair<int, int>> ranges;
+    int covered = 0;
+    for (int i = 0; i < nextHashes.size(); i++) {
+      if (nextHashes[i] == hashes[i]) {
+        continue;
+      }
+      if (!ranges.isEmpty() &&
+          i - ranges.last().second <= DYNAMIC_BUFFER_MERGE_GAP) {
+        covered += i + 1 - ranges.last().second;
+        ranges.last().second = i + 1;
+      } else {
+        ranges.append(qMakePair(i, i + 1));
+        covered++;
+      }
+    }
+    if (ranges.isEmpty()) {
+      return 0;
+    }
+    if (2 * covered > nextHashes.size()) {
+      return replace(data);
+    }
+    if (ranges.size() > DYNAMIC_BUFFER_MAX_RANGES) {
+      ranges = {qMakePair(ranges.first().first, ranges.last().second)};
+    }
+    qint64 uploaded = 0;
+    for (const QPair<int, int>& range : ranges) {
+      int begin = range.first * DYNAMIC_BUFFER_CHUNK;
+      int end = qMin(range.second * DYNAMIC_BUFFER_CHUNK, int(data.size()));
+      GLsizeiptr size = bytes(end - begin);
+      gl->glBufferSubData(GL_COPY_WRITE_BUFFER, bytes(begin), size,
+                          next + begin);
+      uploaded += size;
+    }
+    return uploaded;
+  }
+
+  QOpenGLFunctions_4_1_Core* gl;
+  GLuint buffer;
+  // Number of elements the storage can hold.
+  int capacity;
+  // Number of elements of the uploaded contents and the hashes of its chunks.
+  // Chunks whose hashes collide are not uploaded, which is negligibly rare.
+  int count;
+  QVector<size_t> hashes;
+};
+
+#endif  // DYNAMIC_BUFFER_H
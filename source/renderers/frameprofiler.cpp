@@ -0,0 +1,368 @@
+#include "frameprofiler.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QTextStream>
+
+/**
+ * @brief FrameProfiler::FrameProfiler Creates a new profiler. It has to be
+ * initialised with an OpenGL context before it can be used.
+ */
+FrameProfiler::FrameProfiler()
+    : gl(nullptr),
+      frameCount(0),
+      currentSlot(0),
+      historyStart(0),
+      recording(false) {
+  for (QuerySlot &slot : querySlots) {
+    slot.pending = false;
+  }
+}
+
+/**
+ * @brief FrameProfiler::~FrameProfiler Deletes the queries. Assumes the
+ * context it was initialised with is current.
+ */
+FrameProfiler::~FrameProfiler() {
+  if (gl == nullptr) {
+    return;
+  }
+  for (QuerySlot &slot : querySlots) {
+    gl->glDeleteQueries(NUM_GPU_STAGES, slot.timeQueries);
+    gl->glDeleteQueries(NUM_GPU_STAGES, slot.primitiveQueries);
+  }
+}
+
+/**
+ * @brief FrameProfiler::init Creates the queries in the current context.
+ * @param f OpenGL functions pointer.
+ */
+void FrameProfiler::init(QOpenGLFunctions_4_1_Core *f) {
+  gl = f;
+  for (QuerySlot &slot : querySlots) {
+    gl->glGenQueries(NUM_GPU_STAGES, slot.timeQueries);
+    gl->glGenQueries(NUM_GPU_STAGES, slot.primitiveQueries);
+  }
+}
+
+/**
+ * @brief FrameProfiler::reset Forgets the completed frames, e.g. after
+ * profiling was paused. Does not affect the recorded frames.
+ */
+void FrameProfiler::reset() {
+  history.clear();
+  historyStart = 0;
+  intervalTimer.invalidate();
+}
+
+/**
+ * @brief FrameProfiler::beginFrame Starts profiling a frame. Collects the
+ * results of earlier frames that are available. Only waits for the GPU if the
+ * queries of the oldest frame in flight are still not finished.
+ * @param settings The settings the frame is rendered with.
+ * @param numPatches The number of patches that are tessellated, both regular
+ * and irregular.
+ */
+void FrameProfiler::beginFrame(const Settings &settings, int numPatches) {
+  // Frames complete in order, so stop at the first one that is not finished.
+  for (int k = 0; k < FRAMES_IN_FLIGHT; k++) {
+    QuerySlot &slot = querySlots[(frameCount + k) % FRAMES_IN_FLIGHT];
+    if (!collect(slot, k == 0)) {
+      break;
+    }
+  }
+
+  currentSlot = frameCount % FRAMES_IN_FLIGHT;
+  QuerySlot &slot = querySlots[currentSlot];
+  for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+    slot.issued[stage] = false;
+  }
+  slot.pending = true;
+
+  FrameStats &stats = slot.stats;
+  stats.frame = frameCount;
+  stats.intervalMs =
+      intervalTimer.isValid() ? intervalTimer.nsecsElapsed() / 1e6 : 0.0;
+  stats.tileSize = settings.tileSize;
+  stats.tessDetail = settings.tessDetail;
+  stats.dynamicLoD = settings.dynamicLoD;
+  stats.pixelError =
+      settings.dynamicLoD && settings.errorDrivenLoD ? settings.pixelError : 0.0f;
+  stats.subdivSteps = settings.subdivSteps;
+  stats.numPatches = numPatches;
+  stats.frustumCulled = 0;
+  stats.backCulled = 0;
+  stats.pretessellated = false;
+
+  intervalTimer.start();
+  cpuTimer.start();
+}
+
+/**
+ * @brief FrameProfiler::endFrame Finishes profiling the current frame. Its GPU
+ * results are collected during one of the next frames.
+ */
+void FrameProfiler::endFrame() {
+  querySlots[currentSlot].stats.cpuMs = cpuTimer.nsecsElapsed() / 1e6;
+  frameCount++;
+}
+
+/**
+ * @brief FrameProfiler::beginStage Starts timing a draw call and counting the
+ * primitives it generates. Stages cannot overlap.
+ * @param stage The stage.
+ */
+void FrameProfiler::beginStage(GpuStage stage) {
+  QuerySlot &slot = querySlots[currentSlot];
+  gl->glBeginQuery(GL_TIME_ELAPSED, slot.timeQueries[stage]);
+  gl->glBeginQuery(GL_PRIMITIVES_GENERATED, slot.primitiveQueries[stage]);
+  slot.issued[stage] = true;
+}
+
+/**
+ * @brief FrameProfiler::endStage Stops timing a draw call.
+ * @param stage The stage.
+ */
+void FrameProfiler::endStage(GpuStage stage) {
+  Q_UNUSED(stage);
+  gl->glEndQuery(GL_PRIMITIVES_GENERATED);
+  gl->glEndQuery(GL_TIME_ELAPSED);
+}
+
+/**
+ * @brief FrameProfiler::setCulledPatches Records how many patches of the
+ * current frame were culled.
+ * @param frustumCulled The number of patches outside the view frustum.
+ * @param backCulled The number of back-facing patches.
+ */
+void FrameProfiler::setCulledPatches(int frustumCulled, int backCulled) {
+  FrameStats &stats = querySlots[currentSlot].stats;
+  stats.frustumCulled = frustumCulled;
+  stats.backCulled = backCulled;
+}
+
+/**
+ * @brief FrameProfiler::setPretessellated Records whether the surface of the
+ * current frame was drawn from the pretessellated capture.
+ * @param pretessellated True if the pretessellated surface was drawn.
+ */
+void FrameProfiler::setPretessellated(bool pretessellated) {
+  querySlots[currentSlot].stats.pretessellated = pretessellated;
+}
+
+/**
+ * @brief FrameProfiler::collect Reads the query results of a frame.
+ * @param slot The slot of the frame.
+ * @param wait Whether to wait for the results if they are not available yet.
+ * @return True if the frame is completed; false if its results are not
+ * available yet.
+ */
+bool FrameProfiler::collect(QuerySlot &slot, bool wait) {
+  if (!slot.pending) {
+    return true;
+  }
+  if (!wait) {
+    for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+      if (!slot.issued[stage]) {
+        continue;
+      }
+      // The primitive query ends first, so the time query finishes last.
+      GLint available = 0;
+      gl->glGetQueryObjectiv(slot.timeQueries[stage],
+                             GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        return false;
+      }
+    }
+  }
+
+  FrameStats &stats = slot.stats;
+  for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+    stats.gpuMs[stage] = -1.0;
+    stats.primitives[stage] = -1;
+    if (slot.issued[stage]) {
+      GLuint64 nanoseconds = 0;
+      GLuint64 primitives = 0;
+      gl->glGetQueryObjectui64v(slot.timeQueries[stage], GL_QUERY_RESULT,
+                                &nanoseconds);
+      gl->glGetQueryObjectui64v(slot.primitiveQueries[stage], GL_QUERY_RESULT,
+                                &primitives);
+      stats.gpuMs[stage] = nanoseconds / 1e6;
+      stats.primitives[stage] = static_cast<qint64>(primitives);
+    }
+  }
+  slot.pending = false;
+  complete(stats);
+  return true;
+}
+
+/**
+ * @brief FrameProfiler::complete Adds a completed frame to the history and, if
+ * recording, to the recorded frames.
+ * @param stats The statistics of the frame.
+ */
+void FrameProfiler::complete(const FrameStats &stats) {
+  if (history.size() < OVERLAY_FRAMES) {
+    history.append(stats);
+  } else {
+    history[historyStart] = stats;
+    historyStart = (historyStart + 1) % OVERLAY_FRAMES;
+  }
+  if (recording) {
+    recorded.append(stats);
+  }
+}
+
+/**
+ * @brief FrameProfiler::latestFrame Returns the most recent completed frame.
+ * @param stats The statistics of the frame.
+ * @return True if a frame has been completed since the last reset; false
+ * otherwise.
+ */
+bool FrameProfiler::latestFrame(FrameStats &stats) const {
+  if (history.isEmpty()) {
+    return false;
+  }
+  stats = history[(historyStart + history.size() - 1) % history.size()];
+  return true;
+}
+
+/**
+ * @brief FrameProfiler::overlayLines Summarises the most recent frames and the
+ * preparation of the current mesh.
+ * @return The lines of text of the overlay.
+ */
+QStringList FrameProfiler::overlayLines() const {
+  QStringList lines;
+  if (history.isEmpty()) {
+    return lines;
+  }
+
+  double interval = 0.0;
+  int intervals = 0;
+  double cpu = 0.0;
+  double gpu[NUM_GPU_STAGES] = {};
+  double primitives[NUM_GPU_STAGES] = {};
+  int drawn[NUM_GPU_STAGES] = {};
+  for (const FrameStats &stats : history) {
+    // The first frame after a reset has no interval.
+    if (stats.intervalMs > 0.0) {
+      interval += stats.intervalMs;
+      intervals++;
+    }
+    cpu += stats.cpuMs;
+    for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+      if (stats.gpuMs[stage] >= 0.0) {
+        gpu[stage] += stats.gpuMs[stage];
+        primitives[stage] += stats.primitives[stage];
+        drawn[stage]++;
+      }
+    }
+  }
+  cpu /= history.size();
+
+  QString frame = "Frame:";
+  if (intervals > 0) {
+    interval /= intervals;
+    frame += QString(" %1 ms (%2 fps),")
+                 .arg(interval, 0, 'f', 2)
+                 .arg(1000.0 / interval, 0, 'f', 1);
+  }
+  lines << frame + QString(" CPU %1 ms").arg(cpu, 0, 'f', 2);
+
+  const char *stageNames[NUM_GPU_STAGES] = {"Mesh", "Tessellation"};
+  for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+    if (drawn[stage] > 0) {
+      lines << QString("%1: GPU %2 ms, %3 primitives")
+                   .arg(stageNames[stage])
+                   .arg(gpu[stage] / drawn[stage], 0, 'f', 2)
+                   .arg(qint64(primitives[stage] / drawn[stage]));
+    }
+  }
+
+  const FrameStats &latest =
+      history[(historyStart + history.size() - 1) % history.size()];
+  QString lod = latest.dynamicLoD ? "on" : "off";
+  if (latest.pixelError > 0.0f) {
+    lod = QString("%1 px error").arg(latest.pixelError);
+  }
+  lines << QString("Patches: %1 (culled %2 outside frustum, %3 back-facing), "
+                   "tile size %4, detail %5, dynamic LoD %6")
+               .arg(latest.numPatches)
+               .arg(latest.frustumCulled)
+               .arg(latest.backCulled)
+               .arg(latest.tileSize)
+               .arg(latest.tessDetail)
+               .arg(lod);
+
+  QStringList stages;
+  for (const QPair<QString, double> &stage : preparation.stages()) {
+    stages << QString("%1 %2 ms").arg(stage.first).arg(stage.second, 0, 'f', 1);
+  }
+  if (!stages.isEmpty()) {
+    lines << "Preparation: " + stages.join(", ");
+  }
+  if (recording) {
+    lines << QString("Recording (%1 frames)").arg(recorded.size());
+  }
+  return lines;
+}
+
+/**
+ * @brief FrameProfiler::startRecording Starts recording the statistics of
+ * every completed frame. Discards earlier recordings.
+ */
+void FrameProfiler::startRecording() {
+  recorded.clear();
+  recording = true;
+}
+
+/**
+ * @brief FrameProfiler::stopRecording Stops recording and writes the recorded
+ * frames to a CSV file, one row per frame. Stages that were not drawn have
+ * empty fields.
+ * @param fileName Path of the file to write.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool FrameProfiler::stopRecording(const QString &fileName) {
+  // Include the frames that are still in flight, oldest first.
+  for (int k = 0; k < FRAMES_IN_FLIGHT; k++) {
+    collect(querySlots[(frameCount + k) % FRAMES_IN_FLIGHT], true);
+  }
+  recording = false;
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    qDebug() << " * Could not open" << fileName;
+    return false;
+  }
+
+  QTextStream out(&file);
+  out << "frame,interval_ms,cpu_ms,mesh_gpu_ms,mesh_primitives,"
+         "tessellation_gpu_ms,tessellation_primitives,tile_size,tess_detail,"
+         "dynamic_lod,pixel_error,subdiv_steps,patches,frustum_culled,back_culled\n";
+  for (const FrameStats &stats : recorded) {
+    out << stats.frame << "," << stats.intervalMs << "," << stats.cpuMs;
+    for (int stage = 0; stage < NUM_GPU_STAGES; stage++) {
+      out << ",";
+      if (stats.gpuMs[stage] >= 0.0) {
+        out << stats.gpuMs[stage] << "," << stats.primitives[stage];
+      } else {
+        out << ",";
+      }
+    }
+    out << "," << stats.tileSize << "," << stats.tessDetail << ","
+        << int(stats.dynamicLoD) << "," << stats.pixelError << ","
+        << stats.subdivSteps << ","
+        << stats.numPatches << "," << stats.frustumCulled << ","
+        << stats.backCulled << "\n";
+  }
+  out.flush();
+
+  if (!file.commit()) {
+    qDebug() << " * Could not write" << fileName;
+    return false;
+  }
+  qDebug() << ":: Wrote" << recorded.size() << "frames to" << fileName;
+  recorded.clear();
+  return true;
+}
@@ -0,0 +1,115 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <QElapsedTimer>
+#include <QOpenGLFunctions_4_1_Core>
+#include <QStringList>
+#include <QVector>
+
+#include "../settings.h"
+#include "util/stagetimings.h"
+
+// Number of frames whose queries may be in flight at the same time.
+#define FRAMES_IN_FLIGHT 4
+// Number of completed frames the overlay averages over.
+#define OVERLAY_FRAMES 32
+
+/**
+ * @brief The GpuStage enum lists the draw calls that are timed on the GPU.
+ */
+enum GpuStage { MESH_DRAW, TESSELLATION_DRAW, NUM_GPU_STAGES };
+
+/**
+ * Statistics of a single frame, together with the settings it was rendered
+ * with. GPU times and primitive counts are negative for stages that were not
+ * drawn.
+ */
+typedef struct FrameStats {
+  qint64 frame = 0;
+  double intervalMs = 0.0;
+  double cpuMs = 0.0;
+  double gpuMs[NUM_GPU_STAGES];
+  qint64 primitives[NUM_GPU_STAGES];
+
+  float tileSize = 0.0f;
+  float tessDetail = 0.0f;
+  bool dynamicLoD = false;
+  // Target error of error-driven level of detail, 0 if it is not used.
+  float pixelError = 0.0f;
+  int subdivSteps = 0;
+  int numPatches = 0;
+  // Patches that were not tessellated because they are outside the view
+  // frustum or facing away from the eye.
+  int frustumCulled = 0;
+  int backCulled = 0;
+  // Set if the surface was drawn from the pretessellated capture, whose
+  // triangles do not depend on the tessellation detail.
+  bool pretessellated = false;
+} FrameStats;
+
+/**
+ * @brief The FrameProfiler class measures where the time of a frame goes. The
+ * draw calls are timed with GL timer queries and the number of primitives they
+ * generate, i.e. the number of triangles after tessellation, is counted with
+ * primitive queries. The CPU time of a frame and the durations of the stages
+ * that prepare a mesh are measured on the CPU.
+ *
+ * Query results are read a few frames later so that the CPU never waits for
+ * the GPU. The statistics can be shown as an overlay and recorded to a CSV
+ * file.
+ */
+class FrameProfiler {
+ public:
+  FrameProfiler();
+  ~FrameProfiler();
+
+  void init(QOpenGLFunctions_4_1_Core* f);
+  void reset();
+
+  void beginFrame(const Settings& settings, int numPatches);
+  void endFrame();
+  void beginStage(GpuStage stage);
+  void endStage(GpuStage stage);
+  void setCulledPatches(int frustumCulled, int backCulled);
+  void setPretessellated(bool pretessellated);
+
+  QStringList overlayLines() const;
+  bool latestFrame(FrameStats& stats) const;
+
+  void startRecording();
+  bool stopRecording(const QString& fileName);
+  inline bool isRecording() const { return recording; }
+
+  inline StageTimings& preparationTimings() { return preparation; }
+
+ private:
+  typedef struct QuerySlot {
+    GLuint timeQueries[NUM_GPU_STAGES];
+    GLuint primitiveQueries[NUM_GPU_STAGES];
+    bool issued[NUM_GPU_STAGES];
+    bool pending;
+    FrameStats stats;
+  } QuerySlot;
+
+  bool collect(QuerySlot& slot, bool wait);
+  void complete(const FrameStats& stats);
+
+  QOpenGLFunctions_4_1_Core* gl;
+
+  QuerySlot querySlots[FRAMES_IN_FLIGHT];
+  qint64 frameCount;
+  // The slot whose queries are issued in the current frame.
+  int currentSlot;
+  QElapsedTimer cpuTimer, intervalTimer;
+
+  // The most recent completed frames, used as a ring buffer.
+  QVector<FrameStats> history;
+  int historyStart;
+
+  bool recording;
+  QVector<FrameStats> recorded;
+
+  StageTimings preparation;
+};
+
+#endif  // FRAME_PROFILER_H
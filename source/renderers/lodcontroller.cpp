@@ -0,0 +1,78 @@
+#include "lodcontroller.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief LoDController::LoDController Creates a new controller.
+ */
+LoDController::LoDController() : lastFrame(-1) {}
+
+/**
+ * @brief LoDController::update Adjusts the level of detail based on a
+ * completed frame. Does nothing if the frame was processed before, if no
+ * budget is set, if the level of detail is not dynamic or if the frame was
+ * drawn from the pretessellated capture, which the detail has no effect on.
+ * @param stats The statistics of the most recent completed frame.
+ * @param settings The settings. The tessellation detail or pixel error is
+ * changed.
+ * @return True if the level of detail changed; false otherwise.
+ */
+bool LoDController::update(const FrameStats &stats, Settings &settings) {
+  if (stats.frame <= lastFrame) {
+    return false;
+  }
+  lastFrame = stats.frame;
+  if (settings.lodBudget == NO_BUDGET || !settings.dynamicLoD ||
+      !settings.tesselationMode || stats.pretessellated) {
+    return false;
+  }
+  bool errorDriven = settings.errorDrivenLoD;
+  // The frame does not show the effect of the last adjustment yet.
+  if (stats.tessDetail != settings.tessDetail ||
+      stats.pixelError != (errorDriven ? settings.pixelError : 0.0f)) {
+    return false;
+  }
+  double triangles = stats.primitives[TESSELLATION_DRAW];
+  double gpuMs = stats.gpuMs[TESSELLATION_DRAW];
+  if (triangles <= 0.0 || gpuMs <= 0.0) {
+    return false;
+  }
+
+  // The factor by which the number of triangles should change.
+  double ratio;
+  if (settings.lodBudget == TRIANGLE_BUDGET) {
+    ratio = settings.triangleBudget / triangles;
+  } else {
+    // Only the tessellation can be adjusted, so the other stages are
+    // subtracted from the budget.
+    double otherMs = std::max(stats.gpuMs[MESH_DRAW], 0.0);
+    double budgetMs = std::max(settings.gpuTimeBudget - otherMs,
+                               0.1 * settings.gpuTimeBudget);
+    ratio = budgetMs / gpuMs;
+  }
+  if (std::abs(std::log(ratio)) < std::log(1.0 + LOD_BUDGET_TOLERANCE)) {
+    return false;
+  }
+  ratio = std::pow(ratio, LOD_CONTROLLER_GAIN);
+  ratio = std::clamp(ratio, 1.0 / LOD_CONTROLLER_MAX_STEP,
+                     LOD_CONTROLLER_MAX_STEP);
+
+  if (errorDriven) {
+    float pixelError = std::clamp(float(settings.pixelError / ratio),
+                                  MIN_PIXEL_ERROR, MAX_PIXEL_ERROR);
+    if (pixelError == settings.pixelError) {
+      return false;
+    }
+    settings.pixelError = pixelError;
+  } else {
+    float tessDetail = std::clamp(float(settings.tessDetail * std::sqrt(ratio)),
+                                  MIN_TESS_DETAIL, MAX_TESS_DETAIL);
+    if (tessDetail == settings.tessDetail) {
+      return false;
+    }
+    settings.tessDetail = tessDetail;
+  }
+  settings.uniformUpdateRequired = true;
+  return true;
+}
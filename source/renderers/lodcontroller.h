@@ -0,0 +1,49 @@
+#ifndef LOD_CONTROLLER_H
+#define LOD_CONTROLLER_H
+
+#include "../settings.h"
+#include "frameprofiler.h"
+
+// Range of the tessellation detail and the pixel error the controller uses.
+#define MIN_TESS_DETAIL 1.0f
+#define MAX_TESS_DETAIL 100.0f
+#define MIN_PIXEL_ERROR 0.125f
+#define MAX_PIXEL_ERROR 16.0f
+// Relative deviation from the budget that is tolerated, so the level of detail
+// does not change every frame.
+#define LOD_BUDGET_TOLERANCE 0.05
+// Fraction of the measured correction that is applied per step, and the
+// largest factor by which the cost may change per step.
+#define LOD_CONTROLLER_GAIN 0.5
+#define LOD_CONTROLLER_MAX_STEP 2.0
+
+/**
+ * @brief The LoDBudget enum lists what the LoDController keeps within a
+ * budget.
+ */
+enum LoDBudget { NO_BUDGET, TRIANGLE_BUDGET, GPU_TIME_BUDGET, NUM_LOD_BUDGETS };
+
+/**
+ * @brief The LoDController class adjusts the dynamic level of detail such that
+ * the tessellation stays within a triangle budget or a GPU time budget. It
+ * reads back the primitive counts and GPU times of the completed frames from
+ * the FrameProfiler and scales the tessellation detail, or the pixel error if
+ * the level of detail is error-driven.
+ *
+ * The number of triangles grows with the square of the tessellation detail
+ * and with the inverse of the pixel error, and the GPU time is assumed to grow
+ * with the number of triangles. Results arrive a few frames late, so frames
+ * that were rendered before the last adjustment are ignored.
+ */
+class LoDController {
+ public:
+  LoDController();
+
+  bool update(const FrameStats& stats, Settings& settings);
+
+ private:
+  // The number of the last frame that was processed.
+  qint64 lastFrame;
+};
+
+#endif  // LOD_CONTROLLER_H
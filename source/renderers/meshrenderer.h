@@ -4,6 +4,7 @@
 #include <QOpenGLShaderProgram>
 
 #include "../mesh/mesh.h"
+#include "dynamicbuffer.h"
 #include "renderer.h"
 
 /**
@@ -25,12 +26,10 @@ protected:
 
 private:
   GLuint vao;
-  GLuint meshCoordsBO, meshNormalsBO, meshIndexBO;
-  int meshIBOSize;
+  DynamicBuffer<unsigned int> meshIndices;
 
-  // Uniforms
-  GLint uniModelViewMatrix, uniProjectionMatrix, uniNormalMatrix;
-  GLint uniShadingMode;
+  // Uniforms that are not in the settings block
+  GLint uniMeshShadingMode;
 };
 
 #endif // MESHRENDERER_H
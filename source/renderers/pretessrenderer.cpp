@@ -0,0 +1,560 @@
+#include "pretessrenderer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QtMath>
+#include <cmath>
+
+#include "tessrenderer.h"
+
+// The maximum tessellation level that every GL 4.1 implementation supports.
+#define MAX_CAPTURE_LEVEL 64
+// The maximum size of either capture buffer in bytes.
+#define MAX_CAPTURE_BYTES (qint64(512) << 20)
+
+/**
+ * @brief PretessellatedRenderer::PretessellatedRenderer Creates a new
+ * pretessellated renderer.
+ */
+PretessellatedRenderer::PretessellatedRenderer()
+    : captureShaders{nullptr, nullptr}, meshChanged(false), captured(false) {}
+
+/**
+ * @brief PretessellatedRenderer::~PretessellatedRenderer Deconstructor.
+ */
+PretessellatedRenderer::~PretessellatedRenderer() {
+  for (Capture &target : captures) {
+    gl->glDeleteTransformFeedbacks(1, &target.transformFeedback);
+    gl->glDeleteBuffers(1, &target.buffer);
+    gl->glDeleteVertexArrays(1, &target.vao);
+    gl->glDeleteVertexArrays(1, &target.patchVao);
+  }
+  gl->glDeleteQueries(1, &primitivesQuery);
+  gl->glDeleteQueries(1, &generatedQuery);
+  delete captureShaders[0];
+  delete captureShaders[1];
+}
+
+/**
+ * @brief PretessellatedRenderer::initShaders Initializes the shaders. The
+ * captured vertices carry their own normals, so the shaders of the mesh
+ * renderer suffice to draw them.
+ */
+void PretessellatedRenderer::initShaders() {
+  shaders.insert(ShaderType::PHONG, constructDefaultShader("phong"));
+  uniMeshShadingMode =
+      shaders[ShaderType::PHONG]->uniformLocation("mesh_shading_mode");
+
+  for (int irregular = 0; irregular < 2; irregular++) {
+    QOpenGLShaderProgram *shader = constructCaptureShader(irregular);
+    captureShaders[irregular] = shader;
+    uniLevelScale[irregular] = shader->uniformLocation("levelScale");
+    uniIrregular[irregular] = shader->uniformLocation("irregular");
+    uniDomainOffset[irregular] = shader->uniformLocation("domainOffset");
+    uniDomainScale[irregular] = shader->uniformLocation("domainScale");
+  }
+}
+
+/**
+ * @brief PretessellatedRenderer::constructCaptureShader Constructs the program
+ * that captures the displaced surface: the vertex and tessellation evaluation
+ * shaders of the displaced surface with capture.tesc. It has no fragment
+ * shader, since nothing is rasterized while capturing.
+ * @param irregular Whether the program captures the patches of irregular
+ * faces, which are evaluated with the Bezier basis.
+ * @return The constructed shader.
+ */
+QOpenGLShaderProgram *
+PretessellatedRenderer::constructCaptureShader(bool irregular) const {
+  QOpenGLShaderProgram *shader = new QOpenGLShaderProgram();
+  addShaderFile(shader, QOpenGLShader::Vertex, ":/shaders/displace.vert");
+  addShaderFile(shader, QOpenGLShader::TessellationControl,
+                ":/shaders/capture.tesc");
+  addShaderFile(shader, QOpenGLShader::TessellationControl,
+                ":/shaders/patchbounds.glsl");
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation,
+                ":/shaders/displace.tese");
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation,
+                irregular ? ":/shaders/bezier.glsl" : ":/shaders/bspline.glsl");
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation,
+                ":/shaders/procedural.glsl");
+
+  // The varyings have to be chosen before linking.
+  static const char *varyings[] = {"displacedcoords", "displacednormal"};
+  gl->glTransformFeedbackVaryings(shader->programId(), 2, varyings,
+                                  GL_INTERLEAVED_ATTRIBS);
+  linkShader(shader);
+
+  shader->bind();
+  shader->setUniformValue("coefficientTexture", COEFFICIENT_TEXTURE_UNIT);
+  shader->setUniformValue("patchBounds", PATCH_BOUNDS_TEXTURE_UNIT);
+  shader->release();
+  return shader;
+}
+
+/**
+ * @brief PretessellatedRenderer::initBuffers Initializes the buffers. The
+ * patches are captured from their own index and control point buffers, and
+ * the captured vertices are drawn from the transform feedback buffers.
+ */
+void PretessellatedRenderer::initBuffers() {
+  patchIndices.create(gl);
+  irregularPatches.create(gl);
+  gl->glGenQueries(1, &primitivesQuery);
+  gl->glGenQueries(1, &generatedQuery);
+
+  for (Capture &target : captures) {
+    gl->glGenBuffers(1, &target.buffer);
+    gl->glGenTransformFeedbacks(1, &target.transformFeedback);
+    gl->glBindTransformFeedback(GL_TRANSFORM_FEEDBACK,
+                                target.transformFeedback);
+    gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, target.buffer);
+    gl->glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    gl->glGenVertexArrays(1, &target.vao);
+    gl->glBindVertexArray(target.vao);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, target.buffer);
+    GLsizei stride = 2 * sizeof(QVector3D);
+    gl->glEnableVertexAttribArray(0);
+    gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    gl->glEnableVertexAttribArray(1);
+    gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void *>(sizeof(QVector3D)));
+    gl->glBindVertexArray(0);
+  }
+
+  // The regular patches index the shared vertex buffers.
+  gl->glGenVertexArrays(1, &captures[0].patchVao);
+  gl->glBindVertexArray(captures[0].patchVao);
+  vertexBuffers->bindAttributes();
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchIndices.id());
+  gl->glBindVertexArray(0);
+
+  // The irregular patches have their own control points, without normals.
+  gl->glGenVertexArrays(1, &captures[1].patchVao);
+  gl->glBindVertexArray(captures[1].patchVao);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, irregularPatches.id());
+  gl->glEnableVertexAttribArray(0);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief PretessellatedRenderer::updateBuffers Stores the patches of the
+ * provided mesh. They are captured when they are drawn for the first time.
+ * @param mesh The mesh to tessellate.
+ * @param patchBVH The hierarchy over the regular patches of the mesh, as built
+ * by the MeshPipeline. A null pointer stands for a mesh without patches.
+ */
+void PretessellatedRenderer::updateBuffers(
+    Mesh &mesh, const QSharedPointer<const PatchBVH> &patchBVH) {
+  patchCoords = mesh.getVertexCoords();
+  orderedPatchIndices.clear();
+  bvh = patchBVH;
+  if (!bvh.isNull()) {
+    orderedPatchIndices =
+        bvh->orderedPatchIndices(mesh.getRegularPatchIndices());
+  }
+  patchIndices.upload(orderedPatchIndices);
+  irregularPatches.upload(mesh.getIrregularPatchCoords());
+  captures[0].patches = bvh.isNull() ? 0 : bvh->numPatches();
+  captures[1].patches = irregularPatches.size() / 16;
+  meshChanged = true;
+}
+
+/**
+ * @brief PretessellatedRenderer::currentKey Collects the settings that
+ * determine the tessellation.
+ * @return The settings.
+ */
+PretessellatedRenderer::TessellationKey PretessellatedRenderer::currentKey()
+    const {
+  TessellationKey key;
+  key.displacementMode = settings->displacement_mode;
+  key.amplitude = settings->amplitude;
+  key.tileSize = settings->tileSize;
+  key.density = settings->tessDensity;
+  key.trueNormals = settings->normal_mode == 0;
+  key.baked = settings->bakedDisplacement;
+  return key;
+}
+
+/**
+ * @brief captureLevels Computes the tessellation levels of a patch in tiles,
+ * the same as capture.tesc does before it applies the density.
+ * @param bounds The bounds of a regular patch, or a null pointer for the patch
+ * of an irregular face.
+ * @param tileSize The tile size.
+ * @param outer The levels of the sides where the patch meets other patches.
+ * @return The inner level, which is also used for the sides between the
+ * subdomains of the patch.
+ */
+static float captureLevels(const PatchBounds *bounds, float tileSize,
+                           float outer[4]) {
+  float level = bounds == nullptr ? tileSize : tileSize * bounds->tileScale;
+  for (int k = 0; k < 4; k++) {
+    outer[k] = level;
+    if (bounds == nullptr) {
+      continue;
+    }
+    // See transitionLevels() and irregularLevels() in patchbounds.glsl.
+    float edgeScale = bounds->edgeTileScale[k];
+    if (edgeScale > 0.0f) {
+      float coarse = std::exp2(
+          std::ceil(std::log2(std::max(tileSize * edgeScale, 1.0f)) - 1e-3f));
+      coarse = std::min(std::max(coarse, 2.0f * edgeScale),
+                        float(MAX_CAPTURE_LEVEL));
+      outer[k] = coarse * bounds->tileScale / edgeScale;
+    }
+    if ((bounds->irregularSides & (1 << k)) != 0) {
+      outer[k] = tileSize;
+    }
+  }
+  return level;
+}
+
+/**
+ * @brief evenSegments Computes the number of segments of a side with
+ * fractional even spacing: the level rounded up to an even number.
+ * @param level The tessellation level, before it is clamped.
+ * @return The number of segments.
+ */
+static qint64 evenSegments(float level) {
+  level = std::clamp(level, 1.0f, float(MAX_CAPTURE_LEVEL));
+  return 2 * qint64(std::ceil(level / 2.0f));
+}
+
+/**
+ * @brief PretessellatedRenderer::capture Captures the displaced surface of
+ * either kind of patches into its buffer. The buffer is sized for the exact
+ * number of triangles: with fractional even spacing, a quad with n segments
+ * along the inner levels has 2 (n - 2)^2 triangles inside its outer ring, and
+ * n - 2 + m triangles along a side with m segments.
+ * @param target The capture of the patches.
+ * @param irregular Whether the patches are those of irregular faces.
+ * @param domains Number of subdomains of every patch in either direction.
+ * @return False if the buffer exceeds MAX_CAPTURE_BYTES, could not be
+ * allocated or overflowed, in which case it is left empty.
+ */
+bool PretessellatedRenderer::capture(Capture &target, bool irregular,
+                                     int domains) {
+  float levelScale = float(settings->tessDensity) / domains;
+  qint64 triangles = 0;
+  for (int p = 0; p < target.patches; p++) {
+    float outer[4];
+    float inner = captureLevels(irregular ? nullptr : &bvh->getBounds(p),
+                                settings->tileSize, outer);
+    qint64 n = evenSegments(inner * levelScale);
+    triangles +=
+        qint64(domains) * domains * (2 * (n - 2) * (n - 2) + 4 * (n - 2));
+    // Only the outer subdomains have the sides of the patch, the others have
+    // the inner level on all sides.
+    for (int k = 0; k < 4; k++) {
+      triangles += domains * evenSegments(outer[k] * levelScale) +
+                   qint64(domains) * (domains - 1) * n;
+    }
+  }
+
+  target.triangles = 0;
+  qint64 bytes = qint64(6 * sizeof(QVector3D)) * triangles;
+  if (bytes > MAX_CAPTURE_BYTES) {
+    qDebug() << " * Capturing" << triangles << "triangles takes" << bytes
+             << "bytes, more than the limit of" << MAX_CAPTURE_BYTES;
+    releaseBuffer(target);
+    return false;
+  }
+  // Discards the errors of earlier calls, so that only those of the capture
+  // are checked.
+  while (gl->glGetError() != GL_NO_ERROR) {
+  }
+  gl->glBindBuffer(GL_ARRAY_BUFFER, target.buffer);
+  gl->glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(bytes), nullptr,
+                   GL_STATIC_COPY);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+  GLenum error = gl->glGetError();
+  if (error != GL_NO_ERROR) {
+    qDebug() << " * Could not allocate" << bytes
+             << "bytes for the capture, error" << error;
+    releaseBuffer(target);
+    return false;
+  }
+  if (triangles == 0) {
+    return true;
+  }
+
+  QOpenGLShaderProgram *shader = captureShaders[irregular];
+  shader->bind();
+  gl->glUniform1f(uniLevelScale[irregular], levelScale);
+  gl->glUniform1i(uniIrregular[irregular], irregular);
+  gl->glUniform1f(uniDomainScale[irregular], 1.0f / domains);
+
+  gl->glBindVertexArray(target.patchVao);
+  gl->glPatchParameteri(GL_PATCH_VERTICES, 16);
+  gl->glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, target.transformFeedback);
+  gl->glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, primitivesQuery);
+  gl->glBeginQuery(GL_PRIMITIVES_GENERATED, generatedQuery);
+  gl->glBeginTransformFeedback(GL_TRIANGLES);
+  for (int i = 0; i < domains; i++) {
+    for (int j = 0; j < domains; j++) {
+      gl->glUniform2f(uniDomainOffset[irregular], i, j);
+      if (irregular) {
+        gl->glDrawArrays(GL_PATCHES, 0, 16 * target.patches);
+      } else {
+        gl->glDrawElements(GL_PATCHES, 16 * target.patches, GL_UNSIGNED_INT,
+                           nullptr);
+      }
+    }
+  }
+  gl->glEndTransformFeedback();
+  gl->glEndQuery(GL_PRIMITIVES_GENERATED);
+  gl->glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+  gl->glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+  gl->glBindVertexArray(0);
+  shader->release();
+
+  GLuint written = 0;
+  GLuint generated = 0;
+  gl->glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, &written);
+  gl->glGetQueryObjectuiv(generatedQuery, GL_QUERY_RESULT, &generated);
+  error = gl->glGetError();
+  if (error != GL_NO_ERROR || written < generated) {
+    // The buffer overflowed if fewer triangles were written than generated,
+    // which leaves holes in the surface.
+    qDebug() << " * Captured" << written << "of" << generated
+             << "triangles, error" << error;
+    releaseBuffer(target);
+    return false;
+  }
+  target.triangles = written;
+  if (written != triangles) {
+    qDebug() << " * Captured" << written << "triangles instead of"
+             << triangles;
+  }
+  return true;
+}
+
+/**
+ * @brief PretessellatedRenderer::releaseBuffer Frees the memory of a capture
+ * that failed, such that nothing is drawn from it.
+ * @param target The capture.
+ */
+void PretessellatedRenderer::releaseBuffer(Capture &target) {
+  target.triangles = 0;
+  gl->glBindBuffer(GL_ARRAY_BUFFER, target.buffer);
+  gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_COPY);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief PretessellatedRenderer::tessellate Captures the patches with the
+ * current settings. Every patch is split into the same number of subdomains,
+ * such that the highest level of any patch stays within the hardware limit.
+ */
+void PretessellatedRenderer::tessellate() {
+  QElapsedTimer timer;
+  timer.start();
+  // The patches of irregular faces have the tile size on all sides.
+  float maxLevel = settings->tileSize;
+  for (int p = 0; p < captures[0].patches; p++) {
+    float outer[4];
+    maxLevel = std::max(
+        maxLevel, captureLevels(&bvh->getBounds(p), settings->tileSize, outer));
+    for (float level : outer) {
+      maxLevel = std::max(maxLevel, level);
+    }
+  }
+  maxLevel *= settings->tessDensity;
+  int domains = std::max(1, int(std::ceil(maxLevel / MAX_CAPTURE_LEVEL)));
+
+  gl->glEnable(GL_RASTERIZER_DISCARD);
+  captured = capture(captures[0], false, domains) &&
+             capture(captures[1], true, domains);
+  gl->glDisable(GL_RASTERIZER_DISCARD);
+
+  // A failed capture is not repeated until the mesh or the settings change.
+  tessellatedKey = currentKey();
+  meshChanged = false;
+  if (!captured) {
+    releaseBuffer(captures[0]);
+    releaseBuffer(captures[1]);
+    qDebug() << ":: Capture failed after" << timer.elapsed() << "ms";
+    return;
+  }
+  qDebug() << ":: Captured" << numTriangles() << "triangles in"
+           << domains * domains << "subdomains per patch in" << timer.elapsed()
+           << "ms";
+}
+
+/**
+ * @brief PretessellatedRenderer::updateUniforms Updates the uniforms in the
+ * shader that are not part of the shared settings block. The approximate
+ * normal error cannot be shown, so it falls back to Phong shading.
+ */
+void PretessellatedRenderer::updateUniforms() {
+  gl->glUniform1i(uniMeshShadingMode, settings->shading_mode == 1 ? 1 : 0);
+}
+
+/**
+ * @brief PretessellatedRenderer::updateTessellation Captures the patches if
+ * the mesh or the settings changed since they were last captured. Should be
+ * called before draw(), after the baked coefficients are up to date.
+ * @return False if the capture failed, in which case the surface should be
+ * drawn by the TessellationRenderer instead.
+ */
+bool PretessellatedRenderer::updateTessellation() {
+  TessellationKey key = currentKey();
+  if (meshChanged || key.displacementMode != tessellatedKey.displacementMode ||
+      key.amplitude != tessellatedKey.amplitude ||
+      key.tileSize != tessellatedKey.tileSize ||
+      key.density != tessellatedKey.density ||
+      key.trueNormals != tessellatedKey.trueNormals ||
+      key.baked != tessellatedKey.baked) {
+    tessellate();
+  }
+  return captured;
+}
+
+/**
+ * @brief PretessellatedRenderer::draw Draw call. Draws the captured triangles.
+ */
+void PretessellatedRenderer::draw() {
+  shaders[ShaderType::PHONG]->bind();
+  // The uniform is not part of the settings block, so it is set every frame.
+  updateUniforms();
+
+  for (const Capture &target : captures) {
+    if (target.triangles > 0) {
+      gl->glBindVertexArray(target.vao);
+      gl->glDrawTransformFeedback(GL_TRIANGLES, target.transformFeedback);
+    }
+  }
+  gl->glBindVertexArray(0);
+
+  shaders[ShaderType::PHONG]->release();
+}
+
+/**
+ * @brief PretessellatedRenderer::configureTessellator Applies the settings of
+ * the captured tessellation to a Tessellator.
+ * @param tessellator The tessellator.
+ */
+void PretessellatedRenderer::configureTessellator(
+    Tessellator &tessellator) const {
+  tessellator.setDisplacement(ProceduralDisplacement(
+      tessellatedKey.displacementMode, tessellatedKey.amplitude));
+  tessellator.setTileSize(tessellatedKey.tileSize);
+  tessellator.setDensity(tessellatedKey.density);
+  tessellator.setTrueNormals(tessellatedKey.trueNormals);
+  tessellator.setBakedCoefficients(tessellatedKey.baked);
+}
+
+/**
+ * @brief cellKey Finds the cell of a uniform grid that contains a point.
+ * @param point The point.
+ * @param cellSize The size of the cells.
+ * @param offset Offset added to the cell coordinates.
+ * @return A key that identifies the cell.
+ */
+static qint64 cellKey(const QVector3D &point, float cellSize,
+                      int offset[3] = nullptr) {
+  qint64 key = 0;
+  for (int c = 0; c < 3; c++) {
+    qint64 cell = qint64(std::floor(point[c] / cellSize));
+    cell += offset != nullptr ? offset[c] : 0;
+    key = key * 2097152 + (cell & 2097151);
+  }
+  return key;
+}
+
+/**
+ * @brief PretessellatedRenderer::compareWithTessellator Reads the captured
+ * regular patches back and compares them to the same patches tessellated by
+ * the Tessellator on the CPU. Both produce the same vertices if the levels
+ * per subdomain are even whole numbers; the Tessellator ignores the levels of
+ * adaptively subdivided meshes, though. Prints the result as well.
+ * @param result The number of triangles of both, the maximum distance from a
+ * captured vertex to the nearest vertex of the Tessellator and the maximum
+ * angle between their normals.
+ * @return False if there is nothing to compare.
+ */
+bool PretessellatedRenderer::compareWithTessellator(
+    CaptureComparison &result) {
+  result = CaptureComparison();
+  const Capture &target = captures[0];
+  if (meshChanged || target.triangles == 0) {
+    qDebug() << " * Nothing captured to compare";
+    return false;
+  }
+  QVector<QVector3D> vertices(6 * target.triangles);
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, target.buffer);
+  gl->glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                         GLsizeiptr(sizeof(QVector3D)) * vertices.size(),
+                         vertices.data());
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+  Tessellator tessellator;
+  configureTessellator(tessellator);
+  TessellatedMesh mesh =
+      tessellator.tessellate(patchCoords, orderedPatchIndices);
+  if (mesh.numVerts() == 0) {
+    return false;
+  }
+
+  // The vertices of the Tessellator in a grid whose cells are small compared
+  // to the mesh, but large compared to the expected differences.
+  QVector3D lower = mesh.coords[0];
+  QVector3D upper = mesh.coords[0];
+  for (const QVector3D &coords : mesh.coords) {
+    for (int c = 0; c < 3; c++) {
+      lower[c] = std::min(lower[c], coords[c]);
+      upper[c] = std::max(upper[c], coords[c]);
+    }
+  }
+  float cellSize = std::max(1e-3f * (upper - lower).length(), 1e-6f);
+  QMultiHash<qint64, int> grid;
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    grid.insert(cellKey(mesh.coords[v], cellSize), v);
+  }
+
+  float maxDistance = 0.0f;
+  float maxAngle = 0.0f;
+  int unmatched = 0;
+  for (int k = 0; k < vertices.size(); k += 2) {
+    const QVector3D &coords = vertices[k];
+    int nearest = -1;
+    float nearestDistance = cellSize;
+    for (int neighbour = 0; neighbour < 27; neighbour++) {
+      int offset[3] = {neighbour % 3 - 1, neighbour / 3 % 3 - 1,
+                       neighbour / 9 - 1};
+      auto range = grid.equal_range(cellKey(coords, cellSize, offset));
+      for (auto it = range.first; it != range.second; ++it) {
+        float distance = (mesh.coords[it.value()] - coords).length();
+        if (distance <= nearestDistance) {
+          nearest = it.value();
+          nearestDistance = distance;
+        }
+      }
+    }
+    if (nearest < 0) {
+      unmatched++;
+      continue;
+    }
+    float cosine =
+        QVector3D::dotProduct(mesh.normals[nearest], vertices[k + 1]);
+    maxDistance = std::max(maxDistance, nearestDistance);
+    maxAngle = std::max(maxAngle, std::acos(std::clamp(cosine, -1.0f, 1.0f)));
+  }
+  result.capturedTriangles = target.triangles;
+  result.tessellatedTriangles = mesh.numTriangles();
+  result.maxDistance = maxDistance;
+  result.maxAngle = qRadiansToDegrees(maxAngle);
+  result.unmatched = unmatched;
+  result.matchDistance = cellSize;
+  qDebug() << ":: Captured" << result.capturedTriangles
+           << "triangles, the Tessellator" << result.tessellatedTriangles
+           << "; max distance" << result.maxDistance << ", max normal angle"
+           << result.maxAngle << "degrees," << result.unmatched
+           << "vertices without a match within" << result.matchDistance;
+  return true;
+}
@@ -0,0 +1,137 @@
+#ifndef PRETESSRENDERER_H
+#define PRETESSRENDERER_H
+
+#include <QOpenGLShaderProgram>
+#include <QSharedPointer>
+
+#include "../evaluation/patchbvh.h"
+#include "../evaluation/tessellator.h"
+#include "../mesh/mesh.h"
+#include "dynamicbuffer.h"
+#include "renderer.h"
+
+/**
+ * The result of PretessellatedRenderer::compareWithTessellator().
+ */
+typedef struct CaptureComparison {
+  qint64 capturedTriangles = 0;
+  qint64 tessellatedTriangles = 0;
+  // Maximum distance from a captured vertex to the nearest vertex of the
+  // Tessellator, and the maximum angle between their normals in degrees.
+  float maxDistance = 0.0f;
+  float maxAngle = 0.0f;
+  // Number of captured vertices without a vertex of the Tessellator within
+  // matchDistance.
+  int unmatched = 0;
+  float matchDistance = 0.0f;
+} CaptureComparison;
+
+/**
+ * @brief The PretessellatedRenderer class renders the displaced surface
+ * without tessellating it every frame. The patches are tessellated by
+ * displace.tese once, and its output is captured with transform feedback into
+ * a vertex buffer. The capture is only repeated when the mesh or the
+ * displacement settings change, so other frames are a single draw call.
+ *
+ * The level of detail is fixed: the tessellation level is the tile size times
+ * the density, the same as the Tessellator. The sides where patches of
+ * different levels meet get the same levels as in the TessellationRenderer,
+ * so adaptive meshes do not crack there. Levels above the hardware limit
+ * are reached by capturing every patch in several subdomains. The regular
+ * patches and the patches of irregular faces are captured into separate
+ * buffers, since they are tessellated by separate programs.
+ *
+ * The patch bounds and the baked coefficients are read from the textures of
+ * the TessellationRenderer, see PATCH_BOUNDS_TEXTURE_UNIT and
+ * COEFFICIENT_TEXTURE_UNIT.
+ *
+ * The capture is limited to MAX_CAPTURE_BYTES per buffer. If it exceeds the
+ * limit or the buffer cannot be filled, nothing is drawn and
+ * updateTessellation() reports the failure, so that the caller can fall back
+ * to the TessellationRenderer.
+ */
+class PretessellatedRenderer : public Renderer {
+public:
+  PretessellatedRenderer();
+  ~PretessellatedRenderer() override;
+
+  void updateBuffers(Mesh &m, const QSharedPointer<const PatchBVH> &patchBVH);
+  bool updateTessellation();
+  void draw();
+  bool compareWithTessellator(CaptureComparison &result);
+
+  inline qint64 numTriangles() const {
+    return captures[0].triangles + captures[1].triangles;
+  }
+
+protected:
+  void initShaders() override;
+  void initBuffers() override;
+  QOpenGLShaderProgram *constructCaptureShader(bool irregular) const;
+  void updateUniforms();
+  void tessellate();
+
+private:
+  /**
+   * The settings the cached tessellation was computed with.
+   */
+  typedef struct TessellationKey {
+    int displacementMode = -1;
+    float amplitude = 0.0f;
+    float tileSize = 0.0f;
+    int density = 0;
+    bool trueNormals = false;
+    bool baked = false;
+  } TessellationKey;
+
+  /**
+   * The captured triangles of either kind of patches: three vertices per
+   * triangle, each an interleaved coordinate and normal. The triangles are not
+   * indexed, since transform feedback writes every vertex of every primitive
+   * and GL 4.1 has no compute shaders to weld the shared vertices on the GPU.
+   * A capture therefore takes about six times the memory of an indexed mesh.
+   */
+  typedef struct Capture {
+    GLuint transformFeedback = 0;
+    GLuint buffer = 0;
+    GLuint vao = 0;
+    // Number of patches and the vertex array object they are drawn with.
+    int patches = 0;
+    GLuint patchVao = 0;
+    qint64 triangles = 0;
+  } Capture;
+
+  TessellationKey currentKey() const;
+  bool capture(Capture &target, bool irregular, int domains);
+  void releaseBuffer(Capture &target);
+  void configureTessellator(Tessellator &tessellator) const;
+
+  // The regular patches and the patches of irregular faces.
+  Capture captures[2];
+  QOpenGLShaderProgram *captureShaders[2];
+  GLint uniLevelScale[2], uniIrregular[2], uniDomainOffset[2],
+      uniDomainScale[2];
+  // Count the captured triangles and the triangles that were generated, which
+  // are more if the buffer overflowed.
+  GLuint primitivesQuery, generatedQuery;
+  // The patches in the order of the hierarchy, which is the order of the
+  // patch bounds.
+  DynamicBuffer<unsigned int> patchIndices;
+  DynamicBuffer<QVector3D> irregularPatches;
+
+  // The regular patches of the current mesh for the comparison with the
+  // Tessellator, and the hierarchy that holds their bounds. The hierarchy is
+  // null if the mesh has no patches.
+  QVector<QVector3D> patchCoords;
+  QVector<unsigned int> orderedPatchIndices;
+  QSharedPointer<const PatchBVH> bvh;
+  bool meshChanged;
+  TessellationKey tessellatedKey;
+  // Whether the last capture succeeded.
+  bool captured;
+
+  // Uniforms that are not in the settings block
+  GLint uniMeshShadingMode;
+};
+
+#endif // PRETESSRENDERER_H
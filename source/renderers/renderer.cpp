@@ -1,9 +1,12 @@
 #include "renderer.h"
 
+#include <QDebug>
+#include <QFile>
+
 /**
  * @brief Renderer::Renderer Creates a new renderer.
  */
-Renderer::Renderer() : gl(nullptr) {}
+Renderer::Renderer() : gl(nullptr), vertexBuffers(nullptr) {}
 
 /**
  * @brief Renderer::~Renderer Deconstructs the renderer by deleting all shaders.
@@ -11,14 +14,18 @@ Renderer::Renderer() : gl(nullptr) {}
 Renderer::~Renderer() { qDeleteAll(shaders); }
 
 /**
- * @brief Renderer::init Initialises the renderer with an OpenGL context and
- * settings. Also initialises the shaders and buffers.
+ * @brief Renderer::init Initialises the renderer with an OpenGL context,
+ * settings and the shared vertex buffers. Also initialises the shaders and
+ * buffers.
  * @param f OpenGL functions pointer.
  * @param s Settings.
+ * @param v The vertex buffers. Should already be initialised.
  */
-void Renderer::init(QOpenGLFunctions_4_1_Core *f, Settings *s) {
+void Renderer::init(QOpenGLFunctions_4_1_Core *f, Settings *s,
+                    VertexBuffers *v) {
   gl = f;
   settings = s;
+  vertexBuffers = v;
 
   initShaders();
   initBuffers();
@@ -40,9 +47,57 @@ Renderer::constructDefaultShader(const QString &name) const {
 
   // we use the qt wrapper functions for shader objects
   QOpenGLShaderProgram *shader = new QOpenGLShaderProgram();
-  shader->addShaderFromSourceFile(QOpenGLShader::Vertex, pathVert);
-  shader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathFrag);
-  shader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathShading);
-  shader->link();
+  addShaderFile(shader, QOpenGLShader::Vertex, pathVert);
+  addShaderFile(shader, QOpenGLShader::Fragment, pathFrag);
+  addShaderFile(shader, QOpenGLShader::Fragment, pathShading);
+  linkShader(shader);
   return shader;
 }
+
+/**
+ * @brief Renderer::addShaderFile Compiles a shader from a file and adds it to a
+ * program. The declaration of the settings block in uniforms.glsl is inserted
+ * after the #version directive, so every shader can use the settings.
+ * @param shader The program.
+ * @param type The type of the shader.
+ * @param path Path of the source file.
+ */
+void Renderer::addShaderFile(QOpenGLShaderProgram *shader,
+                             QOpenGLShader::ShaderType type,
+                             const QString &path) const {
+  QFile sourceFile(path);
+  QFile uniformsFile(":/shaders/uniforms.glsl");
+  if (!sourceFile.open(QIODevice::ReadOnly | QIODevice::Text) ||
+      !uniformsFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    qDebug() << " * Could not read" << path;
+    return;
+  }
+  QByteArray source = sourceFile.readAll();
+
+  // The #version directive has to come first. The #line directive keeps the
+  // line numbers of compile errors the same.
+  int versionEnd = 0;
+  int line = 1;
+  if (source.startsWith("#version")) {
+    versionEnd = source.indexOf('\n') + 1;
+    line = 2;
+  }
+  source.insert(versionEnd, uniformsFile.readAll() + "#line " +
+                                QByteArray::number(line) + "\n");
+  shader->addShaderFromSourceCode(type, source);
+}
+
+/**
+ * @brief Renderer::linkShader Links a program and connects its settings block
+ * to the shared uniform buffer.
+ * @param shader The program.
+ */
+void Renderer::linkShader(QOpenGLShaderProgram *shader) const {
+  shader->link();
+  GLuint blockIndex =
+      gl->glGetUniformBlockIndex(shader->programId(), "SettingsBlock");
+  if (blockIndex != GL_INVALID_INDEX) {
+    gl->glUniformBlockBinding(shader->programId(), blockIndex,
+                              SETTINGS_BINDING);
+  }
+}
@@ -6,6 +6,8 @@
 
 #include "../settings.h"
 #include "../shadertypes.h"
+#include "settingsbuffer.h"
+#include "vertexbuffers.h"
 
 /**
  * @brief The Renderer class represents a generic renderer class. The class is
@@ -22,12 +24,16 @@ public:
   virtual void initBuffers() = 0;
 
   QOpenGLShaderProgram *constructDefaultShader(const QString &name) const;
-  void init(QOpenGLFunctions_4_1_Core *f, Settings *s);
+  void addShaderFile(QOpenGLShaderProgram *shader,
+                     QOpenGLShader::ShaderType type, const QString &path) const;
+  void linkShader(QOpenGLShaderProgram *shader) const;
+  void init(QOpenGLFunctions_4_1_Core *f, Settings *s, VertexBuffers *v);
 
 protected:
   QMap<ShaderType, QOpenGLShaderProgram *> shaders;
   QOpenGLFunctions_4_1_Core *gl;
   Settings *settings;
+  VertexBuffers *vertexBuffers;
 };
 
 #endif // RENDERER_H
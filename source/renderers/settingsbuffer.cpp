@@ -0,0 +1,100 @@
+#include "settingsbuffer.h"
+
+#include <cstring>
+
+/**
+ * @brief SettingsBuffer::SettingsBuffer Creates a new settings buffer. It has
+ * to be initialised with an OpenGL context before it can be used.
+ */
+SettingsBuffer::SettingsBuffer() : gl(nullptr), buffer(0) {
+  std::memset(&block, 0, sizeof(SettingsBlock));
+}
+
+/**
+ * @brief SettingsBuffer::~SettingsBuffer Deletes the buffer. Assumes the
+ * context it was initialised with is current.
+ */
+SettingsBuffer::~SettingsBuffer() {
+  if (gl != nullptr) {
+    gl->glDeleteBuffers(1, &buffer);
+  }
+}
+
+/**
+ * @brief SettingsBuffer::init Creates the uniform buffer in the current
+ * context and binds it to the binding point of the settings blocks, where it
+ * remains bound.
+ * @param f OpenGL functions pointer.
+ */
+void SettingsBuffer::init(QOpenGLFunctions_4_1_Core *f) {
+  gl = f;
+  gl->glGenBuffers(1, &buffer);
+  gl->glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(SettingsBlock), &block,
+                   GL_DYNAMIC_DRAW);
+  gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  gl->glBindBufferBase(GL_UNIFORM_BUFFER, SETTINGS_BINDING, buffer);
+}
+
+/**
+ * @brief SettingsBuffer::update Packs the settings and uploads the range of
+ * the buffer that differs from the previous upload.
+ * @param settings The settings.
+ */
+void SettingsBuffer::update(const Settings &settings) {
+  SettingsBlock next;
+  std::memset(&next, 0, sizeof(SettingsBlock));
+  std::memcpy(next.modelViewMatrix, settings.modelViewMatrix.constData(),
+              sizeof(next.modelViewMatrix));
+  std::memcpy(next.projectionMatrix, settings.projectionMatrix.constData(),
+              sizeof(next.projectionMatrix));
+  const float *normalMatrix = settings.normalMatrix.constData();
+  for (int column = 0; column < 3; column++) {
+    std::memcpy(&next.normalMatrix[4 * column], &normalMatrix[3 * column],
+                3 * sizeof(GLfloat));
+  }
+
+  next.tileSize = settings.tileSize;
+  next.tessDetail = settings.tessDetail;
+  next.amplitude = settings.amplitude;
+  next.dynamicLoD = settings.dynamicLoD;
+
+  next.displacementMode = settings.displacement_mode;
+  next.shadingMode = settings.shading_mode;
+  next.normalMode = settings.normal_mode;
+  next.bakedDisplacement = settings.bakedDisplacement;
+
+  QVector3D eye = settings.modelViewMatrix.inverted().map(QVector3D());
+  next.eyePosition[0] = eye.x();
+  next.eyePosition[1] = eye.y();
+  next.eyePosition[2] = eye.z();
+  next.backPatchCulling = settings.backPatchCulling;
+
+  // An error of e at distance d covers e / d * P(1,1) * height / 2 pixels.
+  next.errorDrivenLoD = settings.errorDrivenLoD;
+  next.lodErrorScale = settings.projectionMatrix(1, 1) *
+                       settings.viewportHeight / (2.0f * settings.pixelError);
+
+  // Find the first and last byte that changed.
+  const char *current = reinterpret_cast<const char *>(&block);
+  const char *changed = reinterpret_cast<const char *>(&next);
+  int begin = 0;
+  int end = sizeof(SettingsBlock);
+  while (begin < end && current[begin] == changed[begin]) {
+    begin++;
+  }
+  while (end > begin && current[end - 1] == changed[end - 1]) {
+    end--;
+  }
+  if (begin == end) {
+    return;
+  }
+  // Upload whole components.
+  begin -= begin % 4;
+  end += (4 - end % 4) % 4;
+
+  block = next;
+  gl->glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  gl->glBufferSubData(GL_UNIFORM_BUFFER, begin, end - begin, changed + begin);
+  gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
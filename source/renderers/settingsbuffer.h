@@ -0,0 +1,61 @@
+#ifndef SETTINGS_BUFFER_H
+#define SETTINGS_BUFFER_H
+
+#include <QOpenGLFunctions_4_1_Core>
+
+#include "../settings.h"
+
+// Binding point of the uniform buffer. The SettingsBlock of every program is
+// bound to it.
+#define SETTINGS_BINDING 0
+
+/**
+ * The settings that are shared by all shader programs, laid out according to
+ * the std140 rules. Mirrors the SettingsBlock in uniforms.glsl.
+ */
+typedef struct SettingsBlock {
+  GLfloat modelViewMatrix[16];
+  GLfloat projectionMatrix[16];
+  // A mat3 is stored as three columns that are padded to four components.
+  GLfloat normalMatrix[12];
+
+  GLfloat tileSize;
+  GLfloat tessDetail;
+  GLfloat amplitude;
+  GLint dynamicLoD;
+
+  GLint displacementMode;
+  GLint shadingMode;
+  GLint normalMode;
+  GLint bakedDisplacement;
+
+  GLfloat eyePosition[3];
+  GLint backPatchCulling;
+
+  GLint errorDrivenLoD;
+  GLfloat lodErrorScale;
+  GLint padding[2];
+} SettingsBlock;
+
+/**
+ * @brief The SettingsBuffer class holds the settings that are shared by all
+ * shader programs in a uniform buffer. Only the part of the buffer that
+ * changed is uploaded, so e.g. rotating the view does not upload the
+ * displacement settings.
+ */
+class SettingsBuffer {
+ public:
+  SettingsBuffer();
+  ~SettingsBuffer();
+
+  void init(QOpenGLFunctions_4_1_Core* f);
+  void update(const Settings& settings);
+
+ private:
+  QOpenGLFunctions_4_1_Core* gl;
+  GLuint buffer;
+  // The uploaded contents.
+  SettingsBlock block;
+};
+
+#endif  // SETTINGS_BUFFER_H
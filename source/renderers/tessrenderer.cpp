@@ -1,20 +1,35 @@
 #include "tessrenderer.h"
 
+#include <QDebug>
+#include <cmath>
+
 /**
  * @brief TessellationRenderer::TessellationRenderer Creates a new tessellation
  * renderer.
  */
-TessellationRenderer::TessellationRenderer() : meshIBOSize(0) {}
+TessellationRenderer::TessellationRenderer()
+    : bakedMode(0),
+      bakedSize(0),
+      displacementCurvature(0.0f),
+      curvatureMode(-1),
+      curvatureTileSize(0.0f),
+      bvh(QSharedPointer<const PatchBVH>::create()),
+      frustumCulled(0),
+      culledInflation(0.0f),
+      culledGradient(0.0f),
+      culledFrustum(false),
+      cullingOutdated(true),
+      backFacing(-1) {}
 
 /**
  * @brief TessellationRenderer::~TessellationRenderer Deconstructor.
  */
 TessellationRenderer::~TessellationRenderer() {
   gl->glDeleteVertexArrays(1, &vao);
-
-  gl->glDeleteBuffers(1, &meshCoordsBO);
-  gl->glDeleteBuffers(1, &meshNormalsBO);
-  gl->glDeleteBuffers(1, &meshIndexBO);
+  gl->glDeleteVertexArrays(1, &irregularVao);
+  qDeleteAll(irregularShaders);
+  gl->glDeleteTextures(1, &coefficientTexture);
+  gl->glDeleteTextures(1, &patchBoundsTexture);
 }
 
 /**
@@ -24,6 +39,15 @@ TessellationRenderer::~TessellationRenderer() {
 void TessellationRenderer::initShaders() {
   shaders[ShaderType::BICUBIC] = constructTesselationShader("bicubic");
   shaders[ShaderType::DISPLACEMENT] = constructTesselationShader("displace");
+  irregularShaders[ShaderType::BICUBIC] =
+      constructTesselationShader("bicubic", true);
+  irregularShaders[ShaderType::DISPLACEMENT] =
+      constructTesselationShader("displace", true);
+  for (ShaderType type : {ShaderType::BICUBIC, ShaderType::DISPLACEMENT}) {
+    uniPatchOffset[type] = shaders[type]->uniformLocation("patchOffset");
+    uniDisplacementCurvature[type] =
+        shaders[type]->uniformLocation("displacementCurvature");
+  }
 }
 
 /**
@@ -32,53 +56,77 @@ void TessellationRenderer::initShaders() {
  * evaluation shader and a fragment shader. The shaders are assumed to follow
  * the naming convention: <name>.vert, <name.tesc>, <name.tese> and <name>.frag.
  * All of these files have to exist for this function to work successfully.
+ * The program for the patches of irregular faces uses irregular.tesc instead
+ * and evaluates the patches with the Bezier basis instead of the B-spline
+ * basis.
  * @param name Name of the shader.
+ * @param irregular Whether the program draws the patches of irregular faces.
  * @return The constructed shader.
  */
 QOpenGLShaderProgram *
-TessellationRenderer::constructTesselationShader(const QString &name) const {
+TessellationRenderer::constructTesselationShader(const QString &name,
+                                                 bool irregular) const {
   QString pathVert = ":/shaders/" + name + ".vert";
   QString pathTesC = ":/shaders/" + name + ".tesc";
   QString pathTesE = ":/shaders/" + name + ".tese";
   QString pathFrag = ":/shaders/" + name + ".frag";
   QString pathShading = ":/shaders/shading.glsl";
   QString pathProcedural = ":/shaders/procedural.glsl";
+  QString pathPatchBounds = ":/shaders/patchbounds.glsl";
+  QString pathBasis = ":/shaders/bspline.glsl";
+  if (irregular) {
+    pathTesC = ":/shaders/irregular.tesc";
+    pathBasis = ":/shaders/bezier.glsl";
+  }
 
   // we use the qt wrapper functions for shader objects
   QOpenGLShaderProgram *shader = new QOpenGLShaderProgram();
-  shader->addShaderFromSourceFile(QOpenGLShader::Vertex, pathVert);
-  shader->addShaderFromSourceFile(QOpenGLShader::TessellationControl, pathTesC);
-  shader->addShaderFromSourceFile(QOpenGLShader::TessellationEvaluation,
-                                  pathTesE);
-  shader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathFrag);
-  shader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathShading);
-  shader->addShaderFromSourceFile(QOpenGLShader::TessellationEvaluation,
-                                  pathProcedural);
-  shader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathProcedural);
-  shader->link();
+  addShaderFile(shader, QOpenGLShader::Vertex, pathVert);
+  addShaderFile(shader, QOpenGLShader::TessellationControl, pathTesC);
+  if (!irregular) {
+    // The irregular patches are neither culled nor use error-driven levels.
+    addShaderFile(shader, QOpenGLShader::TessellationControl, pathPatchBounds);
+  }
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation, pathTesE);
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation, pathBasis);
+  addShaderFile(shader, QOpenGLShader::Fragment, pathFrag);
+  addShaderFile(shader, QOpenGLShader::Fragment, pathShading);
+  addShaderFile(shader, QOpenGLShader::TessellationEvaluation, pathProcedural);
+  addShaderFile(shader, QOpenGLShader::Fragment, pathProcedural);
+  linkShader(shader);
+
+  shader->bind();
+  shader->setUniformValue("coefficientTexture", COEFFICIENT_TEXTURE_UNIT);
+  shader->setUniformValue("patchBounds", PATCH_BOUNDS_TEXTURE_UNIT);
+  shader->release();
   return shader;
 }
 
 /**
  * @brief TessellationRenderer::initBuffers Initializes the buffers. Uses
- * indexed rendering. The coordinates and normals are passed into the shaders.
+ * indexed rendering. The coordinates and normals of the shared vertex buffers
+ * are passed into the shaders.
  */
 void TessellationRenderer::initBuffers() {
+  meshIndices.create(gl);
+  patchBounds.create(gl);
+
   gl->glGenVertexArrays(1, &vao);
   gl->glBindVertexArray(vao);
 
-  gl->glGenBuffers(1, &meshCoordsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
-  gl->glEnableVertexAttribArray(0);
-  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  vertexBuffers->bindAttributes();
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndices.id());
+
+  gl->glBindVertexArray(0);
 
-  gl->glGenBuffers(1, &meshNormalsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
-  gl->glEnableVertexAttribArray(1);
-  gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  // The irregular patches have their own control points, without normals.
+  irregularPatches.create(gl);
+  gl->glGenVertexArrays(1, &irregularVao);
+  gl->glBindVertexArray(irregularVao);
 
-  gl->glGenBuffers(1, &meshIndexBO);
-  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBO);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, irregularPatches.id());
+  gl->glEnableVertexAttribArray(0);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
   gl->glBindVertexArray(0);
 
@@ -93,96 +141,217 @@ void TessellationRenderer::initBuffers() {
   gl->glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F,
                    static_cast<GLint>(fullTurboColorMap.size()), 0, GL_RGB,
                    GL_FLOAT, fullTurboColorMap.data());
+
+  // The baked coefficients are read with texelFetch, so no filtering or
+  // mipmaps. Remains bound to its own unit.
+  gl->glGenTextures(1, &coefficientTexture);
+  gl->glActiveTexture(GL_TEXTURE0 + COEFFICIENT_TEXTURE_UNIT);
+  gl->glBindTexture(GL_TEXTURE_2D, coefficientTexture);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // The patch bounds are attached once the buffer has been uploaded.
+  gl->glGenTextures(1, &patchBoundsTexture);
+  gl->glActiveTexture(GL_TEXTURE0 + PATCH_BOUNDS_TEXTURE_UNIT);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, patchBoundsTexture);
+  gl->glActiveTexture(GL_TEXTURE0);
 }
 
 /**
- * @brief TessellationRenderer::updateBuffers Updates the buffers based on the
- * provided mesh.
+ * @brief TessellationRenderer::updateBuffers Updates the patch index buffer
+ * and the patch bounds based on the provided mesh. The patches are stored in
+ * the order of their bounding volume hierarchy. The control points of the
+ * irregular patches are uploaded as well. The vertex attributes are uploaded
+ * to the shared vertex buffers.
  * @param mesh The mesh to update the buffer contents with.
+ * @param patchBVH The hierarchy over the regular patches of the mesh, as built
+ * by the MeshPipeline. A null pointer stands for a mesh without patches.
  */
-void TessellationRenderer::updateBuffers(Mesh &currentMesh) {
-  QVector<QVector3D> &vertexCoords = currentMesh.getVertexCoords();
-  QVector<QVector3D> &vertexNormals = currentMesh.getVertexNorms();
-
-  QVector<unsigned int> *meshIndices;
-  meshIndices = &currentMesh.getRegularPatchIndices();
-
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
-  gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexCoords.size(),
-                   vertexCoords.data(), GL_DYNAMIC_DRAW);
-
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
-  gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexNormals.size(),
-                   vertexNormals.data(), GL_DYNAMIC_DRAW);
-
-  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBO);
-  gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                   sizeof(unsigned int) * meshIndices->size(),
-                   meshIndices->data(), GL_DYNAMIC_DRAW);
-
-  meshIBOSize = meshIndices->size();
+void TessellationRenderer::updateBuffers(
+    Mesh &currentMesh, const QSharedPointer<const PatchBVH> &patchBVH) {
+  bvh = patchBVH.isNull() ? QSharedPointer<const PatchBVH>::create() : patchBVH;
+  cullingOutdated = true;
+  meshIndices.upload(
+      bvh->orderedPatchIndices(currentMesh.getRegularPatchIndices()));
+  patchBounds.upload(bvh->boundsData());
+  irregularPatches.upload(currentMesh.getIrregularPatchCoords());
+
+  gl->glActiveTexture(GL_TEXTURE0 + PATCH_BOUNDS_TEXTURE_UNIT);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, patchBounds.id());
+  gl->glActiveTexture(GL_TEXTURE0);
 }
 
 /**
- * @brief TessellationRenderer::updateUniforms Updates the uniforms in the
- * shader.
+ * @brief TessellationRenderer::updateCoefficientTexture Bakes the
+ * displacement coefficients into the coefficient texture if the baked
+ * displacement is enabled and the displacement mode or tile size changed.
+ * The amplitude is applied in the shaders, so it does not require baking
+ * again. Fractional tile sizes are not baked; the shaders then generate the
+ * coefficients instead.
  */
-void TessellationRenderer::updateUniforms() {
-  QOpenGLShaderProgram *shader = shaders[settings->currentTessellationShader];
-  uniModelViewMatrix = shader->uniformLocation("modelviewmatrix");
-  uniProjectionMatrix = shader->uniformLocation("projectionmatrix");
-  uniNormalMatrix = shader->uniformLocation("normalmatrix");
-
-  uniInnerTessLevel = shader->uniformLocation("innerTessLevel");
-  uniOuterTessLevel = shader->uniformLocation("outerTessLevel");
-  uniTileSize = shader->uniformLocation("tileSize");
-
-  uniDynamicLoD = shader->uniformLocation("dynamicLoD");
-  uniTessDetail = shader->uniformLocation("tessDetail");
-
-  uniAmplitude = shader->uniformLocation("tess_amplitude");
-  uniDisplacementMode = shader->uniformLocation("displacement_mode");
-
-  uniShadingMode = shader->uniformLocation("shading_mode");
-  uniNormalMode = shader->uniformLocation("normal_mode");
+void TessellationRenderer::updateCoefficientTexture() {
+  int size = qRound(settings->tileSize);
+  if (!settings->bakedDisplacement || size < 1 ||
+      float(size) != settings->tileSize) {
+    return;
+  }
+  if (settings->displacement_mode == bakedMode && size == bakedSize) {
+    return;
+  }
+  CoefficientGrid grid(ProceduralDisplacement(settings->displacement_mode, 1.0f),
+                       size);
+  gl->glActiveTexture(GL_TEXTURE0 + COEFFICIENT_TEXTURE_UNIT);
+  gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT,
+                   grid.getCoefficients().constData());
+  gl->glActiveTexture(GL_TEXTURE0);
+  bakedMode = settings->displacement_mode;
+  bakedSize = size;
+  qDebug() << " * Baked" << size * size << "displacement coefficients";
+}
 
-  gl->glUniformMatrix4fv(uniModelViewMatrix, 1, false,
-                         settings->modelViewMatrix.data());
-  gl->glUniformMatrix4fv(uniProjectionMatrix, 1, false,
-                         settings->projectionMatrix.data());
-  gl->glUniformMatrix3fv(uniNormalMatrix, 1, false,
-                         settings->normalMatrix.data());
+/**
+ * @brief TessellationRenderer::updateDisplacementCurvature Bounds the second
+ * derivatives of the displacement for error-driven level of detail if the
+ * displacement mode or tile size changed. Like the baked coefficients, the
+ * bound is computed for an amplitude of 1 and scaled in the shaders.
+ */
+void TessellationRenderer::updateDisplacementCurvature() {
+  if (!settings->dynamicLoD || !settings->errorDrivenLoD) {
+    return;
+  }
+  if (settings->displacement_mode == curvatureMode &&
+      settings->tileSize == curvatureTileSize) {
+    return;
+  }
+  displacementCurvature =
+      ProceduralDisplacement(settings->displacement_mode, 1.0f)
+          .curvatureBound(settings->tileSize);
+  curvatureMode = settings->displacement_mode;
+  curvatureTileSize = settings->tileSize;
+}
 
-  gl->glUniform1f(uniInnerTessLevel, settings->tileSize);
-  gl->glUniform1f(uniOuterTessLevel, settings->tileSize);
-  gl->glUniform1f(uniTileSize, settings->tileSize);
+/**
+ * @brief TessellationRenderer::displacementBounds Bounds the displacement of
+ * the current shader, which grows the bounds of the patches.
+ * @param inflation Bound on the displacement distance.
+ * @param gradient Bound on the length of the gradient of the displacement in
+ * the (u, v) domain.
+ */
+void TessellationRenderer::displacementBounds(float &inflation,
+                                              float &gradient) const {
+  inflation = 0.0f;
+  gradient = 0.0f;
+  if (settings->currentTessellationShader != ShaderType::DISPLACEMENT) {
+    return;
+  }
+  float lower, upper;
+  ProceduralDisplacement(settings->displacement_mode, settings->amplitude)
+      .coefficientBounds(lower, upper);
+  inflation = std::max(std::abs(lower), std::abs(upper));
+  // The subpatch coordinates change tileSize times as fast.
+  gradient = settings->tileSize * (upper - lower);
+}
 
-  gl->glUniform1i(uniDynamicLoD, settings->dynamicLoD);
-  gl->glUniform1f(uniTessDetail, settings->tessDetail);
+/**
+ * @brief TessellationRenderer::cullPatches Determines the ranges of patches
+ * that intersect the view frustum. The bounds of displaced patches are grown
+ * by the maximum displacement. Does nothing if neither the patches, the view
+ * nor the displacement bounds changed since the last time.
+ */
+void TessellationRenderer::cullPatches() {
+  float inflation, gradient;
+  displacementBounds(inflation, gradient);
+  if (!cullingOutdated && culledModelView == settings->modelViewMatrix &&
+      culledProjection == settings->projectionMatrix &&
+      culledInflation == inflation && culledGradient == gradient &&
+      culledFrustum == settings->frustumCulling) {
+    return;
+  }
+  cullingOutdated = false;
+  culledModelView = settings->modelViewMatrix;
+  culledProjection = settings->projectionMatrix;
+  culledInflation = inflation;
+  culledGradient = gradient;
+  culledFrustum = settings->frustumCulling;
+  backFacing = -1;
+
+  int patchCount = numPatches();
+  if (!settings->frustumCulling) {
+    visibleRanges.clear();
+    if (patchCount > 0) {
+      visibleRanges.append(qMakePair(0, patchCount));
+    }
+    frustumCulled = 0;
+    return;
+  }
 
-  gl->glUniform1f(uniAmplitude, settings->amplitude);
-  gl->glUniform1i(uniDisplacementMode, settings->displacement_mode);
+  bvh->cull(settings->projectionMatrix * settings->modelViewMatrix, inflation,
+            visibleRanges);
+  frustumCulled = patchCount;
+  for (const QPair<int, int> &range : visibleRanges) {
+    frustumCulled -= range.second - range.first;
+  }
+}
 
-  gl->glUniform1i(uniShadingMode, settings->shading_mode);
-  gl->glUniform1i(uniNormalMode, settings->normal_mode);
+/**
+ * @brief TessellationRenderer::numBackFacing Counts the patches of the current
+ * frame that the tessellation control shaders discard, using the same test on
+ * the CPU. The count is kept until the patches are culled again, i.e. until
+ * the patches, the view or the displacement bounds change.
+ * @return The number of back-facing patches within the view frustum, or 0 if
+ * back-patch culling is disabled.
+ */
+int TessellationRenderer::numBackFacing() const {
+  if (!settings->backPatchCulling) {
+    return 0;
+  }
+  if (backFacing < 0) {
+    QVector3D eye = culledModelView.inverted().map(QVector3D());
+    backFacing = 0;
+    for (const QPair<int, int> &range : visibleRanges) {
+      for (int patch = range.first; patch < range.second; patch++) {
+        backFacing +=
+            bvh->backFacing(patch, eye, culledInflation, culledGradient) ? 1
+                                                                         : 0;
+      }
+    }
+  }
+  return backFacing;
 }
 
 /**
- * @brief MeshRenderer::draw Draw call.
+ * @brief MeshRenderer::draw Draw call. Draws the ranges of patches that
+ * intersect the view frustum, followed by the patches of the irregular faces.
  */
 void TessellationRenderer::draw() {
+  updateCoefficientTexture();
+  updateDisplacementCurvature();
+  cullPatches();
   shaders[settings->currentTessellationShader]->bind();
-
-  if (settings->uniformUpdateRequired) {
-    updateUniforms();
-  }
+  gl->glUniform1f(uniDisplacementCurvature[settings->currentTessellationShader],
+                  displacementCurvature);
 
   gl->glBindVertexArray(vao);
 
   gl->glPatchParameteri(GL_PATCH_VERTICES, 16);
-  gl->glDrawElements(GL_PATCHES, meshIBOSize, GL_UNSIGNED_INT, nullptr);
+  GLint patchOffset = uniPatchOffset[settings->currentTessellationShader];
+  for (const QPair<int, int> &range : visibleRanges) {
+    gl->glUniform1i(patchOffset, range.first);
+    gl->glDrawElements(
+        GL_PATCHES, 16 * (range.second - range.first), GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(16 * sizeof(unsigned int) *
+                                       size_t(range.first)));
+  }
 
   gl->glBindVertexArray(0);
 
   shaders[settings->currentTessellationShader]->release();
+
+  if (numIrregularPatches() > 0) {
+    irregularShaders[settings->currentTessellationShader]->bind();
+    gl->glBindVertexArray(irregularVao);
+    gl->glDrawArrays(GL_PATCHES, 0, 16 * numIrregularPatches());
+    gl->glBindVertexArray(0);
+    irregularShaders[settings->currentTessellationShader]->release();
+  }
 }
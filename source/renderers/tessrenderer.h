@@ -2,11 +2,21 @@
 #define TESSRENDERER_H
 
 #include <QOpenGLShaderProgram>
+#include <QSharedPointer>
 
+#include "../evaluation/coefficientgrid.h"
+#include "../evaluation/patchbvh.h"
 #include "../mesh/mesh.h"
 #include "../util/turbocolormap.h"
+#include "dynamicbuffer.h"
 #include "renderer.h"
 
+// Texture unit of the baked displacement coefficients. The colour map uses
+// unit 0.
+#define COEFFICIENT_TEXTURE_UNIT 1
+// Texture unit of the patch bounds that are used for back-patch culling.
+#define PATCH_BOUNDS_TEXTURE_UNIT 2
+
 /**
  * @brief The TessellationRenderer class is responsible for rendering
  * Tessellated patches.
@@ -16,27 +26,62 @@ public:
   TessellationRenderer();
   ~TessellationRenderer() override;
 
-  void updateUniforms();
-  void updateBuffers(Mesh &m);
+  void updateBuffers(Mesh &m, const QSharedPointer<const PatchBVH> &patchBVH);
   void draw();
 
+  inline int numPatches() const { return meshIndices.size() / 16; }
+  inline int numIrregularPatches() const {
+    return irregularPatches.size() / 16;
+  }
+  inline int numFrustumCulled() const { return frustumCulled; }
+  int numBackFacing() const;
+  void updateCoefficientTexture();
+
 protected:
-  QOpenGLShaderProgram *constructTesselationShader(const QString &name) const;
+  QOpenGLShaderProgram *constructTesselationShader(const QString &name,
+                                                   bool irregular = false) const;
   void initShaders() override;
   void initBuffers() override;
+  void updateDisplacementCurvature();
+  void displacementBounds(float &inflation, float &gradient) const;
+  void cullPatches();
 
 private:
-  GLuint vao, texture;
-  GLuint meshCoordsBO, meshNormalsBO, meshIndexBO;
-  int meshIBOSize;
-  //  QOpenGLShaderProgram* tessellationPatchShader;
+  GLuint vao, texture, coefficientTexture;
+  // Displacement mode and size of the baked coefficients. The size is 0 if
+  // nothing has been baked yet.
+  int bakedMode, bakedSize;
+  // Curvature bound of the displacement for an amplitude of 1, and the
+  // displacement mode and tile size it was computed for.
+  float displacementCurvature;
+  int curvatureMode;
+  float curvatureTileSize;
+  DynamicBuffer<unsigned int> meshIndices;
 
-  // Uniforms
-  GLint uniModelViewMatrix, uniProjectionMatrix, uniNormalMatrix;
-  GLint uniInnerTessLevel, uniOuterTessLevel, uniTileSize;
-  GLint uniDynamicLoD, uniTessDetail;
-  GLint uniAmplitude, uniDisplacementMode;
-  GLint uniShadingMode, uniNormalMode;
+  // The patches of the irregular faces are drawn separately, with their own
+  // control points and programs.
+  GLuint irregularVao;
+  DynamicBuffer<QVector3D> irregularPatches;
+  QMap<ShaderType, QOpenGLShaderProgram *> irregularShaders;
+
+  // The patches are drawn in the order of the hierarchy, which is built by
+  // the MeshPipeline. Never null.
+  QSharedPointer<const PatchBVH> bvh;
+  DynamicBuffer<float> patchBounds;
+  GLuint patchBoundsTexture;
+  QMap<ShaderType, GLint> uniPatchOffset, uniDisplacementCurvature;
+  // The ranges of patches that are drawn in the current frame.
+  QVector<QPair<int, int>> visibleRanges;
+  int frustumCulled;
+  // The view and displacement bounds that the ranges were culled for. The
+  // patches are only culled again once these change.
+  QMatrix4x4 culledModelView, culledProjection;
+  float culledInflation, culledGradient;
+  bool culledFrustum, cullingOutdated;
+  // Number of back-facing patches within the ranges, or -1 if they have not
+  // been counted since they were culled.
+  mutable int backFacing;
+  //  QOpenGLShaderProgram* tessellationPatchShader;
 };
 
 #endif // TessRenderer_H
@@ -0,0 +1,42 @@
+#include "vertexbuffers.h"
+
+/**
+ * @brief VertexBuffers::VertexBuffers Creates new vertex buffers. They have to
+ * be initialised with an OpenGL context before they can be used.
+ */
+VertexBuffers::VertexBuffers() : gl(nullptr) {}
+
+/**
+ * @brief VertexBuffers::init Creates the buffers in the current context.
+ * @param f OpenGL functions pointer.
+ */
+void VertexBuffers::init(QOpenGLFunctions_4_1_Core *f) {
+  gl = f;
+  coords.create(gl);
+  normals.create(gl);
+}
+
+/**
+ * @brief VertexBuffers::update Uploads the vertex coordinates and normals of a
+ * mesh. Only the parts that changed since the previous mesh are uploaded.
+ * @param mesh The mesh. Its attributes should already be extracted.
+ */
+void VertexBuffers::update(Mesh &mesh) {
+  coords.upload(mesh.getVertexCoords());
+  normals.upload(mesh.getVertexNorms());
+}
+
+/**
+ * @brief VertexBuffers::bindAttributes Points attribute 0 to the coordinates
+ * and attribute 1 to the normals. Should be called while the vertex array
+ * object of a renderer is bound.
+ */
+void VertexBuffers::bindAttributes() const {
+  gl->glBindBuffer(GL_ARRAY_BUFFER, coords.id());
+  gl->glEnableVertexAttribArray(0);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  gl->glBindBuffer(GL_ARRAY_BUFFER, normals.id());
+  gl->glEnableVertexAttribArray(1);
+  gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+}
@@ -0,0 +1,28 @@
+#ifndef VERTEX_BUFFERS_H
+#define VERTEX_BUFFERS_H
+
+#include <QOpenGLFunctions_4_1_Core>
+#include <QVector3D>
+
+#include "../mesh/mesh.h"
+#include "dynamicbuffer.h"
+
+/**
+ * @brief The VertexBuffers class holds the vertex coordinates and normals of
+ * the current mesh on the GPU. The buffers are shared by all renderers, which
+ * only upload their own indices.
+ */
+class VertexBuffers {
+ public:
+  VertexBuffers();
+
+  void init(QOpenGLFunctions_4_1_Core* f);
+  void update(Mesh& mesh);
+  void bindAttributes() const;
+
+ private:
+  QOpenGLFunctions_4_1_Core* gl;
+  DynamicBuffer<QVector3D> coords, normals;
+};
+
+#endif  // VERTEX_BUFFERS_H
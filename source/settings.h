@@ -16,24 +16,53 @@ typedef struct Settings {
   bool showCpuMesh = true;
 
   int subdivSteps = 0;
+  bool adaptiveSubdivision = false;
 
   float FoV = 80;
   float dispRatio = 16.0f / 9.0f;
+  int viewportHeight = 1;
   float rotAngle = 0.0f;
 
   float tileSize = 4.F;
 
   bool dynamicLoD = false;
   float tessDetail = 10.F;
+  // Dynamic level of detail from the patch bounds instead of the screen-space
+  // edge lengths, such that the error is at most pixelError pixels.
+  bool errorDrivenLoD = false;
+  float pixelError = 1.0f;
+  // Draws the displaced surface from vertices that the tessellation shaders
+  // computed once and that are cached, instead of tessellating every frame.
+  // The density is the number of samples per displacement tile in either
+  // direction.
+  bool pretessellated = false;
+  int tessDensity = 1;
+
+  // Adjusts the dynamic level of detail to a budget, see LoDBudget. The GPU
+  // time budget is in milliseconds per frame.
+  int lodBudget = 0;
+  qint64 triangleBudget = 1000000;
+  float gpuTimeBudget = 8.0f;
 
   // Displacement stuff:
   float amplitude = 0.2;
   int displacement_mode = 0;
+  // Whether the displacement coefficients are read from a texture instead of
+  // generated per vertex.
+  bool bakedDisplacement = false;
 
   // Shading mode:
   int shading_mode = 0; // 0 is phong. 1 is normals
   int normal_mode = 0; // 0 is true normals; 1 is approx normals; 2 is interpolated normals
 
+  // Patches outside the view frustum are not drawn. Back-facing patches are
+  // only skipped on request, since open meshes show their back faces.
+  bool frustumCulling = true;
+  bool backPatchCulling = false;
+
+  // Frame statistics overlay:
+  bool showFrameStats = false;
+
   bool uniformUpdateRequired = true;
 
   ShaderType currentMeshShader = ShaderType::PHONG;
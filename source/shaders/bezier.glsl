@@ -0,0 +1,12 @@
+#version 410
+// Basis of the bicubic patches of irregular faces, whose 16 control points are
+// computed by Mesh::computeIrregularPatches().
+
+// Cubic Bernstein basis. Multiplied with (t^3, t^2, t, 1), it gives the
+// weights of the four control points.
+mat4 cubicBasis() {
+  return mat4(-1, 3, -3, 1,
+              3, -6, 3, 0,
+              -3, 3, 0, 0,
+              1, 0, 0, 0);
+}
@@ -14,6 +14,7 @@ in vec3 vertbasenormal;
 
 in float vertU;
 in float vertV;
+flat in float vertTileSize;
 
 in float vertdisplacement;
 in vec3 vertbasenormaldu;
@@ -22,18 +23,9 @@ in vec3 vertbasenormaldv;
 // Out vars
 out vec4 fColor;
 
-// Uniforms
-uniform mat3 normalmatrix;
-
+// Uniforms. The settings are declared in uniforms.glsl.
 uniform sampler1D cmap;
 
-uniform float tileSize;
-uniform float tess_amplitude;
-
-uniform int displacement_mode;
-uniform int shading_mode;
-uniform int normal_mode;
-
 // Constants
 const float freq = .5F;
 const vec3 matcolour = vec3(0.53, 0.80, 0.87);
@@ -45,7 +37,7 @@ vec3 phongShading(vec3 matCol, vec3 coords, vec3 normal);
 mat3 biquadraticCoeff(float u, float v, float r);
 
 float subpatchTransform(float t) {
-  return fract(tileSize * t - 0.5);
+  return fract(vertTileSize * t - 0.5);
 }
 
 const mat3 quadratricM = mat3(1, -2,  1,
@@ -68,7 +60,7 @@ void main() {
     float u = subpatchTransform(vertU); // Maps to [0,1]
     float v = subpatchTransform(vertV);
 
-    float r = 1 / tileSize;
+    float r = 1 / vertTileSize;
 
     // These are the center coordinates of the 3x3 subpatch in the main (u,v) domain.
     float uC = vertU + r * (0.5 - u); 
@@ -83,11 +75,13 @@ void main() {
     vec3 dB2dv = quadratricM * vec3(2*v, 1, 0);
 
     // Biquadratic coefficients grid
-    mat3 coefficients = biquadraticCoeff(uC, vC, r);
+    // The pattern repeats for every patch of the finest level.
+    float scale = vertTileSize / tileSize;
+    mat3 coefficients = biquadraticCoeff(scale * uC, scale * vC, scale * r);
 
     // Partials of displacement D
-    dDdu = tileSize * dot(dB2du, coefficients * B2v);
-    dDdv = tileSize * dot(B2u, coefficients * dB2dv);
+    dDdu = vertTileSize * dot(dB2du, coefficients * B2v);
+    dDdv = vertTileSize * dot(B2u, coefficients * dB2dv);
   }
 
   // --------------------- Normal computation  ----------------------
@@ -8,9 +8,6 @@ layout(location = 0) out vec3 vertcoords_vs;
 layout(location = 1) out vec3 vertnormal_vs;
 layout(location = 2) out vec2 vertndc_vs;
 
-uniform mat4 modelviewmatrix;
-uniform mat4 projectionmatrix;
-
 void main() {
   gl_Position = vec4(vertcoords, 1.0);
 
@@ -0,0 +1,133 @@
+#version 410
+// Back-patch culling and error-driven level of detail for the tessellation
+// control shaders.
+
+// The bounds of every patch, computed by PatchBVH::boundsData(): five texels
+// per patch with the normal cone (axis and angle), the bounding sphere (centre
+// and radius), the slope factor, curvature, tile scale and irregular sides,
+// the edge curvatures and the tile scales of the edges.
+uniform samplerBuffer patchBounds;
+const int boundsTexels = 5;
+// The index of the first patch of the draw call. gl_PrimitiveID restarts at
+// zero for every draw call.
+uniform int patchOffset;
+// Bound on the second derivatives of the displacement for an amplitude of 1.
+// See ProceduralDisplacement::curvatureBound().
+uniform float displacementCurvature;
+
+const float halfPi = 1.57079633;
+
+// Number of displacement tiles of the patch in either direction. Patches of
+// the AdaptiveSubdivider span more tiles the coarser their level.
+float patchTileSize() {
+  int texel = boundsTexels * (patchOffset + gl_PrimitiveID);
+  return tileSize * texelFetch(patchBounds, texel + 2).z;
+}
+
+// Bounds on the displacement coefficients. Same as
+// ProceduralDisplacement::coefficientBounds().
+vec2 coefficientBounds() {
+  vec2 bounds = (displacement_mode == 1 ? vec2(-1., 2.) : vec2(0., 1.)) * tess_amplitude;
+  return vec2(min(bounds.x, bounds.y), max(bounds.x, bounds.y));
+}
+
+// Whether every normal of the patch points away from the eye. Accounts for
+// the displacement if the patch is displaced. Same as PatchBVH::backFacing().
+bool patchBackFacing(bool displaced) {
+  if (!backPatchCulling) {
+    return false;
+  }
+  int texel = boundsTexels * (patchOffset + gl_PrimitiveID);
+  vec4 cone = texelFetch(patchBounds, texel);
+  vec4 sphere = texelFetch(patchBounds, texel + 1);
+  vec4 factors = texelFetch(patchBounds, texel + 2);
+  float slopeFactor = factors.x;
+
+  float angle = cone.w;
+  float radius = sphere.w;
+  if (displaced) {
+    // The displacement moves the surface along the normal and tilts the
+    // normals by at most the angle of its gradient.
+    vec2 bounds = coefficientBounds();
+    radius += max(abs(bounds.x), abs(bounds.y));
+    angle += atan(2. * tileSize * factors.z * (bounds.y - bounds.x) * slopeFactor);
+  }
+
+  vec3 toEye = eyePosition - sphere.xyz;
+  float dist = length(toEye);
+  if (dist <= radius) {
+    return false;
+  }
+  // The directions from the sphere to the eye lie in a cone as well.
+  angle += asin(radius / dist);
+  if (angle >= halfPi) {
+    return false;
+  }
+  return dot(cone.xyz, toEye) / dist < -sin(angle);
+}
+
+// Tessellation level for which linearly interpolating a surface with the
+// given curvature bound is off by at most the pixel error, seen from the
+// given distance. The interpolation error over a grid with spacing 1 / L is
+// at most curvature / (8 L^2).
+float errorLevel(float curvature, float dist) {
+  float level = sqrt(curvature * lodErrorScale / (8. * max(dist, 1e-4)));
+  return clamp(level, 1., 64.);
+}
+
+// Computes the outer and inner tessellation levels of the patch for the
+// target pixel error. The corners are given in the order 5, 6, 10, 9 of the
+// control points. Same as Tessellator::errorDrivenLevels().
+void errorDrivenLevels(vec3 corners[4], bool displaced, out float outer[4],
+                       out vec2 inner) {
+  int texel = boundsTexels * (patchOffset + gl_PrimitiveID);
+  float curvature = texelFetch(patchBounds, texel + 2).y;
+  vec4 edgeCurvature = texelFetch(patchBounds, texel + 3);
+  float displacement = displaced ? abs(tess_amplitude) * displacementCurvature : 0.;
+
+  float dist[4];
+  for (int k = 0; k < 4; k++) {
+    dist[k] = length(eyePosition - corners[k]);
+  }
+  // Outer level k lies between the corners k - 1 and k, so that adjacent
+  // patches compute the same level from the same inputs.
+  outer[0] = errorLevel(edgeCurvature[0] + displacement, min(dist[3], dist[0]));
+  outer[1] = errorLevel(edgeCurvature[1] + displacement, min(dist[0], dist[1]));
+  outer[2] = errorLevel(edgeCurvature[2] + displacement, min(dist[1], dist[2]));
+  outer[3] = errorLevel(edgeCurvature[3] + displacement, min(dist[2], dist[3]));
+
+  float nearest = min(min(dist[0], dist[1]), min(dist[2], dist[3]));
+  inner = vec2(errorLevel(curvature + displacement, nearest));
+}
+
+// Overrides the outer levels of the sides where the patch meets patches of
+// another level. Such a side is split into the same segments on both sides:
+// the coarse patch chooses a power of two from its own tile scale, and each
+// finer patch takes its share of those. Both sides only depend on the level of
+// the coarse patch, so this holds for every mode of the control shaders.
+// Assumes that the finest level is at most five levels above the coarse patch.
+void transitionLevels(inout float outer[4]) {
+  int texel = boundsTexels * (patchOffset + gl_PrimitiveID);
+  float scale = texelFetch(patchBounds, texel + 2).z;
+  vec4 edgeScale = texelFetch(patchBounds, texel + 4);
+  for (int k = 0; k < 4; k++) {
+    if (edgeScale[k] > 0.) {
+      // With fractional even spacing, segments of an even integer level line up.
+      float coarse = exp2(ceil(log2(max(tileSize * edgeScale[k], 1.)) - 1e-3));
+      coarse = clamp(coarse, 2. * edgeScale[k], 64.);
+      outer[k] = coarse * scale / edgeScale[k];
+    }
+  }
+}
+
+// Sets the outer levels of the sides that border the patch of an irregular
+// face to the tile size, which irregular.tesc uses for all of its sides.
+void irregularLevels(inout float outer[4]) {
+  int texel = boundsTexels * (patchOffset + gl_PrimitiveID);
+  int sides = int(texelFetch(patchBounds, texel + 2).w);
+  for (int k = 0; k < 4; k++) {
+    if ((sides & (1 << k)) != 0) {
+      outer[k] = tileSize;
+    }
+  }
+}
@@ -6,7 +6,7 @@ layout(location = 1) in vec3 vertnormal_fs;
 
 out vec4 fColor;
 
-uniform int shading_mode;
+uniform int mesh_shading_mode;
 
 // Defined in shading.glsl
 vec3 phongShading(vec3 matCol, vec3 coords, vec3 normal);
@@ -14,7 +14,7 @@ vec3 phongShading(vec3 matCol, vec3 coords, vec3 normal);
 void main() {
   vec3 matcolour = vec3(0.53, 0.80, 0.87);
   vec3 col;
-  if (shading_mode == 0) {
+  if (mesh_shading_mode == 0) {
     // Phong shading:
     col = phongShading(matcolour, vertcoords_fs, vertnormal_fs);
   }
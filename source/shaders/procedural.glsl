@@ -2,13 +2,13 @@
 
 #define M_PI 3.1415926538
 
-// Uniforms
-uniform int displacement_mode;
-uniform float tess_amplitude;
-
 // Constants
 const float freq = .5F;
 
+// Coefficients baked by the TessellationRenderer, one per subpatch centre,
+// without the amplitude. See CoefficientGrid.
+uniform sampler2D coefficientTexture;
+
 // Procedural generation of displacement coefficients.
 float coeff(float u, float v) {
   // Forcing turnable symetry around 0.5, 0.5
@@ -67,6 +67,20 @@ float coeff(float u, float v) {
 
 // Creates 3x3 grid of coefficients with center (u,v) and step size r
 mat3 biquadraticCoeff(float u, float v, float r) {
+    int size = textureSize(coefficientTexture, 0).x;
+    if (baked_displacement && float(size) == tileSize) {
+        // The centre and its neighbours lie on the texel grid, which wraps
+        // around. The centre lies in [0, size].
+        ivec2 center = ivec2(round(vec2(u, v) * size));
+        mat3 c;
+        for (int j = 0; j < 3; j++) {
+            for (int i = 0; i < 3; i++) {
+                ivec2 texel = (center + ivec2(i - 1, j - 1) + size) % size;
+                c[j][i] = texelFetch(coefficientTexture, texel, 0).r;
+            }
+        }
+        return tess_amplitude * c;
+    }
     return mat3(coeff(u - r, v - r), coeff(u, v - r), coeff(u + r, v - r),
                 coeff(u - r, v), coeff(u, v), coeff(u + r, v),
                 coeff(u - r, v + r), coeff(u, v + r), coeff(u + r, v + r));
@@ -0,0 +1,27 @@
+// Settings shared by all programs. Inserted after the #version line of every
+// shader by the renderers. Mirrors SettingsBlock in settingsbuffer.h.
+layout(std140) uniform SettingsBlock {
+  mat4 modelviewmatrix;
+  mat4 projectionmatrix;
+  mat3 normalmatrix;
+
+  float tileSize;
+  float tessDetail;
+  float tess_amplitude;
+  bool dynamicLoD;
+
+  int displacement_mode;
+  int shading_mode;
+  int normal_mode;
+  bool baked_displacement;
+
+  // Position of the eye in the coordinates of the vertices.
+  vec3 eyePosition;
+  bool backPatchCulling;
+
+  // Chooses the tessellation levels from the patch bounds such that the
+  // error is at most a given number of pixels. The scale converts an error
+  // at distance 1 to pixels, divided by that number.
+  bool errorDrivenLoD;
+  float lodErrorScale;
+};
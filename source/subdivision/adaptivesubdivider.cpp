@@ -0,0 +1,263 @@
+#include "adaptivesubdivider.h"
+
+#include "catmullclarksubdivider.h"
+#include "initialization/meshinitializer.h"
+
+/**
+ * @brief AdaptiveSubdivider::AdaptiveSubdivider Creates a new adaptive
+ * subdivider.
+ */
+AdaptiveSubdivider::AdaptiveSubdivider() {}
+
+/**
+ * @brief patchSide Finds the side of a patch that connects two of its corners.
+ * @param patch The 16 control point indices of the patch.
+ * @param a Index of one corner.
+ * @param b Index of the other corner.
+ * @return The side in the order of the outer tessellation levels: u = 0,
+ * v = 0, u = 1 and v = 1.
+ */
+static int patchSide(const unsigned int *patch, unsigned int a,
+                     unsigned int b) {
+  // The corners (0, 0), (1, 0), (1, 1) and (0, 1) are control points 5, 6, 10
+  // and 9. Side k lies between corners k and k + 1 of (0, 1), (0, 0), (1, 0),
+  // (1, 1).
+  static const int corners[4] = {9, 5, 6, 10};
+  for (int k = 0; k < 4; k++) {
+    unsigned int first = patch[corners[k]];
+    unsigned int second = patch[corners[(k + 1) % 4]];
+    if ((a == first && b == second) || (a == second && b == first)) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief AdaptiveSubdivider::subdivide Adaptively subdivides the provided
+ * control mesh. At every level, the core faces (initially all faces) that are
+ * regular become patches. The remaining core faces are subdivided together
+ * with their one-ring of faces, which is exactly the neighbourhood needed to
+ * compute the new vertices of the core faces correctly. The children of the
+ * remaining core faces are the core faces of the next level. Faces that are
+ * still not regular at the last level are left out, same as with uniform
+ * subdivision.
+ *
+ * The faces of the result are the faces that are not refined any further, so
+ * every part of the surface is covered once. For every patch, the level at
+ * which it was created is stored, followed by the levels across its sides.
+ * A side borders finer patches if the face across it is refined; its level
+ * is then stored as one more than that of the patch, even though the patches
+ * across part of the side may be finer still. A side borders a coarser patch
+ * if the face across it only belongs to the one-ring of the refined region.
+ * That face lies within the patch that ended the refinement of its ancestors,
+ * whose level is stored exactly.
+ * @param controlMesh The mesh to be subdivided.
+ * @param levels The maximum number of subdivision steps.
+ * @return A mesh containing the faces of every level that are not refined
+ * any further, with the levels as separate parts. Its regular patch indices
+ * and patch levels contain the patches of all levels.
+ */
+Mesh AdaptiveSubdivider::subdivide(Mesh &controlMesh, int levels) const {
+  CatmullClarkSubdivider subdivider;
+  QVector<QVector3D> coords;
+  QVector<int> faceValences;
+  QVector<int> faceCoordInd;
+  QVector<unsigned int> patchIndices;
+  QVector<int> patchLevels;
+
+  Mesh *mesh = &controlMesh;
+  Mesh refinedMesh;
+  QVector<bool> core(mesh->numFaces(), true);
+  // For every face that is not a core face, the level of the patch it lies in.
+  QVector<int> coveringLevels(mesh->numFaces(), 0);
+  for (int l = 0; l <= levels; l++) {
+    QVector<Face> &faces = mesh->getFaces();
+    QVector<bool> refine(faces.size(), false);
+    for (int f = 0; f < faces.size(); f++) {
+      refine[f] = core[f] && !faces[f].isRegular();
+    }
+
+    QVector<unsigned int> levelPatchIndices;
+    QVector<bool> emit(faces.size(), false);
+    for (int f = 0; f < faces.size(); f++) {
+      if (!core[f]) {
+        continue;
+      }
+      emit[f] = !refine[f] || l == levels;
+      if (refine[f]) {
+        continue;
+      }
+      faces[f].appendPatchIndices(levelPatchIndices);
+      const unsigned int *patch =
+          levelPatchIndices.constData() + levelPatchIndices.size() - 16;
+      int sideLevels[4] = {l, l, l, l};
+      HalfEdge *currentEdge = faces[f].side;
+      for (int m = 0; m < faces[f].valence; m++) {
+        int side = patchSide(patch, currentEdge->origin->index,
+                             currentEdge->next->origin->index);
+        int neighbour = currentEdge->twinIdx() < 0
+                            ? -1
+                            : currentEdge->twin->face->index;
+        if (side >= 0 && neighbour >= 0) {
+          if (!core[neighbour]) {
+            sideLevels[side] = coveringLevels[neighbour];
+          } else if (refine[neighbour] && l < levels) {
+            sideLevels[side] = l + 1;
+          }
+        }
+        currentEdge = currentEdge->next;
+      }
+      patchLevels.append(l);
+      for (int side = 0; side < 4; side++) {
+        patchLevels.append(sideLevels[side]);
+      }
+    }
+    appendLevel(*mesh, emit, levelPatchIndices, coords, faceValences,
+                faceCoordInd, patchIndices);
+
+    Mesh submesh;
+    QVector<int> submeshFaces;
+    if (l == levels || !extractSubmesh(*mesh, refine, submesh, submeshFaces)) {
+      break;
+    }
+    refinedMesh = subdivider.subdivide(submesh);
+
+    // Face h of the refined mesh is created by half-edge h of the submesh.
+    // The children of faces that are not refined lie within a patch of this
+    // level or of a coarser one.
+    QVector<HalfEdge> &halfEdges = submesh.getHalfEdges();
+    QVector<bool> refinedCore(halfEdges.size());
+    QVector<int> refinedCoveringLevels(halfEdges.size());
+    for (int h = 0; h < halfEdges.size(); h++) {
+      int parent = submeshFaces[halfEdges[h].faceIdx()];
+      refinedCore[h] = refine[parent];
+      refinedCoveringLevels[h] = core[parent] ? l : coveringLevels[parent];
+    }
+    core = refinedCore;
+    coveringLevels = refinedCoveringLevels;
+    mesh = &refinedMesh;
+  }
+
+  MeshInitializer meshInitializer;
+  Mesh adaptiveMesh =
+      meshInitializer.constructHalfEdgeMesh(coords, faceValences, faceCoordInd);
+  adaptiveMesh.regularPatchIndices = patchIndices;
+  adaptiveMesh.patchLevels = patchLevels;
+  adaptiveMesh.adaptive = true;
+  return adaptiveMesh;
+}
+
+/**
+ * @brief AdaptiveSubdivider::extractSubmesh Extracts the faces that have to be
+ * refined, together with all faces that share a vertex with them. Vertices are
+ * renumbered in order of appearance. The order of the faces is preserved.
+ * @param mesh The mesh to extract the faces from.
+ * @param refine For every face, whether it has to be refined.
+ * @param submesh The extracted mesh.
+ * @param submeshFaces For every face of the submesh, the index of the face it
+ * was extracted from.
+ * @return False if no face has to be refined; true otherwise.
+ */
+bool AdaptiveSubdivider::extractSubmesh(Mesh &mesh, const QVector<bool> &refine,
+                                        Mesh &submesh,
+                                        QVector<int> &submeshFaces) const {
+  QVector<Face> &faces = mesh.getFaces();
+
+  QVector<bool> refineVertex(mesh.numVerts(), false);
+  bool refineAny = false;
+  for (int f = 0; f < faces.size(); f++) {
+    if (refine[f]) {
+      refineAny = true;
+      HalfEdge *currentEdge = faces[f].side;
+      for (int m = 0; m < faces[f].valence; m++) {
+        refineVertex[currentEdge->origin->index] = true;
+        currentEdge = currentEdge->next;
+      }
+    }
+  }
+  if (!refineAny) {
+    return false;
+  }
+
+  QVector<int> newIndices(mesh.numVerts(), -1);
+  QVector<QVector3D> coords;
+  QVector<int> faceValences;
+  QVector<int> faceCoordInd;
+  for (int f = 0; f < faces.size(); f++) {
+    bool keep = refine[f];
+    HalfEdge *currentEdge = faces[f].side;
+    for (int m = 0; m < faces[f].valence && !keep; m++) {
+      keep = refineVertex[currentEdge->origin->index];
+      currentEdge = currentEdge->next;
+    }
+    if (!keep) {
+      continue;
+    }
+
+    faceValences.append(faces[f].valence);
+    submeshFaces.append(f);
+    currentEdge = faces[f].side;
+    for (int m = 0; m < faces[f].valence; m++) {
+      Vertex *vertex = currentEdge->origin;
+      if (newIndices[vertex->index] < 0) {
+        newIndices[vertex->index] = coords.size();
+        coords.append(vertex->coords);
+      }
+      faceCoordInd.append(newIndices[vertex->index]);
+      currentEdge = currentEdge->next;
+    }
+  }
+
+  MeshInitializer meshInitializer;
+  submesh =
+      meshInitializer.constructHalfEdgeMesh(coords, faceValences, faceCoordInd);
+  return true;
+}
+
+/**
+ * @brief AdaptiveSubdivider::appendLevel Appends the faces of a level that are
+ * not refined any further and the patches of the level to flat vertex, face
+ * and patch arrays. Only the vertices that these faces and patches use are
+ * appended. Vertices that only serve as control points of patches are not
+ * part of any face.
+ * @param mesh The mesh of the level.
+ * @param emit For every face, whether to append it.
+ * @param levelPatchIndices The patches of the level, indexing the vertices of
+ * the level.
+ * @param coords The vertex coordinates.
+ * @param faceValences The valence of every face.
+ * @param faceCoordInd For every face, the indices of its vertices.
+ * @param patchIndices The patch indices, which index coords.
+ */
+void AdaptiveSubdivider::appendLevel(
+    Mesh &mesh, const QVector<bool> &emit,
+    const QVector<unsigned int> &levelPatchIndices, QVector<QVector3D> &coords,
+    QVector<int> &faceValences, QVector<int> &faceCoordInd,
+    QVector<unsigned int> &patchIndices) const {
+  QVector<Vertex> &vertices = mesh.getVertices();
+  QVector<Face> &faces = mesh.getFaces();
+
+  QVector<int> newIndices(vertices.size(), -1);
+  auto newIndex = [&](int v) {
+    if (newIndices[v] < 0) {
+      newIndices[v] = coords.size();
+      coords.append(vertices[v].coords);
+    }
+    return newIndices[v];
+  };
+  for (int f = 0; f < faces.size(); f++) {
+    if (!emit[f]) {
+      continue;
+    }
+    faceValences.append(faces[f].valence);
+    HalfEdge *currentEdge = faces[f].side;
+    for (int m = 0; m < faces[f].valence; m++) {
+      faceCoordInd.append(newIndex(currentEdge->origin->index));
+      currentEdge = currentEdge->next;
+    }
+  }
+  for (unsigned int index : levelPatchIndices) {
+    patchIndices.append(newIndex(index));
+  }
+}
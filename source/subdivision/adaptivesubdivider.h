@@ -0,0 +1,33 @@
+#ifndef ADAPTIVE_SUBDIVIDER_H
+#define ADAPTIVE_SUBDIVIDER_H
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The AdaptiveSubdivider class performs feature-adaptive Catmull-Clark
+ * subdivision. Instead of subdividing the entire mesh, only the neighbourhoods
+ * of faces that do not correspond to a regular bicubic patch are subdivided.
+ * Regular faces are turned into patches at the coarsest level at which they
+ * are regular.
+ *
+ * Patches of different levels meet along sides where the coarse patch spans
+ * several fine patches. The level of every patch and of the patches across
+ * its sides is recorded, so the renderers can scale the displacement tiles
+ * and match the tessellation of those sides.
+ */
+class AdaptiveSubdivider {
+ public:
+  AdaptiveSubdivider();
+  Mesh subdivide(Mesh& controlMesh, int levels) const;
+
+ private:
+  bool extractSubmesh(Mesh& mesh, const QVector<bool>& refine, Mesh& submesh,
+                      QVector<int>& submeshFaces) const;
+  void appendLevel(Mesh& mesh, const QVector<bool>& emit,
+                   const QVector<unsigned int>& levelPatchIndices,
+                   QVector<QVector3D>& coords, QVector<int>& faceValences,
+                   QVector<int>& faceCoordInd,
+                   QVector<unsigned int>& patchIndices) const;
+};
+
+#endif  // ADAPTIVE_SUBDIVIDER_H
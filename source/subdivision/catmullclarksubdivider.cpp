@@ -2,6 +2,8 @@
 
 #include <QDebug>
 
+#include "util/parallel.h"
+
 /**
  * @brief CatmullClarkSubdivider::CatmullClarkSubdivider Creates a new empty
  * Catmull Clark subdivider.
@@ -64,50 +66,67 @@ void CatmullClarkSubdivider::reserveSizes(Mesh &controlMesh,
 void CatmullClarkSubdivider::geometryRefinement(Mesh &controlMesh,
                                                 Mesh &newMesh) const {
   QVector<Vertex> &newVertices = newMesh.getVertices();
-  QVector<Vertex> &vertices = controlMesh.getVertices();
-  QVector<Face> &faces = controlMesh.getFaces();
+  // The control mesh is only read through const references: its vectors may
+  // be shared with another mesh, and non-const access would detach them from
+  // several threads at once.
+  const QVector<Vertex> &vertices = controlMesh.getVertices();
+  const QVector<Face> &faces = controlMesh.getFaces();
+
+  // Every new vertex is written by exactly one iteration, so the loops below
+  // are split over multiple threads. Each point only depends on the control
+  // mesh and the face points, so the result is identical to a serial run.
 
   // Face Points
-  for (int f = 0; f < controlMesh.numFaces(); f++) {
-    QVector3D coords = facePoint(faces[f]);
-    int i = controlMesh.numVerts() + faces[f].index;
-    // Face points always inherit the valence of the face
-    Vertex facePoint(coords, nullptr, faces[f].valence, i);
-    newVertices[i] = facePoint;
-  }
+  parallelFor(0, controlMesh.numFaces(), [&](int begin, int end) {
+    for (int f = begin; f < end; f++) {
+      QVector3D coords = facePoint(faces[f]);
+      int i = controlMesh.numVerts() + faces[f].index;
+      // Face points always inherit the valence of the face
+      Vertex facePoint(coords, nullptr, faces[f].valence, i);
+      newVertices[i] = facePoint;
+    }
+  });
+
+  // The edge and vertex points reuse the face points computed above instead of
+  // recomputing them for every adjacent edge and vertex.
+  const Vertex *facePoints = newVertices.constData() + controlMesh.numVerts();
 
   // Edge Points
-  QVector<HalfEdge> &halfEdges = controlMesh.getHalfEdges();
-  for (int h = 0; h < controlMesh.numHalfEdges(); h++) {
-    HalfEdge currentEdge = halfEdges[h];
-    // Only create a new vertex per set of halfEdges (i.e. once per undirected
-    // edge)
-    if (h > currentEdge.twinIdx()) {
-      int v = controlMesh.numVerts() + controlMesh.numFaces() +
-              currentEdge.edgeIdx();
-      int valence;
-      QVector3D coords;
-      if (currentEdge.isBoundaryEdge()) {
-        coords = boundaryEdgePoint(currentEdge);
-        valence = 3;
-      } else {
-        coords = edgePoint(currentEdge);
-        valence = 4;
+  const QVector<HalfEdge> &halfEdges = controlMesh.getHalfEdges();
+  parallelFor(0, controlMesh.numHalfEdges(), [&](int begin, int end) {
+    for (int h = begin; h < end; h++) {
+      const HalfEdge &currentEdge = halfEdges[h];
+      // Only create a new vertex per set of halfEdges (i.e. once per
+      // undirected edge)
+      if (h > currentEdge.twinIdx()) {
+        int v = controlMesh.numVerts() + controlMesh.numFaces() +
+                currentEdge.edgeIdx();
+        int valence;
+        QVector3D coords;
+        if (currentEdge.isBoundaryEdge()) {
+          coords = boundaryEdgePoint(currentEdge);
+          valence = 3;
+        } else {
+          coords = edgePoint(currentEdge, facePoints);
+          valence = 4;
+        }
+        newVertices[v] = Vertex(coords, nullptr, valence, v);
       }
-      newVertices[v] = Vertex(coords, nullptr, valence, v);
     }
-  }
+  });
 
   // Vertex Points
-  for (int v = 0; v < controlMesh.numVerts(); v++) {
-    QVector3D coords;
-    if (vertices[v].isBoundaryVertex()) {
-      coords = boundaryVertexPoint(vertices[v]);
-    } else {
-      coords = vertexPoint(vertices[v]);
+  parallelFor(0, controlMesh.numVerts(), [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      QVector3D coords;
+      if (vertices[v].isBoundaryVertex()) {
+        coords = boundaryVertexPoint(vertices[v]);
+      } else {
+        coords = vertexPoint(vertices[v], facePoints);
+      }
+      newVertices[v] = Vertex(coords, nullptr, vertices[v].valence, v);
     }
-    newVertices[v] = Vertex(coords, nullptr, vertices[v].valence, v);
-  }
+  });
 }
 
 /**
@@ -128,15 +147,18 @@ void CatmullClarkSubdivider::geometryRefinement(Mesh &controlMesh,
  *
  * @param vertex The vertex to calculate the new position of. Note that this
  * vertex is the vertex from the control mesh.
+ * @param facePoints The face points of the new mesh, indexed by the face index
+ * in the control mesh.
  * @return The coordinates of the new vertex point.
  */
-QVector3D CatmullClarkSubdivider::vertexPoint(const Vertex &vertex) const {
+QVector3D CatmullClarkSubdivider::vertexPoint(const Vertex &vertex,
+                                              const Vertex *facePoints) const {
   HalfEdge *edge = vertex.out;
   QVector3D R; // average of edge mid points
   QVector3D Q; // average of face points
   for (int i = 0; i < vertex.valence; i++) {
     R += (edge->origin->coords + edge->next->origin->coords) / 2.0;
-    Q += facePoint(*edge->face);
+    Q += facePoints[edge->faceIdx()].coords;
     edge = edge->prev->twin;
   }
   float n = float(vertex.valence);
@@ -186,11 +208,16 @@ CatmullClarkSubdivider::boundaryVertexPoint(const Vertex &vertex) const {
  * @param edge One of the half-edges that lives on the edge to calculate
  * the edge point. Note that this half-edge is the half-edge from the control
  * mesh.
+ * @param facePoints The face points of the new mesh, indexed by the face index
+ * in the control mesh.
  * @return The coordinates of the new edge point.
  */
-QVector3D CatmullClarkSubdivider::edgePoint(const HalfEdge &edge) const {
+QVector3D CatmullClarkSubdivider::edgePoint(const HalfEdge &edge,
+                                            const Vertex *facePoints) const {
   QVector3D edgePt = boundaryEdgePoint(edge);
-  edgePt += (facePoint(*edge.face) + facePoint(*edge.twin->face)) / 2.0;
+  edgePt += (facePoints[edge.faceIdx()].coords +
+             facePoints[edge.twin->faceIdx()].coords) /
+            2.0;
   return edgePt /= 2.0;
 }
 
@@ -233,48 +260,66 @@ QVector3D CatmullClarkSubdivider::facePoint(const Face &face) const {
  */
 void CatmullClarkSubdivider::topologyRefinement(Mesh &controlMesh,
                                                 Mesh &newMesh) const {
-  for (int f = 0; f < newMesh.numFaces(); ++f) {
-    newMesh.faces[f].index = f;
-    newMesh.faces[f].valence = 4;
-  }
+  parallelFor(0, newMesh.numFaces(), [&](int begin, int end) {
+    for (int f = begin; f < end; ++f) {
+      newMesh.faces[f].index = f;
+      newMesh.faces[f].valence = 4;
+    }
+  });
+
+  // Split halfedges. Control half-edge h only writes the new half-edges 4h up
+  // to 4h+3 and the new face h, so the half-edges can be split in parallel.
+  // The control half-edges are read without detaching them, see
+  // geometryRefinement().
+  const HalfEdge *controlHalfEdges = controlMesh.halfEdges.constData();
+  parallelFor(0, controlMesh.numHalfEdges(), [&](int begin, int end) {
+    for (int h = begin; h < end; ++h) {
+      const HalfEdge *edge = controlHalfEdges + h;
 
-  // Split halfedges
-  for (int h = 0; h < controlMesh.numHalfEdges(); ++h) {
-    HalfEdge *edge = &controlMesh.halfEdges[h];
-
-    int h1 = 4 * h;
-    int h2 = 4 * h + 1;
-    int h3 = 4 * h + 2;
-    int h4 = 4 * h + 3;
-
-    int twinIdx1 = edge->twinIdx() < 0 ? -1 : 4 * edge->twin->next->index + 3;
-    int twinIdx2 = 4 * edge->next->index + 2;
-    int twinIdx3 = 4 * edge->prev->index + 1;
-    int twinIdx4 = 4 * edge->prev->twinIdx();
-
-    int vertIdx1 = edge->origin->index;
-    int vertIdx2 =
-        controlMesh.numVerts() + controlMesh.numFaces() + edge->edgeIndex;
-    int vertIdx3 = controlMesh.numVerts() + edge->faceIdx();
-    int vertIdx4 =
-        controlMesh.numVerts() + controlMesh.numFaces() + edge->prev->edgeIndex;
-
-    int edgeIdx1 = 2 * edge->edgeIndex + (h > edge->twinIdx() ? 0 : 1);
-    int edgeIdx2 = 2 * controlMesh.numEdges() + h;
-    int edgeIdx3 = 2 * controlMesh.numEdges() + edge->prev->index;
-    int edgeIdx4 = 2 * edge->prev->edgeIndex +
-                   (edge->prevIdx() > edge->prev->twinIdx() ? 1 : 0);
-
-    setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1);
-    setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2);
-    setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3);
-    setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4);
+      int h1 = 4 * h;
+      int h2 = 4 * h + 1;
+      int h3 = 4 * h + 2;
+      int h4 = 4 * h + 3;
+
+      int twinIdx1 =
+          edge->twinIdx() < 0 ? -1 : 4 * edge->twin->next->index + 3;
+      int twinIdx2 = 4 * edge->next->index + 2;
+      int twinIdx3 = 4 * edge->prev->index + 1;
+      int twinIdx4 = 4 * edge->prev->twinIdx();
+
+      int vertIdx1 = edge->origin->index;
+      int vertIdx2 =
+          controlMesh.numVerts() + controlMesh.numFaces() + edge->edgeIndex;
+      int vertIdx3 = controlMesh.numVerts() + edge->faceIdx();
+      int vertIdx4 = controlMesh.numVerts() + controlMesh.numFaces() +
+                     edge->prev->edgeIndex;
+
+      int edgeIdx1 = 2 * edge->edgeIndex + (h > edge->twinIdx() ? 0 : 1);
+      int edgeIdx2 = 2 * controlMesh.numEdges() + h;
+      int edgeIdx3 = 2 * controlMesh.numEdges() + edge->prev->index;
+      int edgeIdx4 = 2 * edge->prev->edgeIndex +
+                     (edge->prevIdx() > edge->prev->twinIdx() ? 1 : 0);
+
+      setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1);
+      setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2);
+      setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3);
+      setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4);
+    }
+  });
+
+  // Multiple half-edges originate from the same vertex, so the out-going
+  // half-edges are set in a serial pass. Every vertex refers to the last
+  // half-edge that originates from it, which keeps the result deterministic.
+  for (int h = 0; h < newMesh.numHalfEdges(); ++h) {
+    HalfEdge *halfEdge = &newMesh.halfEdges[h];
+    halfEdge->origin->out = halfEdge;
   }
 }
 
 /**
  * @brief LoopSubdivider::setHalfEdgeData Sets the data of a single half-edge
- * (and the corresponding vertex and face)
+ * (and the side of the corresponding face). The out-going half-edges of the
+ * vertices are set afterwards, since this function is called concurrently.
  * @param newMesh The new mesh this half-edge will live in.
  * @param h Index of the half-edge.
  * @param edgeIdx Index of the (undirected) edge this half-edge will belong to.
@@ -294,7 +339,250 @@ void CatmullClarkSubdivider::setHalfEdgeData(Mesh &newMesh, int h, int edgeIdx,
   halfEdge->prev = &newMesh.halfEdges[halfEdge->prevIdx()];
   halfEdge->twin = twinIdx < 0 ? nullptr : &newMesh.halfEdges[twinIdx];
 
-  halfEdge->origin->out = halfEdge;
-  halfEdge->origin->index = vertIdx;
-  halfEdge->face->side = halfEdge;
+  // The side of every face is its first half-edge, same as in the initialized
+  // mesh (and the compact representation).
+  if (h % 4 == 0) {
+    halfEdge->face->side = halfEdge;
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::subdivide Subdivides the provided compact
+ * control mesh and returns the subdivided mesh. Performs just a single
+ * subdivision step and follows the same indexing rules as the subdivision of
+ * pointer-based meshes, so both produce identical vertex, half-edge and face
+ * indices. The resulting mesh is a quad mesh, so next, prev and face of the
+ * half-edges follow from their indices.
+ * @param controlMesh The mesh to be subdivided.
+ * @return The mesh resulting of applying a single subdivision step on the
+ * control mesh.
+ */
+CompactMesh CatmullClarkSubdivider::subdivide(const CompactMesh &mesh) const {
+  CompactMesh newMesh;
+  reserveSizes(mesh, newMesh);
+  geometryRefinement(mesh, newMesh);
+  topologyRefinement(mesh, newMesh);
+  return newMesh;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::reserveSizes Resizes the vertex and half-edge
+ * arrays of the new compact mesh. Also recalculates the edge count.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh. At this point, the mesh is fully empty.
+ */
+void CatmullClarkSubdivider::reserveSizes(const CompactMesh &controlMesh,
+                                          CompactMesh &newMesh) const {
+  int newNumHalfEdges = controlMesh.numHalfEdges() * 4;
+  int newNumVerts =
+      controlMesh.numVerts() + controlMesh.numFaces() + controlMesh.numEdges();
+
+  newMesh.vertexCoords.resize(newNumVerts);
+  newMesh.vertexOut.resize(newNumVerts);
+  newMesh.vertexValence.resize(newNumVerts);
+  newMesh.halfEdgeOrigin.resize(newNumHalfEdges);
+  newMesh.halfEdgeTwin.resize(newNumHalfEdges);
+  newMesh.halfEdgeEdge.resize(newNumHalfEdges);
+  newMesh.edgeCount = 2 * controlMesh.numEdges() + controlMesh.numHalfEdges();
+}
+
+/**
+ * @brief CatmullClarkSubdivider::geometryRefinement Calculates the coordinates
+ * and valences of the vertex, edge and face points of the new compact mesh.
+ * See the pointer-based version for the valence rules.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+void CatmullClarkSubdivider::geometryRefinement(const CompactMesh &controlMesh,
+                                                CompactMesh &newMesh) const {
+  int numVerts = controlMesh.numVerts();
+  int numFaces = controlMesh.numFaces();
+
+  // Face Points
+  parallelFor(0, numFaces, [&](int begin, int end) {
+    for (int f = begin; f < end; f++) {
+      newMesh.vertexCoords[numVerts + f] = facePoint(controlMesh, f);
+      // Face points always inherit the valence of the face
+      newMesh.vertexValence[numVerts + f] = controlMesh.faceValence(f);
+    }
+  });
+
+  const QVector3D *facePoints = newMesh.vertexCoords.constData() + numVerts;
+
+  // Edge Points
+  parallelFor(0, controlMesh.numHalfEdges(), [&](int begin, int end) {
+    for (int h = begin; h < end; h++) {
+      // Only create a new vertex per set of halfEdges (i.e. once per
+      // undirected edge)
+      if (h > controlMesh.twin(h)) {
+        int v = numVerts + numFaces + controlMesh.edge(h);
+        if (controlMesh.twin(h) < 0) {
+          newMesh.vertexCoords[v] = boundaryEdgePoint(controlMesh, h);
+          newMesh.vertexValence[v] = 3;
+        } else {
+          newMesh.vertexCoords[v] = edgePoint(controlMesh, h, facePoints);
+          newMesh.vertexValence[v] = 4;
+        }
+      }
+    }
+  });
+
+  // Vertex Points
+  parallelFor(0, numVerts, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      if (controlMesh.isBoundaryVertex(v)) {
+        newMesh.vertexCoords[v] = boundaryVertexPoint(controlMesh, v);
+      } else {
+        newMesh.vertexCoords[v] = vertexPoint(controlMesh, v, facePoints);
+      }
+      newMesh.vertexValence[v] = controlMesh.valence(v);
+    }
+  });
+}
+
+/**
+ * @brief CatmullClarkSubdivider::vertexPoint Calculates the new position of a
+ * vertex of a compact mesh according to the formula for smooth vertex points.
+ * See the pointer-based version for details.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex in the control mesh.
+ * @param facePoints The face points of the new mesh, indexed by the face index
+ * in the control mesh.
+ * @return The coordinates of the new vertex point.
+ */
+QVector3D CatmullClarkSubdivider::vertexPoint(
+    const CompactMesh &mesh, int v, const QVector3D *facePoints) const {
+  const QVector<QVector3D> &coords = mesh.vertexCoords;
+  int edge = mesh.out(v);
+  QVector3D R; // average of edge mid points
+  QVector3D Q; // average of face points
+  for (int i = 0; i < mesh.valence(v); i++) {
+    R += (coords[mesh.origin(edge)] + coords[mesh.origin(mesh.next(edge))]) /
+         2.0;
+    Q += facePoints[mesh.face(edge)];
+    edge = mesh.twin(mesh.prev(edge));
+  }
+  float n = float(mesh.valence(v));
+  Q /= n;
+  R /= n;
+  // See Equation 1 of the aforementioned paper
+  return (Q + 2 * R + (coords[v] * (n - 3.0f))) / n;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::boundaryVertexPoint Calculates the new
+ * position of a boundary vertex of a compact mesh according to the formula for
+ * boundary vertex points.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex in the control mesh.
+ * @return The coordinates of the new boundary vertex point.
+ */
+QVector3D CatmullClarkSubdivider::boundaryVertexPoint(const CompactMesh &mesh,
+                                                      int v) const {
+  QVector3D boundPoint = mesh.vertexCoords[v] * 2;
+  boundPoint += boundaryEdgePoint(mesh, mesh.nextBoundaryHalfEdge(v));
+  boundPoint += boundaryEdgePoint(mesh, mesh.prevBoundaryHalfEdge(v));
+  return boundPoint / 4.0;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::edgePoint Calculates the position of the edge
+ * point of an edge of a compact mesh according to the formula for smooth edge
+ * points.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges that lives on the edge.
+ * @param facePoints The face points of the new mesh, indexed by the face index
+ * in the control mesh.
+ * @return The coordinates of the new edge point.
+ */
+QVector3D CatmullClarkSubdivider::edgePoint(const CompactMesh &mesh, int h,
+                                            const QVector3D *facePoints) const {
+  QVector3D edgePt = boundaryEdgePoint(mesh, h);
+  edgePt += (facePoints[mesh.face(h)] + facePoints[mesh.face(mesh.twin(h))]) /
+            2.0;
+  return edgePt /= 2.0;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::boundaryEdgePoint Calculates the position of
+ * the boundary edge point of an edge of a compact mesh by taking the midpoint
+ * of the edge.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges that lives on the edge.
+ * @return The coordinates of the new boundary edge point.
+ */
+QVector3D CatmullClarkSubdivider::boundaryEdgePoint(const CompactMesh &mesh,
+                                                    int h) const {
+  return (mesh.vertexCoords[mesh.origin(h)] +
+          mesh.vertexCoords[mesh.origin(mesh.next(h))]) /
+         2.0f;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::facePoint Calculates the position of the face
+ * point of a face of a compact mesh by averaging the positions of all vertices
+ * adjacent to the face.
+ * @param mesh The control mesh.
+ * @param f Index of the face.
+ * @return The coordinates of the new face point.
+ */
+QVector3D CatmullClarkSubdivider::facePoint(const CompactMesh &mesh,
+                                            int f) const {
+  QVector3D edgePt;
+  int edge = mesh.side(f);
+  int valence = mesh.faceValence(f);
+  for (int side = 0; side < valence; side++) {
+    edgePt += mesh.vertexCoords[mesh.origin(edge)];
+    edge = mesh.next(edge);
+  }
+  return edgePt / valence;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::topologyRefinement Performs the topology
+ * refinement of a compact mesh. Every half-edge h is split into the half-edges
+ * 4h up to 4h+3, which form the new face h. Only the origins, twins and edges
+ * have to be stored, since the new mesh is a quad mesh.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+void CatmullClarkSubdivider::topologyRefinement(const CompactMesh &controlMesh,
+                                                CompactMesh &newMesh) const {
+  int numVerts = controlMesh.numVerts();
+  int numFaces = controlMesh.numFaces();
+  int numEdges = controlMesh.numEdges();
+
+  parallelFor(0, controlMesh.numHalfEdges(), [&](int begin, int end) {
+    for (int h = begin; h < end; ++h) {
+      int twin = controlMesh.twin(h);
+      int prev = controlMesh.prev(h);
+      int prevTwin = controlMesh.twin(prev);
+
+      newMesh.halfEdgeTwin[4 * h] =
+          twin < 0 ? -1 : 4 * controlMesh.next(twin) + 3;
+      newMesh.halfEdgeTwin[4 * h + 1] = 4 * controlMesh.next(h) + 2;
+      newMesh.halfEdgeTwin[4 * h + 2] = 4 * prev + 1;
+      newMesh.halfEdgeTwin[4 * h + 3] = prevTwin < 0 ? -1 : 4 * prevTwin;
+
+      newMesh.halfEdgeOrigin[4 * h] = controlMesh.origin(h);
+      newMesh.halfEdgeOrigin[4 * h + 1] =
+          numVerts + numFaces + controlMesh.edge(h);
+      newMesh.halfEdgeOrigin[4 * h + 2] = numVerts + controlMesh.face(h);
+      newMesh.halfEdgeOrigin[4 * h + 3] =
+          numVerts + numFaces + controlMesh.edge(prev);
+
+      newMesh.halfEdgeEdge[4 * h] =
+          2 * controlMesh.edge(h) + (h > twin ? 0 : 1);
+      newMesh.halfEdgeEdge[4 * h + 1] = 2 * numEdges + h;
+      newMesh.halfEdgeEdge[4 * h + 2] = 2 * numEdges + prev;
+      newMesh.halfEdgeEdge[4 * h + 3] =
+          2 * controlMesh.edge(prev) + (prev > prevTwin ? 1 : 0);
+    }
+  });
+
+  // Every vertex refers to the last half-edge that originates from it, same
+  // as in the pointer-based subdivision.
+  for (int h = 0; h < newMesh.numHalfEdges(); ++h) {
+    newMesh.vertexOut[newMesh.halfEdgeOrigin[h]] = h;
+  }
 }
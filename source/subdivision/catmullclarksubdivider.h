@@ -1,6 +1,7 @@
 #ifndef CATMULL_CLARK_SUBDIVIDER_H
 #define CATMULL_CLARK_SUBDIVIDER_H
 
+#include "mesh/compactmesh.h"
 #include "mesh/mesh.h"
 #include "subdivider.h"
 
@@ -12,6 +13,7 @@ class CatmullClarkSubdivider : public Subdivider {
 public:
   CatmullClarkSubdivider();
   Mesh subdivide(Mesh &mesh) const override;
+  CompactMesh subdivide(const CompactMesh &mesh) const;
 
 private:
   void reserveSizes(Mesh &mesh, Mesh &newMesh) const;
@@ -22,10 +24,22 @@ private:
                        int twinIdx) const;
 
   QVector3D facePoint(const Face &face) const;
-  QVector3D edgePoint(const HalfEdge &edge) const;
+  QVector3D edgePoint(const HalfEdge &edge, const Vertex *facePoints) const;
   QVector3D boundaryEdgePoint(const HalfEdge &edge) const;
-  QVector3D vertexPoint(const Vertex &vertex) const;
+  QVector3D vertexPoint(const Vertex &vertex, const Vertex *facePoints) const;
   QVector3D boundaryVertexPoint(const Vertex &vertex) const;
+
+  void reserveSizes(const CompactMesh &mesh, CompactMesh &newMesh) const;
+  void geometryRefinement(const CompactMesh &mesh, CompactMesh &newMesh) const;
+  void topologyRefinement(const CompactMesh &mesh, CompactMesh &newMesh) const;
+
+  QVector3D facePoint(const CompactMesh &mesh, int f) const;
+  QVector3D edgePoint(const CompactMesh &mesh, int h,
+                      const QVector3D *facePoints) const;
+  QVector3D boundaryEdgePoint(const CompactMesh &mesh, int h) const;
+  QVector3D vertexPoint(const CompactMesh &mesh, int v,
+                        const QVector3D *facePoints) const;
+  QVector3D boundaryVertexPoint(const CompactMesh &mesh, int v) const;
 };
 
 #endif // CATMULL_CLARK_SUBDIVIDER_H
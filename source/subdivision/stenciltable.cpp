@@ -0,0 +1,408 @@
+#include "stenciltable.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include "catmullclarksubdivider.h"
+#include "util/parallel.h"
+#include "util/util.h"
+
+// Minimum number of stencils that are built by a single task.
+#define MIN_STENCILS_PER_CHUNK 4096
+
+/**
+ * @brief StencilTable::StencilTable Creates an empty stencil table.
+ */
+StencilTable::StencilTable()
+    : controlVertCount(0), levelCount(0), limitPositions(false) {}
+
+/**
+ * @brief StencilTable::StencilTable Builds the stencils of the given number of
+ * Catmull-Clark subdivision steps. The stencils are built level by level: the
+ * stencils of a single step (in terms of the vertices of the previous level)
+ * are combined with the stencils of the previous levels (in terms of the
+ * control points). The weights follow the same rules as the
+ * CatmullClarkSubdivider, including the boundary rules, and the refined
+ * vertices are ordered the same way.
+ *
+ * If requested, the refined vertices are finally replaced by their limit
+ * positions. The limit rules assume a quad mesh, so a control mesh with other
+ * faces needs at least one subdivision step; otherwise the projection is
+ * skipped.
+ * @param controlMesh The control mesh. Only its topology is used by the
+ * stencils.
+ * @param levels The number of subdivision steps.
+ * @param limit Whether to map to the limit positions of the refined vertices.
+ */
+StencilTable::StencilTable(const CompactMesh &controlMesh, int levels,
+                           bool limit)
+    : controlVertCount(controlMesh.numVerts()),
+      levelCount(levels),
+      limitPositions(false),
+      refinedMesh(controlMesh) {
+  // Level 0 is the identity.
+  offsets.resize(controlVertCount + 1);
+  indices.resize(controlVertCount);
+  weights.fill(1.0f, controlVertCount);
+  for (int v = 0; v < controlVertCount; v++) {
+    offsets[v] = v;
+    indices[v] = v;
+  }
+  offsets[controlVertCount] = controlVertCount;
+
+  CatmullClarkSubdivider subdivider;
+  for (int l = 0; l < levels; l++) {
+    refine(refinedMesh, false);
+    refinedMesh = subdivider.subdivide(refinedMesh);
+  }
+  if (limit) {
+    if (refinedMesh.isQuadMesh()) {
+      refine(refinedMesh, true);
+      limitPositions = true;
+    } else {
+      qWarning() << " * Limit stencils require a quad mesh";
+    }
+  }
+}
+
+/**
+ * @brief StencilTable::apply Computes the refined vertices from the control
+ * points by evaluating all stencils. The stencils are independent of each
+ * other, so they are evaluated in parallel.
+ * @param controlCoords The coordinates of the control points. Should contain
+ * numControlVerts() elements.
+ * @param coords The coordinates of the refined vertices. Will be resized to
+ * numStencils() elements.
+ */
+void StencilTable::apply(const QVector<QVector3D> &controlCoords,
+                         QVector<QVector3D> &coords) const {
+  coords.resize(numStencils());
+  const QVector3D *points = controlCoords.constData();
+  const int *stencilIndices = indices.constData();
+  const float *stencilWeights = weights.constData();
+  QVector3D *result = coords.data();
+
+  parallelFor(0, numStencils(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      float x = 0.0f;
+      float y = 0.0f;
+      float z = 0.0f;
+      for (int j = offsets[i]; j < offsets[i + 1]; j++) {
+        const QVector3D &point = points[stencilIndices[j]];
+        float weight = stencilWeights[j];
+        x += weight * point.x();
+        y += weight * point.y();
+        z += weight * point.z();
+      }
+      result[i] = QVector3D(x, y, z);
+    }
+  });
+}
+
+/**
+ * @brief StencilTable::refine Extends the stencils by a single subdivision
+ * step, or by the projection to the limit surface. Every new stencil is a
+ * weighted sum of stencils of the current level. The new stencils are built in
+ * parallel chunks and concatenated afterwards.
+ * @param mesh The mesh of the current level. Its vertices correspond to the
+ * current stencils.
+ * @param toLimit Whether to project the vertices to their limit positions
+ * instead of subdividing.
+ */
+void StencilTable::refine(const CompactMesh &mesh, bool toLimit) {
+  int numVerts = mesh.numVerts();
+  int numStencils =
+      toLimit ? numVerts : numVerts + mesh.numFaces() + mesh.numEdges();
+
+  // The half-edge that creates the edge point, same as in the subdivider.
+  QVector<int> edgeHalfEdges(mesh.numEdges());
+  for (int h = 0; h < mesh.numHalfEdges(); h++) {
+    if (h > mesh.twin(h)) {
+      edgeHalfEdges[mesh.edge(h)] = h;
+    }
+  }
+
+  int numChunks = std::min(numStencils / MIN_STENCILS_PER_CHUNK + 1,
+                           4 * QThread::idealThreadCount());
+  int chunkSize = (numStencils + numChunks - 1) / numChunks;
+  QVector<int> stencilSizes(numStencils);
+  QVector<QVector<int>> chunkIndices(numChunks);
+  QVector<QVector<float>> chunkWeights(numChunks);
+
+  parallelFor(
+      0, numChunks,
+      [&](int begin, int end) {
+        SparseRow levelRow(numVerts);
+        SparseRow row(controlVertCount);
+        for (int c = begin; c < end; c++) {
+          int last = std::min((c + 1) * chunkSize, numStencils);
+          for (int i = c * chunkSize; i < last; i++) {
+            levelRow.clear();
+            if (toLimit) {
+              addLimitStencil(mesh, i, levelRow);
+            } else {
+              levelStencil(mesh, edgeHalfEdges, i, levelRow);
+            }
+
+            row.clear();
+            for (int k = 0; k < levelRow.indices.size(); k++) {
+              int v = levelRow.indices[k];
+              float weight = levelRow.weights[k];
+              for (int j = offsets[v]; j < offsets[v + 1]; j++) {
+                row.add(indices[j], weight * weights[j]);
+              }
+            }
+            stencilSizes[i] = row.indices.size();
+            chunkIndices[c].append(row.indices);
+            chunkWeights[c].append(row.weights);
+          }
+        }
+      },
+      1);
+
+  QVector<int> newOffsets(numStencils + 1);
+  newOffsets[0] = 0;
+  for (int i = 0; i < numStencils; i++) {
+    newOffsets[i + 1] = newOffsets[i] + stencilSizes[i];
+  }
+  QVector<int> newIndices(newOffsets[numStencils]);
+  QVector<float> newWeights(newOffsets[numStencils]);
+
+  parallelFor(
+      0, numChunks,
+      [&](int begin, int end) {
+        for (int c = begin; c < end; c++) {
+          int offset = newOffsets[std::min(c * chunkSize, numStencils)];
+          std::copy(chunkIndices[c].constBegin(), chunkIndices[c].constEnd(),
+                    newIndices.begin() + offset);
+          std::copy(chunkWeights[c].constBegin(), chunkWeights[c].constEnd(),
+                    newWeights.begin() + offset);
+        }
+      },
+      1);
+
+  offsets = newOffsets;
+  indices = newIndices;
+  weights = newWeights;
+}
+
+/**
+ * @brief StencilTable::levelStencil Computes the stencil of a vertex of the
+ * next level in terms of the vertices of the current level. The vertex points
+ * come first, followed by the face points and the edge points.
+ * @param mesh The mesh of the current level.
+ * @param edgeHalfEdges For every edge, the half-edge that creates its edge
+ * point.
+ * @param v Index of the vertex in the next level.
+ * @param row The row the weights are added to.
+ */
+void StencilTable::levelStencil(const CompactMesh &mesh,
+                                const QVector<int> &edgeHalfEdges, int v,
+                                SparseRow &row) const {
+  int numVerts = mesh.numVerts();
+  int numFaces = mesh.numFaces();
+  if (v < numVerts) {
+    addVertexStencil(mesh, v, row);
+  } else if (v < numVerts + numFaces) {
+    addFaceStencil(mesh, v - numVerts, 1.0f, row);
+  } else {
+    addEdgeStencil(mesh, edgeHalfEdges[v - numVerts - numFaces], row);
+  }
+}
+
+/**
+ * @brief StencilTable::addFaceStencil Adds the weights of a face point: the
+ * average of all vertices of the face.
+ * @param mesh The mesh of the current level.
+ * @param f Index of the face.
+ * @param weight The weight of the face point itself.
+ * @param row The row the weights are added to.
+ */
+void StencilTable::addFaceStencil(const CompactMesh &mesh, int f, float weight,
+                                  SparseRow &row) const {
+  int valence = mesh.faceValence(f);
+  int edge = mesh.side(f);
+  for (int side = 0; side < valence; side++) {
+    row.add(mesh.origin(edge), weight / valence);
+    edge = mesh.next(edge);
+  }
+}
+
+/**
+ * @brief StencilTable::addEdgeStencil Adds the weights of an edge point. A
+ * smooth edge point is the average of the midpoint of the edge and the two
+ * adjacent face points, which gives a weight of 1/4 to both endpoints and both
+ * face points. A boundary edge point is the midpoint of the edge.
+ * @param mesh The mesh of the current level.
+ * @param h Index of one of the half-edges that lives on the edge.
+ * @param row The row the weights are added to.
+ */
+void StencilTable::addEdgeStencil(const CompactMesh &mesh, int h,
+                                  SparseRow &row) const {
+  int twin = mesh.twin(h);
+  if (twin < 0) {
+    row.add(mesh.origin(h), 0.5f);
+    row.add(mesh.origin(mesh.next(h)), 0.5f);
+    return;
+  }
+  row.add(mesh.origin(h), 0.25f);
+  row.add(mesh.origin(mesh.next(h)), 0.25f);
+  addFaceStencil(mesh, mesh.face(h), 0.25f, row);
+  addFaceStencil(mesh, mesh.face(twin), 0.25f, row);
+}
+
+/**
+ * @brief StencilTable::addVertexStencil Adds the weights of a vertex point. A
+ * smooth vertex point is Q/n + 2R/n + S(n-3)/n (see
+ * CatmullClarkSubdivider::vertexPoint), so every adjacent face point and every
+ * endpoint of an incident edge gets a weight of 1/n^2. A boundary vertex point
+ * gets 3/4 of the old vertex and 1/8 of both boundary neighbours.
+ * @param mesh The mesh of the current level.
+ * @param v Index of the vertex.
+ * @param row The row the weights are added to.
+ */
+void StencilTable::addVertexStencil(const CompactMesh &mesh, int v,
+                                    SparseRow &row) const {
+  if (mesh.isBoundaryVertex(v)) {
+    int next = mesh.nextBoundaryHalfEdge(v);
+    int prev = mesh.prevBoundaryHalfEdge(v);
+    row.add(v, 0.5f);
+    row.add(mesh.origin(next), 0.125f);
+    row.add(mesh.origin(mesh.next(next)), 0.125f);
+    row.add(mesh.origin(prev), 0.125f);
+    row.add(mesh.origin(mesh.next(prev)), 0.125f);
+    return;
+  }
+  if (mesh.valence(v) == 0) {
+    // Isolated vertices are not moved.
+    row.add(v, 1.0f);
+    return;
+  }
+  float n = float(mesh.valence(v));
+  float weight = 1.0f / (n * n);
+  row.add(v, (n - 3.0f) / n);
+  int edge = mesh.out(v);
+  for (int i = 0; i < mesh.valence(v); i++) {
+    row.add(mesh.origin(edge), weight);
+    row.add(mesh.origin(mesh.next(edge)), weight);
+    addFaceStencil(mesh, mesh.face(edge), weight, row);
+    edge = mesh.twin(mesh.prev(edge));
+  }
+}
+
+/**
+ * @brief StencilTable::addLimitStencil Adds the weights of the limit position
+ * of a vertex of a quad mesh. A smooth vertex of valence n moves to
+ * (n^2 v + 4 sum(e_i) + sum(d_i)) / (n (n + 5)), where e_i are its neighbours
+ * and d_i the opposite vertices of the surrounding quads. A boundary vertex
+ * follows the cubic B-spline of the boundary: 2/3 of the vertex and 1/6 of
+ * both boundary neighbours.
+ * @param mesh The mesh of the current level. Should be a quad mesh.
+ * @param v Index of the vertex.
+ * @param row The row the weights are added to.
+ */
+void StencilTable::addLimitStencil(const CompactMesh &mesh, int v,
+                                   SparseRow &row) const {
+  if (mesh.isBoundaryVertex(v)) {
+    // Both half-edges contain v, so v gets 1/3 + 1/6 + 1/6.
+    int next = mesh.nextBoundaryHalfEdge(v);
+    int prev = mesh.prevBoundaryHalfEdge(v);
+    row.add(v, 1.0f / 3.0f);
+    row.add(mesh.origin(next), 1.0f / 6.0f);
+    row.add(mesh.origin(mesh.next(next)), 1.0f / 6.0f);
+    row.add(mesh.origin(prev), 1.0f / 6.0f);
+    row.add(mesh.origin(mesh.next(prev)), 1.0f / 6.0f);
+    return;
+  }
+  if (mesh.valence(v) == 0) {
+    row.add(v, 1.0f);
+    return;
+  }
+  float n = float(mesh.valence(v));
+  float weight = 1.0f / (n * (n + 5.0f));
+  row.add(v, n / (n + 5.0f));
+  int edge = mesh.out(v);
+  for (int i = 0; i < mesh.valence(v); i++) {
+    row.add(mesh.origin(mesh.next(edge)), 4.0f * weight);
+    row.add(mesh.origin(mesh.next(mesh.next(edge))), weight);
+    edge = mesh.twin(mesh.prev(edge));
+  }
+}
+
+/**
+ * @brief StencilTable::numControlVerts Number of control points the stencils
+ * refer to.
+ * @return The number of control points.
+ */
+int StencilTable::numControlVerts() const { return controlVertCount; }
+
+/**
+ * @brief StencilTable::numStencils Number of stencils, which is equal to the
+ * number of vertices of the refined mesh.
+ * @return The number of stencils.
+ */
+int StencilTable::numStencils() const { return offsets.size() - 1; }
+
+/**
+ * @brief StencilTable::numWeights Number of non-zero weights of all stencils.
+ * @return The number of non-zero weights.
+ */
+int StencilTable::numWeights() const { return indices.size(); }
+
+/**
+ * @brief StencilTable::numLevels Number of subdivision steps the stencils
+ * represent.
+ * @return The number of subdivision steps.
+ */
+int StencilTable::numLevels() const { return levelCount; }
+
+/**
+ * @brief StencilTable::isLimit Whether the stencils map to the limit positions
+ * of the refined vertices instead of the refined vertices themselves.
+ * @return True if the stencils include the projection to the limit surface.
+ */
+bool StencilTable::isLimit() const { return limitPositions; }
+
+/**
+ * @brief StencilTable::memoryUsage Approximates the number of bytes used by the
+ * stencils, excluding the refined mesh.
+ * @return The number of bytes used.
+ */
+qint64 StencilTable::memoryUsage() const {
+  return vectorMemory(offsets) + vectorMemory(indices) + vectorMemory(weights);
+}
+
+/**
+ * @brief StencilTable::SparseRow::SparseRow Creates an empty row.
+ * @param numColumns The number of columns (possible indices) of the row.
+ */
+StencilTable::SparseRow::SparseRow(int numColumns)
+    : positions(numColumns, -1) {}
+
+/**
+ * @brief StencilTable::SparseRow::add Adds a weight to the given index.
+ * @param index The column index.
+ * @param weight The weight to add.
+ */
+void StencilTable::SparseRow::add(int index, float weight) {
+  int position = positions[index];
+  if (position < 0) {
+    positions[index] = indices.size();
+    indices.append(index);
+    weights.append(weight);
+  } else {
+    weights[position] += weight;
+  }
+}
+
+/**
+ * @brief StencilTable::SparseRow::clear Removes all weights from the row. Only
+ * resets the lookup entries that were used.
+ */
+void StencilTable::SparseRow::clear() {
+  for (int index : indices) {
+    positions[index] = -1;
+  }
+  indices.clear();
+  weights.clear();
+}
@@ -0,0 +1,79 @@
+#ifndef STENCIL_TABLE_H
+#define STENCIL_TABLE_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/compactmesh.h"
+
+/**
+ * @brief The StencilTable class stores a number of Catmull-Clark subdivision
+ * steps as a sparse matrix that maps the control points of a mesh to the
+ * vertices of the refined mesh. Every row (stencil) contains the weights of
+ * the control points that contribute to a single refined vertex. The matrix is
+ * stored in compressed sparse row format. As long as the topology of the
+ * control mesh does not change, the refined vertices follow from a single
+ * sparse matrix-vector product.
+ *
+ * Optionally, the refined vertices are projected onto the limit surface. The
+ * B-spline patches are built from the refined vertices, so the renderers use
+ * the stencils without projection.
+ */
+class StencilTable {
+ public:
+  StencilTable();
+  StencilTable(const CompactMesh& controlMesh, int levels, bool limit = false);
+
+  void apply(const QVector<QVector3D>& controlCoords,
+             QVector<QVector3D>& coords) const;
+
+  inline CompactMesh& getRefinedMesh() { return refinedMesh; }
+
+  int numControlVerts() const;
+  int numStencils() const;
+  int numWeights() const;
+  int numLevels() const;
+  bool isLimit() const;
+  qint64 memoryUsage() const;
+
+ private:
+  /**
+   * @brief The SparseRow class accumulates the weights of a single stencil.
+   * Adding a weight to an index that is already present sums the weights. The
+   * lookup table has one entry per column, so it is reused for many rows.
+   */
+  class SparseRow {
+   public:
+    SparseRow(int numColumns);
+    void add(int index, float weight);
+    void clear();
+
+    QVector<int> indices;
+    QVector<float> weights;
+
+   private:
+    QVector<int> positions;
+  };
+
+  void refine(const CompactMesh& mesh, bool toLimit);
+  void levelStencil(const CompactMesh& mesh, const QVector<int>& edgeHalfEdges,
+                    int v, SparseRow& row) const;
+  void addFaceStencil(const CompactMesh& mesh, int f, float weight,
+                      SparseRow& row) const;
+  void addVertexStencil(const CompactMesh& mesh, int v, SparseRow& row) const;
+  void addEdgeStencil(const CompactMesh& mesh, int h, SparseRow& row) const;
+  void addLimitStencil(const CompactMesh& mesh, int v, SparseRow& row) const;
+
+  // Compressed sparse row storage. The weights of stencil i are stored at
+  // offsets[i] up to (excluding) offsets[i + 1].
+  QVector<int> offsets;
+  QVector<int> indices;
+  QVector<float> weights;
+
+  int controlVertCount;
+  int levelCount;
+  bool limitPositions;
+  CompactMesh refinedMesh;
+};
+
+#endif  // STENCIL_TABLE_H
@@ -0,0 +1,299 @@
+#include "subdivisioncache.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+// Default memory budget of the cached levels in bytes.
+#define DEFAULT_MEMORY_BUDGET (qint64(2) << 30)
+
+/**
+ * @brief SubdivisionCache::SubdivisionCache Creates an empty cache with the
+ * default memory budget.
+ */
+SubdivisionCache::SubdivisionCache()
+    : SubdivisionCache(DEFAULT_MEMORY_BUDGET) {}
+
+/**
+ * @brief SubdivisionCache::SubdivisionCache Creates an empty cache.
+ * @param memoryBudget Maximum number of bytes used by the cached levels.
+ */
+SubdivisionCache::SubdivisionCache(qint64 memoryBudget)
+    : useCounter(0), budget(memoryBudget), useStencils(false) {}
+
+/**
+ * @brief SubdivisionCache::setControlMesh Replaces the control mesh and
+ * discards all levels of the previous control mesh. In stencil mode, the
+ * levels are kept and moved along if the topology did not change.
+ * @param controlMesh The new control mesh, which is level 0.
+ */
+void SubdivisionCache::setControlMesh(const QSharedPointer<Mesh> &controlMesh) {
+  if (useStencils && !levels.isEmpty() &&
+      levels[0]->hasSameTopology(*controlMesh)) {
+    updateControlPoints(controlMesh);
+    return;
+  }
+  clear();
+  levels.append(controlMesh);
+  lastUsed.append(useCounter);
+  prepared.append(0);
+}
+
+/**
+ * @brief SubdivisionCache::updateControlPoints Replaces the control mesh by
+ * one with the same topology and replaces the cached levels by copies whose
+ * vertices are moved by applying their stencils to the new control points.
+ * The cached levels may have been handed out already, so they are not
+ * modified. Evicted levels are subdivided again when they are requested.
+ * @param controlMesh The new control mesh.
+ */
+void SubdivisionCache::updateControlPoints(
+    const QSharedPointer<Mesh> &controlMesh) {
+  QElapsedTimer timer;
+  timer.start();
+  levels[0] = controlMesh;
+  prepared.fill(0);
+  // The stencils refer to the vertex order of the mesh, which is unchanged.
+  CompactMesh compactMesh;
+  QVector<QVector3D> controlCoords;
+  controlCoords.reserve(controlMesh->numVerts());
+  for (const Vertex &vertex : controlMesh->getVertices()) {
+    controlCoords.append(vertex.coords);
+  }
+  stencilTables.resize(levels.size());
+  QVector<QVector3D> coords;
+  for (int k = 1; k < levels.size(); k++) {
+    if (levels[k].isNull()) {
+      continue;
+    }
+    if (stencilTables[k].isNull()) {
+      if (compactMesh.numVerts() == 0) {
+        compactMesh = CompactMesh(*controlMesh);
+      }
+      stencilTables[k] = QSharedPointer<StencilTable>::create(compactMesh, k);
+    }
+    stencilTables[k]->apply(controlCoords, coords);
+    levels[k] = levels[k]->movedCopy(coords);
+  }
+  qDebug() << ":: Updated control points of the cached levels in"
+           << timer.elapsed() << "ms";
+  evict(0);
+}
+
+/**
+ * @brief SubdivisionCache::setStencilMode Enables or disables stencil mode.
+ * Disabling it discards the stencil tables.
+ * @param enabled Whether control meshes with the same topology only move the
+ * cached levels.
+ */
+void SubdivisionCache::setStencilMode(bool enabled) {
+  useStencils = enabled;
+  if (!enabled) {
+    stencilTables.clear();
+  }
+}
+
+/**
+ * @brief SubdivisionCache::stencilMode Whether control meshes with the same
+ * topology only move the cached levels.
+ * @return True if stencil mode is enabled.
+ */
+bool SubdivisionCache::stencilMode() const { return useStencils; }
+
+/**
+ * @brief SubdivisionCache::level Returns the requested subdivision level. If
+ * the level is not cached, it is computed from the finest cached level below
+ * it. The intermediate levels are cached as well. After every step, levels are
+ * evicted until the cache fits in its memory budget again. The returned mesh
+ * stays valid while the caller holds on to it, even if it is evicted.
+ * @param level The subdivision level. Should be at least 0.
+ * @param isCanceled Optional function that is checked before every step. If it
+ * returns true, the computation stops. The levels computed so far stay cached.
+ * @return The mesh of the requested level, or a null pointer if there is no
+ * control mesh or the computation was canceled.
+ */
+QSharedPointer<Mesh> SubdivisionCache::level(
+    int level, const std::function<bool()> &isCanceled) {
+  if (levels.isEmpty()) {
+    return QSharedPointer<Mesh>();
+  }
+  if (level >= levels.size()) {
+    levels.resize(level + 1);
+    lastUsed.resize(level + 1);
+    prepared.resize(level + 1);
+  }
+
+  int k = level;
+  while (levels[k].isNull()) {
+    k--;
+  }
+  QElapsedTimer timer;
+  for (; k < level; k++) {
+    if (isCanceled && isCanceled()) {
+      return QSharedPointer<Mesh>();
+    }
+    timer.start();
+    levels[k + 1] =
+        QSharedPointer<Mesh>::create(subdivider.subdivide(*levels[k]));
+    lastUsed[k + 1] = ++useCounter;
+    prepared[k + 1] = 0;
+    qDebug() << ":: Subdivided to level" << k + 1 << "with"
+             << levels[k + 1]->numFaces() << "faces in" << timer.elapsed()
+             << "ms";
+    // Evict in between steps as well, so the intermediate levels do not
+    // exceed the budget.
+    evict(k + 1);
+  }
+  lastUsed[level] = ++useCounter;
+  evict(level);
+  return levels[level];
+}
+
+/**
+ * @brief SubdivisionCache::evict Evicts the least recently used levels until
+ * the cache fits in its memory budget. The control mesh and the requested
+ * level are never evicted.
+ * @param requestedLevel The level that was just requested.
+ */
+void SubdivisionCache::evict(int requestedLevel) {
+  qint64 usage = memoryUsage();
+  while (usage > budget) {
+    int victim = -1;
+    for (int k = 1; k < levels.size(); k++) {
+      if (k == requestedLevel || levels[k].isNull()) {
+        continue;
+      }
+      if (victim < 0 || lastUsed[k] < lastUsed[victim]) {
+        victim = k;
+      }
+    }
+    if (victim < 0) {
+      return;
+    }
+    usage -= levelMemoryUsage(victim);
+    levels[victim].clear();
+    prepared[victim] = 0;
+    if (victim < stencilTables.size()) {
+      stencilTables[victim].clear();
+    }
+    qDebug() << ":: Evicted subdivision level" << victim;
+  }
+}
+
+/**
+ * @brief SubdivisionCache::clear Removes the control mesh and all levels.
+ */
+void SubdivisionCache::clear() {
+  levels.clear();
+  levels.squeeze();
+  lastUsed.clear();
+  lastUsed.squeeze();
+  prepared.clear();
+  prepared.squeeze();
+  stencilTables.clear();
+}
+
+/**
+ * @brief SubdivisionCache::isCached Checks whether a level is currently cached.
+ * @param level The subdivision level.
+ * @return True if the level is cached; false otherwise.
+ */
+bool SubdivisionCache::isCached(int level) const {
+  return level >= 0 && level < levels.size() && !levels[level].isNull();
+}
+
+/**
+ * @brief SubdivisionCache::preparedFlags Retrieves the flags that were set for
+ * a level since it was last computed or moved.
+ * @param level The subdivision level.
+ * @return The flags, or 0 if the level is not cached.
+ */
+int SubdivisionCache::preparedFlags(int level) const {
+  return isCached(level) ? prepared[level] : 0;
+}
+
+/**
+ * @brief SubdivisionCache::setPreparedFlags Records which data has been derived
+ * from a cached level. Does nothing if the level is not cached.
+ * @param level The subdivision level.
+ * @param flags The flags, which are opaque to the cache.
+ */
+void SubdivisionCache::setPreparedFlags(int level, int flags) {
+  if (isCached(level)) {
+    prepared[level] = flags;
+  }
+}
+
+/**
+ * @brief SubdivisionCache::replaceLevel Replaces a cached level by a mesh with
+ * the same topology and vertices, e.g. a copy that more data was derived
+ * into. Keeps the flags of the level. Does nothing if the level is not cached.
+ * @param level The subdivision level.
+ * @param mesh The mesh.
+ */
+void SubdivisionCache::replaceLevel(int level,
+                                    const QSharedPointer<Mesh> &mesh) {
+  if (isCached(level)) {
+    levels[level] = mesh;
+  }
+}
+
+/**
+ * @brief SubdivisionCache::setMemoryBudget Sets the memory budget. Levels are
+ * only evicted upon the next request.
+ * @param bytes Maximum number of bytes used by the cached levels.
+ */
+void SubdivisionCache::setMemoryBudget(qint64 bytes) { budget = bytes; }
+
+/**
+ * @brief SubdivisionCache::memoryBudget Maximum number of bytes used by the
+ * cached levels.
+ * @return The memory budget in bytes.
+ */
+qint64 SubdivisionCache::memoryBudget() const { return budget; }
+
+/**
+ * @brief SubdivisionCache::memoryUsage Approximates the number of bytes used
+ * by all cached levels, including the control mesh.
+ * @return The number of bytes used.
+ */
+qint64 SubdivisionCache::memoryUsage() const {
+  qint64 bytes = 0;
+  for (int k = 0; k < levels.size(); k++) {
+    bytes += levelMemoryUsage(k);
+  }
+  return bytes;
+}
+
+/**
+ * @brief SubdivisionCache::levelMemoryUsage Approximates the number of bytes
+ * used by a single level, including its stencils.
+ * @param level The subdivision level.
+ * @return The number of bytes used, or 0 if the level is not cached.
+ */
+qint64 SubdivisionCache::levelMemoryUsage(int level) const {
+  if (!isCached(level)) {
+    return 0;
+  }
+  qint64 bytes = levels[level]->memoryUsage();
+  if (level < stencilTables.size() && !stencilTables[level].isNull()) {
+    bytes += stencilTables[level]->memoryUsage() +
+             stencilTables[level]->getRefinedMesh().memoryUsage();
+  }
+  return bytes;
+}
+
+/**
+ * @brief SubdivisionCache::debugInfo Prints the memory usage of every level.
+ */
+void SubdivisionCache::debugInfo() const {
+  for (int k = 0; k < levels.size(); k++) {
+    if (isCached(k)) {
+      qDebug() << " * Level" << k << "uses" << levelMemoryUsage(k) / 1024
+               << "KiB";
+    } else {
+      qDebug() << " * Level" << k << "is not cached";
+    }
+  }
+  qDebug() << " * Total" << memoryUsage() / 1024 << "of" << budget / 1024
+           << "KiB";
+}
@@ -0,0 +1,70 @@
+#ifndef SUBDIVISION_CACHE_H
+#define SUBDIVISION_CACHE_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include <functional>
+
+#include "catmullclarksubdivider.h"
+#include "mesh/mesh.h"
+#include "stenciltable.h"
+
+/**
+ * @brief The SubdivisionCache class owns the subdivision levels of a control
+ * mesh. Levels are computed on demand from the finest cached level below them.
+ * Whenever the cached levels exceed the memory budget, the least recently used
+ * levels are evicted. Evicted levels are recomputed when they are requested
+ * again. The control mesh itself is never evicted.
+ *
+ * In stencil mode, a new control mesh with the same topology as the current
+ * one only moves the vertices of the cached levels. Their positions are
+ * recomputed from the new control points with stencil tables, which are built
+ * the first time a level is updated and reused for every later update.
+ *
+ * For every cached level, the cache keeps a set of flags that its user sets
+ * once it has derived data from the level, e.g. extracted its buffers. The
+ * flags are cleared whenever the level is computed again or its vertices move.
+ */
+class SubdivisionCache {
+ public:
+  SubdivisionCache();
+  SubdivisionCache(qint64 memoryBudget);
+
+  void setControlMesh(const QSharedPointer<Mesh>& controlMesh);
+  QSharedPointer<Mesh> level(
+      int level, const std::function<bool()>& isCanceled = nullptr);
+  void clear();
+
+  void setStencilMode(bool enabled);
+  bool stencilMode() const;
+  bool isCached(int level) const;
+  int preparedFlags(int level) const;
+  void setPreparedFlags(int level, int flags);
+  void replaceLevel(int level, const QSharedPointer<Mesh>& mesh);
+  void setMemoryBudget(qint64 bytes);
+  qint64 memoryBudget() const;
+  qint64 memoryUsage() const;
+  qint64 levelMemoryUsage(int level) const;
+  void debugInfo() const;
+
+ private:
+  void evict(int requestedLevel);
+  void updateControlPoints(const QSharedPointer<Mesh>& controlMesh);
+
+  // Null for levels that have not been computed or have been evicted.
+  QVector<QSharedPointer<Mesh>> levels;
+  // Value of useCounter when the level was last requested.
+  QVector<quint64> lastUsed;
+  // The flags set by the user of the level. See preparedFlags().
+  QVector<int> prepared;
+  quint64 useCounter;
+  qint64 budget;
+
+  bool useStencils;
+  // Null for levels whose stencils have not been built.
+  QVector<QSharedPointer<StencilTable>> stencilTables;
+
+  CatmullClarkSubdivider subdivider;
+};
+
+#endif  // SUBDIVISION_CACHE_H
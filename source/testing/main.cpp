@@ -0,0 +1,411 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QTextStream>
+#include <QThreadPool>
+#include <cmath>
+#include <functional>
+
+#include "exporters/meshexporter.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/objfile.h"
+#include "mesh/compactmesh.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/stenciltable.h"
+#include "subdivision/subdivisioncache.h"
+
+// Maximum distance between positions that should be the same up to rounding.
+#define TOLERANCE 1e-5f
+
+static QTextStream out(stdout);
+
+/**
+ * @brief check Reports a failed condition.
+ * @param condition The condition.
+ * @param message Describes what was checked.
+ * @return The condition.
+ */
+static bool check(bool condition, const QString &message) {
+  if (!condition) {
+    out << "  failed: " << message << "\n";
+  }
+  return condition;
+}
+
+/**
+ * @brief loadMesh Loads a model from the models directory.
+ * @param name The name of the model, without the suffix.
+ * @param levels Number of subdivision steps.
+ * @return The subdivided mesh with its attributes and regular patches.
+ */
+static Mesh loadMesh(const QString &name, int levels) {
+  OBJFile objFile(QDir(TEST_MODELS_DIR).filePath(name + ".obj"));
+  MeshInitializer meshInitializer;
+  Mesh mesh = meshInitializer.constructHalfEdgeMesh(objFile);
+  CatmullClarkSubdivider subdivider;
+  for (int k = 0; k < levels; k++) {
+    mesh = subdivider.subdivide(mesh);
+  }
+  mesh.extractAttributes();
+  mesh.computeRegularPatchIndices();
+  return mesh;
+}
+
+/**
+ * @brief maxDistance Computes the largest distance between corresponding
+ * points.
+ * @param a The first points.
+ * @param b The second points.
+ * @return The largest distance, or infinity if the sizes differ.
+ */
+static float maxDistance(const QVector<QVector3D> &a,
+                         const QVector<QVector3D> &b) {
+  if (a.size() != b.size()) {
+    return INFINITY;
+  }
+  float distance = 0.0f;
+  for (int k = 0; k < a.size(); k++) {
+    distance = std::max(distance, (a[k] - b[k]).length());
+  }
+  return distance;
+}
+
+/**
+ * @brief testTessellatorVertices Checks that the vertices of the Tessellator
+ * lie on the surface of the SurfaceEvaluator: with fixed levels, every patch
+ * is sampled on a regular grid of tileSize by tileSize quads.
+ * @return True if the test passed.
+ */
+static bool testTessellatorVertices() {
+  Mesh mesh = loadMesh("Spot", 1);
+  const float tileSize = 4.0f;
+  Tessellator tessellator;
+  tessellator.setTileSize(tileSize);
+  tessellator.setDisplacement(ProceduralDisplacement(0, 0.2f));
+  TessellatedMesh tessellated = tessellator.tessellate(
+      mesh.getVertexCoords(), mesh.getRegularPatchIndices());
+
+  SurfaceEvaluator evaluator(mesh.getVertexCoords(),
+                             mesh.getRegularPatchIndices());
+  evaluator.setTileSize(tileSize);
+  evaluator.setDisplacement(ProceduralDisplacement(0, 0.2f));
+
+  bool passed = check(tessellated.numVerts() > 0, "no vertices");
+  int grid = int(tileSize);
+  for (int p = 0; p < evaluator.numPatches() && passed; p++) {
+    // The vertices used by the triangles of the patch.
+    QVector<unsigned int> vertices;
+    for (int t = tessellated.patchTriangles[p];
+         t < tessellated.patchTriangles[p + 1]; t++) {
+      for (int c = 0; c < 3; c++) {
+        vertices.append(tessellated.indices[3 * t + c]);
+      }
+    }
+    for (int j = 0; j <= grid; j++) {
+      for (int i = 0; i <= grid; i++) {
+        QVector3D point = evaluator.evaluate(p, float(i) / grid,
+                                             float(j) / grid);
+        float nearest = INFINITY;
+        for (unsigned int v : vertices) {
+          nearest = std::min(nearest, (tessellated.coords[v] - point).length());
+        }
+        passed = passed && check(nearest < TOLERANCE,
+                                 QString("patch %1 misses sample (%2, %3)")
+                                     .arg(p)
+                                     .arg(i)
+                                     .arg(j));
+      }
+    }
+  }
+  return passed;
+}
+
+/**
+ * @brief testBakedCoefficients Checks that baked displacement coefficients
+ * give the same surface as generating them per sample, for every
+ * displacement mode.
+ * @return True if the test passed.
+ */
+static bool testBakedCoefficients() {
+  Mesh mesh = loadMesh("Spot", 1);
+  bool passed = true;
+  for (int mode = 0; mode < 4; mode++) {
+    SurfaceSamples procedural;
+    for (int p = 0; p < mesh.getRegularPatchIndices().size() / 16; p++) {
+      procedural.appendGrid(p, 9);
+    }
+    SurfaceSamples baked = procedural;
+
+    SurfaceEvaluator evaluator(mesh.getVertexCoords(),
+                               mesh.getRegularPatchIndices());
+    evaluator.setTileSize(4.0f);
+    evaluator.setDisplacement(ProceduralDisplacement(mode, 0.2f));
+    evaluator.evaluate(procedural);
+    evaluator.setBakedCoefficients(true);
+    evaluator.evaluate(baked);
+
+    float distance = 0.0f;
+    float normalDistance = 0.0f;
+    for (int k = 0; k < procedural.size(); k++) {
+      distance = std::max(
+          distance,
+          QVector3D(procedural.x[k] - baked.x[k], procedural.y[k] - baked.y[k],
+                    procedural.z[k] - baked.z[k])
+              .length());
+      normalDistance = std::max(
+          normalDistance, QVector3D(procedural.normalX[k] - baked.normalX[k],
+                                    procedural.normalY[k] - baked.normalY[k],
+                                    procedural.normalZ[k] - baked.normalZ[k])
+                              .length());
+    }
+    passed = check(distance < TOLERANCE && normalDistance < 1e-4f,
+                   QString("mode %1 differs by %2 (normals %3)")
+                       .arg(mode)
+                       .arg(distance)
+                       .arg(normalDistance)) &&
+             passed;
+  }
+  return passed;
+}
+
+/**
+ * @brief The CapturingExporter class collects the chunks that a MeshExporter
+ * writes instead of writing them to the file.
+ */
+class CapturingExporter : public MeshExporter {
+ public:
+  mutable TessellatedMesh captured;
+
+ protected:
+  void writeHeader(QByteArray &, qint64, qint64) const override {}
+  void writeVertices(QByteArray &, const TessellatedMesh &chunk) const override {
+    captured.coords.append(chunk.coords);
+    captured.normals.append(chunk.normals);
+  }
+  void writeTriangles(QByteArray &,
+                      const TessellatedMesh &chunk) const override {
+    captured.indices.append(chunk.indices);
+  }
+};
+
+/**
+ * @brief testChunkedExport Checks that tessellating the patches range by range,
+ * as the exporters do, gives the same mesh as tessellating them as a whole.
+ * @return True if the test passed.
+ */
+static bool testChunkedExport() {
+  Mesh mesh = loadMesh("Spot", 1);
+  Tessellator tessellator;
+  tessellator.setTileSize(3.0f);
+  tessellator.setDisplacement(ProceduralDisplacement(1, 0.1f));
+  TessellatedMesh whole = tessellator.tessellate(
+      mesh.getVertexCoords(), mesh.getRegularPatchIndices());
+
+  // Ranges of a few patches, so vertices are shared across ranges.
+  TessellatedMesh chunked;
+  const int chunkSize = 7;
+  int patchCount = tessellator.numPatches();
+  for (int p = 0; p < patchCount; p += chunkSize) {
+    TessellatedMesh chunk;
+    tessellator.evaluate(p, std::min(p + chunkSize, patchCount), chunk);
+    chunked.coords.append(chunk.coords);
+    chunked.normals.append(chunk.normals);
+  }
+  for (int p = 0; p < patchCount; p += chunkSize) {
+    TessellatedMesh chunk;
+    tessellator.triangulate(p, std::min(p + chunkSize, patchCount), chunk);
+    chunked.indices.append(chunk.indices);
+  }
+
+  bool passed =
+      check(maxDistance(whole.coords, chunked.coords) == 0.0f &&
+                maxDistance(whole.normals, chunked.normals) == 0.0f,
+            "chunked vertices differ") &&
+      check(whole.indices == chunked.indices, "chunked triangles differ");
+
+  CapturingExporter exporter;
+  QString fileName = QDir::temp().filePath("analyticaldispmap-test.obj");
+  passed = check(exporter.exportMesh(tessellator, mesh.getVertexCoords(),
+                                     mesh.getRegularPatchIndices(), fileName),
+                 "export failed") &&
+           passed;
+  QFile::remove(fileName);
+  passed = check(maxDistance(whole.coords, exporter.captured.coords) == 0.0f &&
+                     whole.indices == exporter.captured.indices,
+                 "exported mesh differs") &&
+           passed;
+  return passed;
+}
+
+/**
+ * @brief testSerialSubdivision Checks that subdividing on a single thread gives
+ * exactly the same meshes as subdividing with parallelFor.
+ * @return True if the test passed.
+ */
+static bool testSerialSubdivision() {
+  Mesh controlMesh = loadMesh("Fandisk", 0);
+  CompactMesh compactControlMesh(controlMesh);
+  CatmullClarkSubdivider subdivider;
+  auto subdivideTwice = [&](Mesh &mesh, CompactMesh &compactMesh) {
+    Mesh refined = subdivider.subdivide(controlMesh);
+    mesh = subdivider.subdivide(refined);
+    compactMesh =
+        subdivider.subdivide(subdivider.subdivide(compactControlMesh));
+  };
+
+  Mesh parallel, serial;
+  CompactMesh parallelCompact, serialCompact;
+  subdivideTwice(parallel, parallelCompact);
+  QThreadPool *pool = QThreadPool::globalInstance();
+  int maxThreadCount = pool->maxThreadCount();
+  pool->setMaxThreadCount(1);
+  subdivideTwice(serial, serialCompact);
+  pool->setMaxThreadCount(maxThreadCount);
+
+  parallel.extractAttributes();
+  serial.extractAttributes();
+  return check(parallel.hasSameTopology(serial), "topology differs") &&
+         check(maxDistance(parallel.getVertexCoords(),
+                           serial.getVertexCoords()) == 0.0f,
+               "vertices differ") &&
+         check(maxDistance(parallelCompact.getVertexCoords(),
+                           serialCompact.getVertexCoords()) == 0.0f,
+               "compact mesh vertices differ");
+}
+
+/**
+ * @brief testStencilTable Checks that applying the stencils of a level to the
+ * control points gives the vertices of the subdivided mesh, and that the limit
+ * stencils give the corners of the regular patches.
+ * @return True if the test passed.
+ */
+static bool testStencilTable() {
+  Mesh controlMesh = loadMesh("Fandisk", 0);
+  CompactMesh compactMesh(controlMesh);
+  CatmullClarkSubdivider subdivider;
+  const int levels = 2;
+  Mesh refined = controlMesh;
+  for (int k = 0; k < levels; k++) {
+    refined = subdivider.subdivide(refined);
+  }
+  refined.extractAttributes();
+  refined.computeRegularPatchIndices();
+
+  QVector<QVector3D> coords;
+  StencilTable(compactMesh, levels).apply(compactMesh.getVertexCoords(), coords);
+  bool passed = check(maxDistance(coords, refined.getVertexCoords()) < TOLERANCE,
+                      "refined vertices differ");
+
+  StencilTable(compactMesh, levels, true)
+      .apply(compactMesh.getVertexCoords(), coords);
+  SurfaceEvaluator evaluator(refined.getVertexCoords(),
+                             refined.getRegularPatchIndices());
+  evaluator.setDisplacement(ProceduralDisplacement(0, 0.0f));
+  const QVector<unsigned int> &patchIndices = refined.getRegularPatchIndices();
+  float distance = 0.0f;
+  for (int p = 0; p < evaluator.numPatches(); p++) {
+    // The corner (0, 0) is control point 5.
+    distance = std::max(distance, (evaluator.evaluate(p, 0.0f, 0.0f) -
+                                   coords[patchIndices[16 * p + 5]])
+                                      .length());
+  }
+  passed = check(distance < TOLERANCE, "limit positions differ") && passed;
+  return passed;
+}
+
+/**
+ * @brief testCacheUpdate Checks that moving the control points of the
+ * SubdivisionCache leaves the levels that were handed out unchanged, and that
+ * the moved levels match subdividing the moved control mesh.
+ * @return True if the test passed.
+ */
+static bool testCacheUpdate() {
+  auto controlMesh = QSharedPointer<Mesh>::create(loadMesh("Fandisk", 0));
+  SubdivisionCache cache;
+  cache.setStencilMode(true);
+  cache.setControlMesh(controlMesh);
+  const int levels = 2;
+  QSharedPointer<Mesh> before = cache.level(levels);
+  before->extractAttributes();
+  QVector<QVector3D> beforeCoords = before->getVertexCoords();
+
+  // Stretches the mesh, which changes the normals as well.
+  QVector<QVector3D> coords = controlMesh->getVertexCoords();
+  for (QVector3D &point : coords) {
+    point.setX(2.0f * point.x());
+  }
+  QSharedPointer<Mesh> movedMesh = controlMesh->movedCopy(coords);
+  cache.setControlMesh(movedMesh);
+  QSharedPointer<Mesh> after = cache.level(levels);
+  after->extractAttributes();
+  before->extractAttributes();
+
+  Mesh expected = *movedMesh;
+  CatmullClarkSubdivider subdivider;
+  for (int k = 0; k < levels; k++) {
+    expected = subdivider.subdivide(expected);
+  }
+  expected.extractAttributes();
+  bool passed = check(before != after, "level moved in place");
+  passed = check(maxDistance(before->getVertexCoords(), beforeCoords) == 0.0f,
+                 "handed-out level changed") &&
+           passed;
+  // The stencils sum the control points in another order, which the
+  // normals amplify.
+  passed = check(maxDistance(after->getVertexCoords(),
+                             expected.getVertexCoords()) < TOLERANCE &&
+                     maxDistance(after->getVertexNorms(),
+                                 expected.getVertexNorms()) < 10 * TOLERANCE,
+                 "moved level differs") &&
+           passed;
+  return passed;
+}
+
+/**
+ * @brief testAdaptiveNormals Checks that every vertex normal of an adaptively
+ * subdivided mesh is finite, including those of the vertices that are only
+ * kept for the patches.
+ * @return True if the test passed.
+ */
+static bool testAdaptiveNormals() {
+  Mesh controlMesh = loadMesh("Fandisk", 0);
+  AdaptiveSubdivider subdivider;
+  Mesh mesh = subdivider.subdivide(controlMesh, 2);
+  mesh.extractAttributes();
+  int invalid = 0;
+  for (const QVector3D &normal : mesh.getVertexNorms()) {
+    if (!std::isfinite(normal.x()) || !std::isfinite(normal.y()) ||
+        !std::isfinite(normal.z())) {
+      invalid++;
+    }
+  }
+  return check(invalid == 0, QString("%1 invalid normals").arg(invalid));
+}
+
+/**
+ * @brief main Runs the tests of the geometry core. Does not need OpenGL.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return The number of failed tests.
+ */
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QVector<QPair<QString, std::function<bool()>>> tests = {
+      {"tessellator vertices", testTessellatorVertices},
+      {"baked coefficients", testBakedCoefficients},
+      {"chunked export", testChunkedExport},
+      {"serial subdivision", testSerialSubdivision},
+      {"stencil table", testStencilTable},
+      {"cache update", testCacheUpdate},
+      {"adaptive normals", testAdaptiveNormals},
+  };
+  int failed = 0;
+  for (const auto &test : tests) {
+    bool passed = test.second();
+    out << (passed ? "PASS " : "FAIL ") << test.first << "\n";
+    out.flush();
+    failed += passed ? 0 : 1;
+  }
+  return failed;
+}
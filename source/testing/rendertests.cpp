@@ -0,0 +1,192 @@
+#include <QDir>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLVersionFunctionsFactory>
+#include <QTextStream>
+#include <functional>
+
+#include "evaluation/patchbvh.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/objfile.h"
+#include "renderers/pretessrenderer.h"
+#include "renderers/settingsbuffer.h"
+#include "renderers/tessrenderer.h"
+#include "renderers/vertexbuffers.h"
+#include "subdivision/catmullclarksubdivider.h"
+
+// Returned if there is no OpenGL 4.1 context, which CTest reports as skipped.
+#define SKIP_RETURN_CODE 77
+// Maximum distance between the vertices of the GPU and the CPU. Both evaluate
+// the same formulas in single precision, but in a different order.
+#define TOLERANCE 1e-4f
+// Maximum angle between their normals in degrees.
+#define ANGLE_TOLERANCE 0.5f
+
+static QTextStream out(stdout);
+
+/**
+ * The renderers that take part in a capture, set up the same way as in the
+ * MainView.
+ */
+typedef struct Renderers {
+  Settings settings;
+  VertexBuffers vertexBuffers;
+  SettingsBuffer settingsBuffer;
+  TessellationRenderer tessellationRenderer;
+  PretessellatedRenderer pretessellatedRenderer;
+} Renderers;
+
+/**
+ * @brief check Reports a failed condition.
+ * @param condition The condition.
+ * @param message Describes what was checked.
+ * @return The condition.
+ */
+static bool check(bool condition, const QString &message) {
+  if (!condition) {
+    out << "  failed: " << message << "\n";
+  }
+  return condition;
+}
+
+/**
+ * @brief loadMesh Loads a model from the models directory and prepares it the
+ * same way as the MeshPipeline.
+ * @param name The name of the model, without the suffix.
+ * @param levels Number of subdivision steps.
+ * @param bvh The hierarchy over the regular patches of the mesh.
+ * @return The subdivided mesh with its attributes and patches.
+ */
+static Mesh loadMesh(const QString &name, int levels,
+                     QSharedPointer<const PatchBVH> &bvh) {
+  OBJFile objFile(QDir(TEST_MODELS_DIR).filePath(name + ".obj"));
+  MeshInitializer meshInitializer;
+  Mesh mesh = meshInitializer.constructHalfEdgeMesh(objFile);
+  CatmullClarkSubdivider subdivider;
+  for (int k = 0; k < levels; k++) {
+    mesh = subdivider.subdivide(mesh);
+  }
+  mesh.extractAttributes();
+  mesh.computeRegularPatchIndices();
+  mesh.computeIrregularPatches();
+  auto patchBVH = QSharedPointer<PatchBVH>::create();
+  patchBVH->build(mesh.getVertexCoords(), mesh.getRegularPatchIndices(),
+                  mesh.getPatchLevels(), mesh.getIrregularSides());
+  bvh = patchBVH;
+  return mesh;
+}
+
+/**
+ * @brief testCapture Checks that the surface captured by the
+ * PretessellatedRenderer has the same triangles, vertices and normals as the
+ * Tessellator with the same settings.
+ * @param renderers The renderers.
+ * @param density Number of samples per displacement tile in either direction.
+ * @param displacementMode The procedural displacement.
+ * @return True if the test passed.
+ */
+static bool testCapture(Renderers &renderers, int density,
+                        int displacementMode) {
+  QSharedPointer<const PatchBVH> bvh;
+  Mesh mesh = loadMesh("Spot", 1, bvh);
+  Settings &settings = renderers.settings;
+  settings.tileSize = 4.0f;
+  settings.tessDensity = density;
+  settings.displacement_mode = displacementMode;
+  settings.normal_mode = 0;
+  settings.bakedDisplacement = false;
+  renderers.settingsBuffer.update(settings);
+  renderers.vertexBuffers.update(mesh);
+  renderers.tessellationRenderer.updateBuffers(mesh, bvh);
+  renderers.pretessellatedRenderer.updateBuffers(mesh, bvh);
+  renderers.tessellationRenderer.updateCoefficientTexture();
+
+  if (!check(renderers.pretessellatedRenderer.updateTessellation(),
+             "capture failed")) {
+    return false;
+  }
+  CaptureComparison comparison;
+  if (!check(renderers.pretessellatedRenderer.compareWithTessellator(
+                 comparison),
+             "nothing captured")) {
+    return false;
+  }
+  bool passed = check(comparison.capturedTriangles ==
+                          comparison.tessellatedTriangles,
+                      QString("captured %1 triangles instead of %2")
+                          .arg(comparison.capturedTriangles)
+                          .arg(comparison.tessellatedTriangles));
+  passed = check(comparison.unmatched == 0,
+                 QString("%1 captured vertices without a match")
+                     .arg(comparison.unmatched)) &&
+           passed;
+  passed = check(comparison.maxDistance < TOLERANCE,
+                 QString("vertices differ by %1")
+                     .arg(comparison.maxDistance)) &&
+           passed;
+  passed = check(comparison.maxAngle < ANGLE_TOLERANCE,
+                 QString("normals differ by %1 degrees")
+                     .arg(comparison.maxAngle)) &&
+           passed;
+  return passed;
+}
+
+/**
+ * @brief main Runs the tests of the renderers in an offscreen OpenGL 4.1
+ * context.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return The number of failed tests, or SKIP_RETURN_CODE if there is no
+ * OpenGL 4.1 context.
+ */
+int main(int argc, char *argv[]) {
+  QGuiApplication app(argc, argv);
+
+  QSurfaceFormat format;
+  format.setVersion(4, 1);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  QOpenGLContext context;
+  context.setFormat(format);
+  QOffscreenSurface surface;
+  surface.setFormat(format);
+  surface.create();
+  if (!context.create() || !context.makeCurrent(&surface) ||
+      context.format().version() < qMakePair(4, 1)) {
+    out << "SKIP no OpenGL 4.1 context\n";
+    return SKIP_RETURN_CODE;
+  }
+  QOpenGLFunctions_4_1_Core *functions =
+      QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_4_1_Core>(&context);
+  if (functions == nullptr || !functions->initializeOpenGLFunctions()) {
+    out << "SKIP no OpenGL 4.1 functions\n";
+    return SKIP_RETURN_CODE;
+  }
+
+  int failed = 0;
+  {
+    // Deleted while the context is current.
+    Renderers renderers;
+    renderers.vertexBuffers.init(functions);
+    renderers.settingsBuffer.init(functions);
+    renderers.tessellationRenderer.init(functions, &renderers.settings,
+                                        &renderers.vertexBuffers);
+    renderers.pretessellatedRenderer.init(functions, &renderers.settings,
+                                          &renderers.vertexBuffers);
+
+    QVector<QPair<QString, std::function<bool()>>> tests = {
+        {"capture", [&] { return testCapture(renderers, 1, 0); }},
+        {"capture density 2", [&] { return testCapture(renderers, 2, 0); }},
+        {"capture displacement 1",
+         [&] { return testCapture(renderers, 1, 1); }},
+    };
+    for (const auto &test : tests) {
+      bool passed = test.second();
+      out << (passed ? "PASS " : "FAIL ") << test.first << "\n";
+      out.flush();
+      failed += passed ? 0 : 1;
+    }
+  }
+  context.doneCurrent();
+  return failed;
+}
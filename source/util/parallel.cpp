@@ -0,0 +1,104 @@
+#include "parallel.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+// Number of blocks per thread. More blocks give better load balancing when the
+// cost per element varies.
+#define BLOCKS_PER_THREAD 4
+
+/**
+ * @brief The ParallelForState struct holds the data shared between the threads
+ * that work on a single parallelFor invocation.
+ */
+typedef struct ParallelForState {
+  std::function<void(int, int)> body;
+  int begin;
+  int end;
+  int blockSize;
+  int numBlocks;
+
+  std::atomic<int> nextBlock{0};
+
+  QMutex mutex;
+  QWaitCondition allDone;
+  int doneBlocks = 0;
+} ParallelForState;
+
+/**
+ * @brief runBlocks Keeps claiming and running blocks until no blocks are left.
+ * @param state The shared state of the parallelFor invocation.
+ */
+static void runBlocks(ParallelForState& state) {
+  int finished = 0;
+  for (int b = state.nextBlock.fetch_add(1); b < state.numBlocks;
+       b = state.nextBlock.fetch_add(1)) {
+    int blockBegin = state.begin + b * state.blockSize;
+    int blockEnd = std::min(blockBegin + state.blockSize, state.end);
+    state.body(blockBegin, blockEnd);
+    finished++;
+  }
+  if (finished > 0) {
+    QMutexLocker locker(&state.mutex);
+    state.doneBlocks += finished;
+    if (state.doneBlocks == state.numBlocks) {
+      state.allDone.wakeAll();
+    }
+  }
+}
+
+/**
+ * @brief parallelFor Splits the range [begin, end) into blocks and runs the
+ * body on every block using the global thread pool. The calling thread works on
+ * blocks as well and the function only returns once all blocks are processed.
+ * Blocks are only waited on once a thread has claimed them, so this is safe to
+ * call from within a thread pool task. The body should only write to elements
+ * within its own block.
+ * @param begin Start of the range.
+ * @param end End of the range (exclusive).
+ * @param body Function invoked with the bounds [blockBegin, blockEnd) of a
+ * block.
+ * @param minBlockSize Minimum number of elements per block. Ranges smaller than
+ * this are processed on the calling thread.
+ */
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body,
+                 int minBlockSize) {
+  int count = end - begin;
+  if (count <= 0) {
+    return;
+  }
+  minBlockSize = std::max(minBlockSize, 1);
+  QThreadPool* pool = QThreadPool::globalInstance();
+  int numThreads = pool->maxThreadCount();
+  if (count <= minBlockSize || numThreads <= 1) {
+    body(begin, end);
+    return;
+  }
+
+  // The state is shared, since tasks that start after all blocks have been
+  // processed may still access it after this function returns.
+  std::shared_ptr<ParallelForState> state =
+      std::make_shared<ParallelForState>();
+  state->body = body;
+  state->begin = begin;
+  state->end = end;
+  int numBlocks = std::min((count + minBlockSize - 1) / minBlockSize,
+                           BLOCKS_PER_THREAD * numThreads);
+  state->blockSize = (count + numBlocks - 1) / numBlocks;
+  state->numBlocks = (count + state->blockSize - 1) / state->blockSize;
+
+  int numTasks = std::min(numThreads, state->numBlocks) - 1;
+  for (int t = 0; t < numTasks; t++) {
+    pool->start([state]() { runBlocks(*state); });
+  }
+  runBlocks(*state);
+
+  QMutexLocker locker(&state->mutex);
+  while (state->doneBlocks < state->numBlocks) {
+    state->allDone.wait(&state->mutex);
+  }
+}
@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body,
+                 int minBlockSize = 1024);
+
+#endif  // PARALLEL_H
@@ -0,0 +1,56 @@
+#include "stagetimings.h"
+
+#include <QMutexLocker>
+
+/**
+ * @brief StageTimings::StageTimings Creates a new collection without any
+ * stages.
+ */
+StageTimings::StageTimings() {}
+
+/**
+ * @brief StageTimings::record Records the duration of a stage, replacing the
+ * previous duration of that stage.
+ * @param stage The name of the stage.
+ * @param milliseconds The duration in milliseconds.
+ */
+void StageTimings::record(const QString& stage, double milliseconds) {
+  QMutexLocker locker(&mutex);
+  for (QPair<QString, double>& duration : durations) {
+    if (duration.first == stage) {
+      duration.second = milliseconds;
+      return;
+    }
+  }
+  durations.append(qMakePair(stage, milliseconds));
+}
+
+/**
+ * @brief StageTimings::stages Returns the most recent duration of every stage.
+ * @return The names and durations in milliseconds of the stages, in order of
+ * the first time they were recorded.
+ */
+QVector<QPair<QString, double>> StageTimings::stages() const {
+  QMutexLocker locker(&mutex);
+  return durations;
+}
+
+/**
+ * @brief ScopedStageTimer::ScopedStageTimer Starts timing a stage.
+ * @param timings The timings to record the duration in. Nothing is recorded if
+ * this is a null pointer.
+ * @param stage The name of the stage.
+ */
+ScopedStageTimer::ScopedStageTimer(StageTimings* timings, const QString& stage)
+    : timings(timings), stage(stage) {
+  timer.start();
+}
+
+/**
+ * @brief ScopedStageTimer::~ScopedStageTimer Records the duration of the stage.
+ */
+ScopedStageTimer::~ScopedStageTimer() {
+  if (timings != nullptr) {
+    timings->record(stage, timer.nsecsElapsed() / 1e6);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef STAGE_TIMINGS_H
+#define STAGE_TIMINGS_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The StageTimings class keeps the most recent duration of a number of
+ * named stages, such as the stages that prepare a mesh. Stages may be recorded
+ * from any thread.
+ */
+class StageTimings {
+ public:
+  StageTimings();
+
+  void record(const QString& stage, double milliseconds);
+  QVector<QPair<QString, double>> stages() const;
+
+ private:
+  mutable QMutex mutex;
+  // In order of the first time the stage was recorded.
+  QVector<QPair<QString, double>> durations;
+};
+
+/**
+ * @brief The ScopedStageTimer class records the time between its construction
+ * and destruction as the duration of a stage.
+ */
+class ScopedStageTimer {
+ public:
+  ScopedStageTimer(StageTimings* timings, const QString& stage);
+  ~ScopedStageTimer();
+
+ private:
+  StageTimings* timings;
+  QString stage;
+  QElapsedTimer timer;
+};
+
+#endif  // STAGE_TIMINGS_H
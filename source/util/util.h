@@ -7,4 +7,14 @@
 float calcBoundingBoxScale(const QVector<QVector3D> coords,
                            const float desiredScale = 1.0f);
 
+/**
+ * @brief vectorMemory Computes the number of bytes allocated by a vector.
+ * @param vector The vector.
+ * @return The number of allocated bytes.
+ */
+template <typename T>
+inline qint64 vectorMemory(const QVector<T>& vector) {
+  return qint64(sizeof(T)) * vector.capacity();
+}
+
 #endif  // UTIL_H